@@ -0,0 +1,405 @@
+// Benchmark suite for the extraction, grouping and saving paths on a synthetic
+// corpus, with the regex path extraction replaced as a reference. Results are printed
+// as a table and written as JSON, which can be checked against a stored baseline:
+//
+//   comments-benchmarks generate DIR [corpus options]
+//   comments-benchmarks run [corpus options] [--output FILE] [--baseline FILE]
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QRegularExpression>
+#include <QTemporaryDir>
+#include <QTextStream>
+#include "CommentExtractor.h"
+#include "CommentLexer.h"
+#include "CommentSaver.h"
+#include "CorpusGenerator.h"
+#include "ResourceUsage.h"
+#include <limits>
+
+namespace {
+
+const int SchemaVersion = 1;
+
+struct StageResult {
+    QString name;         // "<stage>/<extension>", e.g. "extract/cpp"
+    double seconds = 0;   // Best of the repeats
+    qint64 bytes = 0;
+    qint64 comments = 0;  // Comment lines found, or edits applied when saving
+    qint64 peakRssBytes = -1;
+
+    double megabytesPerSecond() const { return seconds > 0 ? double(bytes) / 1e6 / seconds : 0; }
+    double commentsPerSecond() const { return seconds > 0 ? double(comments) / seconds : 0; }
+};
+
+struct CorpusCommandLine {
+    QCommandLineOption languages{"languages", "Comma separated: cpp, py, ts (default: all three).", "list", "cpp,py,ts"};
+    QCommandLineOption files{"files", "Files per language (default 20).", "count", "20"};
+    QCommandLineOption fileSize{"file-size", "Size of each file in KiB (default 256).", "KiB", "256"};
+    QCommandLineOption density{"comment-density", "Fraction of lines with a comment (default 0.25).", "ratio", "0.25"};
+    QCommandLineOption inlineRatio{"inline-ratio", "Fraction of comments after code (default 0.2).", "ratio", "0.2"};
+    QCommandLineOption runLength{"max-run", "Longest run of consecutive comment lines (default 12).", "lines", "12"};
+    QCommandLineOption seed{"seed", "Generator seed (default 1).", "number", "1"};
+
+    void addTo(QCommandLineParser &parser) const
+    {
+        parser.addOptions({languages, files, fileSize, density, inlineRatio, runLength, seed});
+    }
+
+    CorpusOptions options(const QCommandLineParser &parser) const
+    {
+        CorpusOptions corpus;
+        corpus.languages.clear();
+        for (const QString &name : parser.value(languages).split(',', Qt::SkipEmptyParts)) {
+            if (name == "cpp") {
+                corpus.languages.append(Language::Cpp);
+            } else if (name == "py") {
+                corpus.languages.append(Language::Python);
+            } else if (name == "ts") {
+                corpus.languages.append(Language::TypeScript);
+            } else {
+                QTextStream(stderr) << "Ignoring unknown language: " << name << "\n";
+            }
+        }
+        corpus.filesPerLanguage = qMax(1, parser.value(files).toInt());
+        corpus.fileBytes = qMax(1LL, parser.value(fileSize).toLongLong()) * 1024;
+        corpus.commentDensity = parser.value(density).toDouble();
+        corpus.inlineRatio = parser.value(inlineRatio).toDouble();
+        corpus.maxRunLength = qMax(1, parser.value(runLength).toInt());
+        corpus.seed = parser.value(seed).toUInt();
+        return corpus;
+    }
+};
+
+QJsonObject corpusToJson(const CorpusOptions &corpus)
+{
+    QJsonArray languages;
+    for (Language language : corpus.languages) {
+        languages.append(CorpusGenerator::extensionFor(language));
+    }
+    return {{"languages", languages},
+            {"filesPerLanguage", corpus.filesPerLanguage},
+            {"fileBytes", qint64(corpus.fileBytes)},
+            {"commentDensity", corpus.commentDensity},
+            {"inlineRatio", corpus.inlineRatio},
+            {"maxRunLength", corpus.maxRunLength},
+            {"seed", qint64(corpus.seed)}};
+}
+
+// Runs `stage` `repeats` times and keeps the fastest run; the peak is the largest seen
+template <typename Stage>
+StageResult measure(const QString &name, int repeats, Stage stage)
+{
+    StageResult result;
+    result.name = name;
+    result.seconds = std::numeric_limits<double>::max();
+    for (int i = 0; i < repeats; ++i) {
+        resetPeakResidentSet();
+        QElapsedTimer timer;
+        timer.start();
+        stage(result);
+        result.seconds = qMin(result.seconds, double(timer.nsecsElapsed()) / 1e9);
+        result.peakRssBytes = qMax(result.peakRssBytes, peakResidentSetBytes());
+    }
+    return result;
+}
+
+// The per-line QRegularExpression scan the lexer replaced: every line is decoded and
+// three patterns are compiled for it, as the old extractor did. Kept only as the
+// reference the extraction target is measured against; returns the matches found.
+qint64 regexReferenceScan(const QByteArray &content)
+{
+    qint64 found = 0;
+    const QStringList lines = QString::fromUtf8(content).split('\n');
+    for (const QString &line : lines) {
+        const QRegularExpression patterns[] = {
+            QRegularExpression("//(.*?)$", QRegularExpression::MultilineOption),
+            QRegularExpression("#(.*?)$", QRegularExpression::MultilineOption),
+            QRegularExpression("/\\*(.*?)\\*/", QRegularExpression::DotMatchesEverythingOption)};
+        for (const QRegularExpression &pattern : patterns) {
+            QRegularExpressionMatchIterator it = pattern.globalMatch(line);
+            while (it.hasNext()) {
+                if (!it.next().captured(1).trimmed().isEmpty()) {
+                    ++found;
+                }
+            }
+        }
+    }
+    return found;
+}
+
+// Every 4th group gets its first line replaced, every 5th an added line and every
+// 7th loses its last line, so the saver exercises all three edit kinds
+QList<CommentEdit> editsFor(const FileComments &file)
+{
+    QList<CommentEdit> edits;
+    for (int g = 0; g < file.groupCount(); ++g) {
+        const CommentGroup group = file.group(g);
+        if (g % 4 == 0) {
+            edits.append(CommentEdit::replace(group.lineNumber(0), "benchmark replacement text"));
+        }
+        if (g % 5 == 0) {
+            edits.append(CommentEdit::insertAfter(group.lastLineNumber(), 0, "benchmark added line"));
+        }
+        if (g % 7 == 0 && group.size() > 1) {
+            edits.append(CommentEdit::remove(group.lastLineNumber()));
+        }
+    }
+    return edits;
+}
+
+QList<StageResult> runSuite(const QStringList &paths, const CorpusOptions &corpus, int repeats)
+{
+    QList<StageResult> results;
+    for (Language language : corpus.languages) {
+        const QString extension = CorpusGenerator::extensionFor(language);
+        QStringList files;
+        for (const QString &path : paths) {
+            if (path.endsWith("." + extension)) {
+                files.append(path);
+            }
+        }
+
+        // Extraction: the lexer alone over files already in memory
+        QList<QByteArray> contents;
+        for (const QString &path : std::as_const(files)) {
+            QFile file(path);
+            contents.append(file.open(QIODevice::ReadOnly) ? file.readAll() : QByteArray());
+        }
+        results.append(measure("extract/" + extension, repeats, [&](StageResult &result) {
+            result.bytes = 0;
+            result.comments = 0;
+            const CommentLexer lexer(language);
+            for (const QByteArray &content : std::as_const(contents)) {
+                result.bytes += content.size();
+                result.comments += lexer.scan(content).size();
+            }
+        }));
+        // The regex path the lexer replaced, on the same bytes
+        results.append(measure("regex/" + extension, repeats, [&](StageResult &result) {
+            result.bytes = 0;
+            result.comments = 0;
+            for (const QByteArray &content : std::as_const(contents)) {
+                result.bytes += content.size();
+                result.comments += regexReferenceScan(content);
+            }
+        }));
+        contents.clear();
+
+        // Grouping: CommentExtractor::extractFile from disk (page cache), no comment cache
+        results.append(measure("group/" + extension, repeats, [&](StageResult &result) {
+            result.bytes = 0;
+            result.comments = 0;
+            CommentExtractor extractor;
+            for (const QString &path : std::as_const(files)) {
+                const FileComments file = extractor.extractFile(path);
+                result.bytes += file.size;
+                result.comments += file.comments.commentCount();
+            }
+        }));
+
+        // Saving: saveAll() on fresh copies, so every repeat edits the same input
+        StageResult save;
+        save.name = "save/" + extension;
+        save.seconds = std::numeric_limits<double>::max();
+        for (int i = 0; i < repeats; ++i) {
+            QTemporaryDir copies;
+            QList<FileSaveJob> jobs;
+            CommentExtractor extractor;
+            save.bytes = 0;
+            save.comments = 0;
+            for (const QString &path : std::as_const(files)) {
+                FileSaveJob job;
+                job.filePath = copies.filePath(QFileInfo(path).fileName());
+                QFile::copy(path, job.filePath);
+                job.edits = editsFor(extractor.extractFile(job.filePath));
+                save.bytes += QFileInfo(job.filePath).size();
+                save.comments += job.edits.size();
+                jobs.append(job);
+            }
+            resetPeakResidentSet();
+            QElapsedTimer timer;
+            timer.start();
+            CommentSaver::saveAll(jobs);
+            save.seconds = qMin(save.seconds, double(timer.nsecsElapsed()) / 1e9);
+            save.peakRssBytes = qMax(save.peakRssBytes, peakResidentSetBytes());
+            for (const FileSaveJob &job : std::as_const(jobs)) {
+                if (!job.saved) {
+                    QTextStream(stderr) << "Save failed: " << job.filePath << ": " << job.error << "\n";
+                }
+            }
+        }
+        results.append(save);
+    }
+    return results;
+}
+
+QJsonObject resultsToJson(const QList<StageResult> &results, const CorpusOptions &corpus)
+{
+    QJsonObject stages;
+    for (const StageResult &result : results) {
+        stages.insert(result.name, QJsonObject{{"seconds", result.seconds},
+                                               {"bytes", result.bytes},
+                                               {"comments", result.comments},
+                                               {"megabytesPerSecond", result.megabytesPerSecond()},
+                                               {"commentsPerSecond", result.commentsPerSecond()},
+                                               {"peakRssBytes", result.peakRssBytes}});
+    }
+    return {{"schema", SchemaVersion}, {"corpus", corpusToJson(corpus)}, {"results", stages}};
+}
+
+// Prints current against baseline throughput; returns the number of regressions
+int compareWithBaseline(const QJsonObject &current, const QJsonObject &baseline, double tolerance, QTextStream &out)
+{
+    if (baseline.value("schema").toInt() != SchemaVersion) {
+        out << "Baseline has a different schema version; not compared\n";
+        return 0;
+    }
+    if (baseline.value("corpus") != current.value("corpus")) {
+        out << "Warning: the baseline was measured on a different corpus\n";
+    }
+
+    int regressions = 0;
+    const QJsonObject now = current.value("results").toObject();
+    const QJsonObject before = baseline.value("results").toObject();
+    out << "\nStage            baseline MB/s  current MB/s  change\n";
+    for (auto it = now.constBegin(); it != now.constEnd(); ++it) {
+        if (!before.contains(it.key()) || it.key().startsWith("regex/")) {
+            continue; // The regex reference is not ours to keep fast
+        }
+        const double was = before.value(it.key()).toObject().value("megabytesPerSecond").toDouble();
+        const double is = it.value().toObject().value("megabytesPerSecond").toDouble();
+        const double change = was > 0 ? is / was - 1.0 : 0.0;
+        const bool regressed = change < -tolerance;
+        regressions += regressed ? 1 : 0;
+        out << QString("%1 %2 %3 %4%%5\n")
+               .arg(it.key(), -16)
+               .arg(was, 13, 'f', 1)
+               .arg(is, 13, 'f', 1)
+               .arg(change * 100, 7, 'f', 1)
+               .arg(regressed ? "  REGRESSION" : "");
+    }
+    return regressions;
+}
+
+int runGenerate(const QStringList &arguments)
+{
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Write the synthetic benchmark corpus to a directory.");
+    parser.addHelpOption();
+    CorpusCommandLine corpusOptions;
+    corpusOptions.addTo(parser);
+    parser.addPositionalArgument("directory", "Where to write the files.", "<directory>");
+    parser.process(arguments);
+    if (parser.positionalArguments().size() != 1) {
+        parser.showHelp(2);
+    }
+
+    const QStringList paths = CorpusGenerator(corpusOptions.options(parser)).writeCorpus(parser.positionalArguments().first());
+    QTextStream(stdout) << "Wrote " << paths.size() << " files\n";
+    return paths.isEmpty() ? 1 : 0;
+}
+
+int runBenchmarks(const QStringList &arguments)
+{
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Benchmark extraction, grouping and saving on a synthetic corpus.");
+    parser.addHelpOption();
+    CorpusCommandLine corpusOptions;
+    corpusOptions.addTo(parser);
+    QCommandLineOption repeatOption("repeat", "Runs per stage; the fastest counts (default 3).", "count", "3");
+    QCommandLineOption outputOption({"o", "output"}, "Write the JSON results to <file> instead of standard output.", "file");
+    QCommandLineOption baselineOption("baseline", "Compare with results saved earlier; exit 1 on a regression.", "file");
+    QCommandLineOption toleranceOption("tolerance", "Allowed slowdown against the baseline (default 0.10).", "ratio", "0.10");
+    parser.addOptions({repeatOption, outputOption, baselineOption, toleranceOption});
+    parser.process(arguments);
+
+    QTextStream err(stderr);
+    const CorpusOptions corpus = corpusOptions.options(parser);
+    QTemporaryDir directory;
+    const QStringList paths = CorpusGenerator(corpus).writeCorpus(directory.path());
+    if (paths.isEmpty()) {
+        return 1;
+    }
+
+    const QList<StageResult> results = runSuite(paths, corpus, qMax(1, parser.value(repeatOption).toInt()));
+    err << "Stage              MB/s   comments/s  peak RSS MiB\n";
+    for (const StageResult &result : results) {
+        err << QString("%1 %2 %3 %4\n")
+               .arg(result.name, -12)
+               .arg(result.megabytesPerSecond(), 9, 'f', 1)
+               .arg(result.commentsPerSecond(), 12, 'f', 0)
+               .arg(result.peakRssBytes / double(1024 * 1024), 13, 'f', 1);
+    }
+    // The extraction target is stated against the regex path, so the ratio is printed too
+    for (const StageResult &regex : results) {
+        if (!regex.name.startsWith("regex/")) {
+            continue;
+        }
+        const QString extension = regex.name.mid(6);
+        for (const StageResult &lexer : results) {
+            if (lexer.name == "extract/" + extension && regex.megabytesPerSecond() > 0) {
+                err << QString("Lexer vs regex (%1): %2x\n")
+                       .arg(extension).arg(lexer.megabytesPerSecond() / regex.megabytesPerSecond(), 0, 'f', 1);
+            }
+        }
+    }
+
+    const QJsonObject json = resultsToJson(results, corpus);
+    QFile out;
+    bool opened = false;
+    if (parser.isSet(outputOption)) {
+        out.setFileName(parser.value(outputOption));
+        opened = out.open(QIODevice::WriteOnly | QIODevice::Truncate);
+    } else {
+        opened = out.open(stdout, QIODevice::WriteOnly);
+    }
+    if (!opened) {
+        err << "Could not open output: " << out.errorString() << "\n";
+        return 1;
+    }
+    out.write(QJsonDocument(json).toJson());
+    out.close();
+
+    if (parser.isSet(baselineOption)) {
+        QFile baselineFile(parser.value(baselineOption));
+        if (!baselineFile.open(QIODevice::ReadOnly)) {
+            err << "Could not open baseline: " << baselineFile.fileName() << "\n";
+            return 1;
+        }
+        const QJsonObject baseline = QJsonDocument::fromJson(baselineFile.readAll()).object();
+        if (compareWithBaseline(json, baseline, parser.value(toleranceOption).toDouble(), err) > 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("comments-benchmarks");
+
+    QStringList arguments = app.arguments();
+    const QString command = arguments.size() > 1 ? arguments.takeAt(1) : QString();
+    if (command == "run") {
+        return runBenchmarks(arguments);
+    }
+    if (command == "generate") {
+        return runGenerate(arguments);
+    }
+
+    QTextStream(stderr) << "Usage: comments-benchmarks run [options]\n"
+                        << "       comments-benchmarks generate [options] <directory>\n"
+                        << "Run a command with --help for its options.\n";
+    return 2;
+}
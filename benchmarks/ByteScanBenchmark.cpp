@@ -0,0 +1,119 @@
+// Micro-benchmark for the lexer's candidate-byte kernels: walks a synthetic C++
+// buffer from candidate to candidate with each kernel and reports MB/s, then runs
+// the whole lexer with each kernel, so the vector kernels' gain over byte-by-byte
+// scanning (the scalar table) is measured on the lexer as a whole.
+//
+//   bytescan-benchmark [MiB]
+
+#include "ByteScan.h"
+#include "CommentLexer.h"
+#include <QByteArray>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QTextStream>
+#include <algorithm>
+#include <limits>
+
+namespace {
+
+// Mostly code with the occasional comment and string, like typical C++
+QByteArray syntheticSource(qsizetype bytes)
+{
+    const QByteArray lines[] = {
+        "    for (int index = 0; index < count; ++index) {\n",
+        "        total += values[index] * weights[index];\n",
+        "    }\n",
+        "    // Accumulate the weighted sum\n",
+        "    const auto name = std::string(\"value\");\n",
+        "    result.emplace_back(total, name); // keep order\n",
+        "    /* Block comment\n     * spanning lines */\n",
+        "    if (result.size() > limit) return false;\n",
+    };
+    QByteArray source;
+    source.reserve(bytes + 64);
+    quint32 state = 12345;
+    while (source.size() < bytes) {
+        state = state * 1103515245u + 12345u; // Deterministic across runs
+        source.append(lines[(state >> 16) % (sizeof(lines) / sizeof(lines[0]))]);
+    }
+    return source;
+}
+
+template <typename Function>
+double bestSeconds(int repeats, Function function)
+{
+    qint64 best = std::numeric_limits<qint64>::max();
+    for (int i = 0; i < repeats; ++i) {
+        QElapsedTimer timer;
+        timer.start();
+        function();
+        best = std::min(best, timer.nsecsElapsed());
+    }
+    return double(best) / 1e9;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    const qsizetype mebibytes = app.arguments().size() > 1 ? app.arguments().at(1).toLongLong() : 64;
+    const QByteArray source = syntheticSource(mebibytes * 1024 * 1024);
+    const double megabytes = double(source.size()) / 1e6;
+    const char *begin = source.constData();
+    const char *end = begin + source.size();
+
+    QTextStream out(stdout);
+    out << "Buffer: " << mebibytes << " MiB of synthetic C++\n";
+
+    // The candidate set the C++ lexer uses between tokens
+    const ByteFinder finder{'\n', '"', '/', '\''};
+    qsizetype scalarHits = -1;
+    for (ByteFinder::Kernel kernel : {ByteFinder::Kernel::Scalar, ByteFinder::Kernel::Sse2, ByteFinder::Kernel::Avx2}) {
+        if (!ByteFinder::isSupported(kernel)) {
+            out << QString("%1 not supported on this CPU\n").arg(ByteFinder::kernelName(kernel), -8);
+            continue;
+        }
+        qsizetype hits = 0;
+        const double seconds = bestSeconds(5, [&]() {
+            hits = 0;
+            for (const char *p = finder.find(begin, end, kernel); p < end; p = finder.find(p + 1, end, kernel)) {
+                ++hits;
+            }
+        });
+        if (scalarHits < 0) {
+            scalarHits = hits;
+        }
+        out << QString("%1 %2 MB/s  (%3 candidates%4)\n")
+               .arg(ByteFinder::kernelName(kernel), -8)
+               .arg(megabytes / seconds, 8, 'f', 0)
+               .arg(hits)
+               .arg(hits == scalarHits ? "" : ", MISMATCH");
+    }
+
+    // The whole lexer per kernel; every kernel must find the same comments
+    double scalarSeconds = 0;
+    qsizetype scalarSpans = -1;
+    for (ByteFinder::Kernel kernel : {ByteFinder::Kernel::Scalar, ByteFinder::Kernel::Sse2, ByteFinder::Kernel::Avx2}) {
+        if (!ByteFinder::isSupported(kernel)) {
+            continue;
+        }
+        ByteFinder::setSelectedKernel(kernel);
+        qsizetype spanCount = 0;
+        const double lexSeconds = bestSeconds(3, [&]() {
+            spanCount = CommentLexer(Language::Cpp).scan(source).size();
+        });
+        if (scalarSpans < 0) {
+            scalarSpans = spanCount;
+            scalarSeconds = lexSeconds;
+        }
+        out << QString("lexer    %1 MB/s  (%2 comment lines, %3 kernel, %4x scalar%5)\n")
+               .arg(megabytes / lexSeconds, 8, 'f', 0)
+               .arg(spanCount)
+               .arg(ByteFinder::kernelName(kernel))
+               .arg(scalarSeconds / lexSeconds, 0, 'f', 2)
+               .arg(spanCount == scalarSpans ? "" : ", MISMATCH");
+    }
+    ByteFinder::setSelectedKernel(ByteFinder::activeKernel());
+    return 0;
+}
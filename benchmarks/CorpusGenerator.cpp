@@ -0,0 +1,144 @@
+#include "CorpusGenerator.h"
+#include <QDir>
+#include <QFile>
+#include <QRandomGenerator>
+#include <QTextStream>
+
+namespace {
+
+struct LanguageSamples {
+    QList<QByteArray> code;  // Statements; some hold comment markers inside literals
+    QByteArray lineMarker;   // "//" or "#"
+    bool blockComments;      // "/** ... */" runs
+};
+
+const LanguageSamples &samplesFor(Language language)
+{
+    static const LanguageSamples cpp{
+        {"int value = compute(left, right);", "if (value > limit) {", "}",
+         "std::string url = \"http://example.com/path\";", "result.push_back(value * 2);",
+         "for (size_t i = 0; i < items.size(); ++i) {", "return total / count;", "const char marker = '#';",
+         "auto pattern = R\"(/* not a comment */)\";", "weights[index] += 1'000 * scale;"},
+        "//", true};
+    static const LanguageSamples python{
+        {"value = compute(left, right)", "if value > limit:", "url = \"http://example.com/#anchor\"",
+         "result.append(value * 2)", "for item in items:", "return total / count", "marker = '#'",
+         "text = \"\"\"docstring # not a comment\"\"\"", "weights[index] += 1000 * scale", "pass"},
+        "#", false};
+    static const LanguageSamples typeScript{
+        {"const value = compute(left, right);", "if (value > limit) {", "}",
+         "const url = `http://example.com/${path}`;", "result.push(value * 2);", "for (const item of items) {",
+         "return total / count;", "const marker = '//';", "let pattern = \"/* not a comment */\";",
+         "weights[index] += 1000 * scale;"},
+        "//", true};
+    switch (language) {
+    case Language::Python:
+        return python;
+    case Language::TypeScript:
+        return typeScript;
+    default:
+        return cpp;
+    }
+}
+
+const QList<QByteArray> &words()
+{
+    static const QList<QByteArray> list{
+        "the", "value", "is", "computed", "from", "left", "and", "right", "before", "limit", "check",
+        "TODO:", "FIXME", "cache", "result", "order", "matters", "here", "because", "callers", "expect",
+        "sorted", "output", "see", "issue", "note", "ünïcödé", "weights", "scale", "per", "item"};
+    return list;
+}
+
+QByteArray commentText(QRandomGenerator &random)
+{
+    const QList<QByteArray> &list = words();
+    QByteArray text;
+    const int count = 3 + int(random.bounded(10));
+    for (int i = 0; i < count; ++i) {
+        if (i > 0) {
+            text += ' ';
+        }
+        text += list[int(random.bounded(quint32(list.size())))];
+    }
+    return text;
+}
+
+} // namespace
+
+QString CorpusGenerator::extensionFor(Language language)
+{
+    switch (language) {
+    case Language::Python:
+        return "py";
+    case Language::TypeScript:
+        return "ts";
+    default:
+        return "cpp";
+    }
+}
+
+QByteArray CorpusGenerator::generateFile(Language language, int fileIndex) const
+{
+    // QRandomGenerator with a fixed seed produces the same sequence everywhere
+    QRandomGenerator random(options_.seed * 7919u + quint32(language) * 104729u + quint32(fileIndex));
+    const LanguageSamples &samples = samplesFor(language);
+
+    // A comment event is either one inline comment or a run of comment lines. Pick
+    // the odds so the requested fractions hold per line, not per event.
+    const int maxRun = qMax(1, options_.maxRunLength);
+    const double meanRun = (1.0 + maxRun) / 2.0;
+    const double density = qBound(0.0, options_.commentDensity, 0.99);
+    const double inlineRatio = qBound(0.0, options_.inlineRatio, 1.0);
+    const double inlineEvent = inlineRatio * meanRun / (1.0 - inlineRatio + inlineRatio * meanRun);
+    const double linesPerEvent = inlineEvent + (1.0 - inlineEvent) * meanRun;
+    const double eventChance = density / (linesPerEvent * (1.0 - density) + density);
+
+    QByteArray source;
+    source.reserve(options_.fileBytes + 256);
+    while (source.size() < options_.fileBytes) {
+        const QByteArray indent(4 * int(random.bounded(4)), ' ');
+        const QByteArray &code = samples.code[int(random.bounded(quint32(samples.code.size())))];
+        if (random.generateDouble() >= eventChance) {
+            source += indent + code + '\n';
+        } else if (random.generateDouble() < inlineEvent) {
+            source += indent + code + ' ' + samples.lineMarker + ' ' + commentText(random) + '\n';
+        } else {
+            const int runLength = 1 + int(random.bounded(quint32(maxRun)));
+            const bool block = samples.blockComments && runLength >= 3 && random.bounded(3) == 0;
+            for (int i = 0; i < runLength; ++i) {
+                if (block && i == 0) {
+                    source += indent + "/** " + commentText(random) + '\n';
+                } else if (block && i == runLength - 1) {
+                    source += indent + " * " + commentText(random) + " */\n";
+                } else if (block) {
+                    source += indent + " * " + commentText(random) + '\n';
+                } else {
+                    source += indent + samples.lineMarker + ' ' + commentText(random) + '\n';
+                }
+            }
+        }
+    }
+    return source;
+}
+
+QStringList CorpusGenerator::writeCorpus(const QString &directory) const
+{
+    QStringList paths;
+    if (!QDir().mkpath(directory)) {
+        QTextStream(stderr) << "Could not create " << directory << "\n";
+        return QStringList();
+    }
+    for (Language language : options_.languages) {
+        for (int i = 0; i < options_.filesPerLanguage; ++i) {
+            const QString path = QDir(directory).filePath(QString("corpus_%1.%2").arg(i, 4, 10, QChar('0')).arg(extensionFor(language)));
+            QFile file(path);
+            if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate) || file.write(generateFile(language, i)) < 0) {
+                QTextStream(stderr) << "Could not write " << path << ": " << file.errorString() << "\n";
+                return QStringList();
+            }
+            paths.append(path);
+        }
+    }
+    return paths;
+}
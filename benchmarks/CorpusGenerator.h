@@ -0,0 +1,37 @@
+#pragma once
+
+#include <QByteArray>
+#include <QString>
+#include <QStringList>
+#include "LanguageRegistry.h"
+
+// Shape of the synthetic source files
+struct CorpusOptions {
+    QList<Language> languages = {Language::Cpp, Language::Python, Language::TypeScript};
+    int filesPerLanguage = 20;
+    qsizetype fileBytes = 256 * 1024;
+    double commentDensity = 0.25; // Fraction of lines that carry a comment
+    double inlineRatio = 0.2;     // Fraction of comments that follow code on the same line
+    int maxRunLength = 12;        // Longest run of consecutive comment lines
+    quint32 seed = 1;
+};
+
+// Deterministic source generator for benchmarks: the same options and seed give
+// byte-identical files on every platform. Only C++, Python and TypeScript are
+// generated; the lines mix code, string literals holding comment markers, line and
+// block comments, inline comments and long runs of consecutive comment lines.
+class CorpusGenerator
+{
+public:
+    explicit CorpusGenerator(const CorpusOptions &options) : options_(options) {}
+
+    QByteArray generateFile(Language language, int fileIndex) const;
+
+    // Writes every file into `directory`; returns the paths, or an empty list on failure
+    QStringList writeCorpus(const QString &directory) const;
+
+    static QString extensionFor(Language language);
+
+private:
+    CorpusOptions options_;
+};
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <QtGlobal>
+#include <initializer_list>
+
+// Finds the next occurrence of any byte from a small set (at most 16 bytes). The
+// lexer uses it to jump over code straight to the bytes that can start a comment,
+// literal or line. Vector kernels test 16 (SSE2) or 32 (AVX2) bytes per step; the
+// kernel is picked once from the CPU's features, with a table lookup as fallback.
+class ByteFinder
+{
+public:
+    enum class Kernel { Scalar, Sse2, Avx2 };
+
+    ByteFinder(std::initializer_list<char> bytes);
+
+    // First byte in [p, end) that is in the set, or end
+    const char *find(const char *p, const char *end) const
+    {
+        // Candidates are often adjacent ("//", blank lines), so try the first byte inline
+        if (p < end && table_[uchar(*p)]) {
+            return p;
+        }
+        return activeFind_(*this, p, end);
+    }
+    // Same, with a given kernel; for benchmarks and for comparing kernels
+    const char *find(const char *p, const char *end, Kernel kernel) const;
+
+    bool contains(char c) const { return table_[uchar(c)]; }
+
+    // The fastest kernel this CPU supports
+    static Kernel activeKernel();
+    // The kernel find() uses: activeKernel() unless overridden. Overriding is for
+    // benchmarks and tests that run the lexer per kernel; only while no scan runs.
+    static Kernel selectedKernel() { return selectedKernel_; }
+    static void setSelectedKernel(Kernel kernel);
+    static bool isSupported(Kernel kernel);
+    static const char *kernelName(Kernel kernel);
+
+private:
+    using FindFunction = const char *(*)(const ByteFinder &, const char *, const char *);
+
+    static const char *findScalar(const ByteFinder &finder, const char *p, const char *end);
+    static const char *findSse2(const ByteFinder &finder, const char *p, const char *end);
+    static const char *findAvx2(const ByteFinder &finder, const char *p, const char *end);
+    static FindFunction functionFor(Kernel kernel);
+
+    static Kernel selectedKernel_;
+    static FindFunction activeFind_;
+
+    char bytes_[16] = {};
+    int count_ = 0;
+    bool table_[256] = {};
+    alignas(32) char lanes_[16][32] = {}; // Each byte repeated, loaded as a vector per needle
+};
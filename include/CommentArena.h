@@ -0,0 +1,101 @@
+#pragma once
+
+#include <QList>
+#include <QSharedPointer>
+#include <QString>
+#include <QStringList>
+#include "CommentLexer.h"
+#include "SourceBuffer.h"
+
+// Every comment of one file in struct-of-arrays form. Only the lines that hold a
+// comment are kept, back to back in one text arena; comment i is entry i of the
+// packed arrays, and group g covers comments groupStarts[g] up to the next start.
+// Copies share the arrays, so handing a file between threads and models is cheap.
+struct CommentArena {
+    enum Flags : quint8 { InlineFlag = 1, BlockFragmentFlag = 2, MoreCommentsFlag = 4 };
+
+    QSharedPointer<const SourceBuffer> text; // The comment lines, without line breaks
+    QList<quint32> lineNumbers;
+    QList<quint32> lineEnds;   // Line i is text[lineEnds[i - 1], lineEnds[i]), the first starts at 0
+    QList<quint32> textStarts; // Comment text without marker, decoration and surrounding whitespace
+    QList<quint32> textEnds;
+    QList<quint8> flags;
+    QList<quint32> groupStarts;
+
+    // Copies the commented lines out of `source` and groups comments on consecutive lines
+    static CommentArena build(const char *source, const QList<CommentSpan> &spans);
+
+    int commentCount() const { return lineNumbers.size(); }
+    int groupCount() const { return groupStarts.size(); }
+    int groupBegin(int g) const { return int(groupStarts[g]); }
+    int groupEnd(int g) const { return g + 1 < groupStarts.size() ? int(groupStarts[g + 1]) : lineNumbers.size(); }
+
+    qsizetype lineStart(int i) const { return i == 0 ? 0 : lineEnds[i - 1]; }
+    QString comment(int i) const { return text->decode(textStarts[i], textEnds[i]); }
+    QString fullLine(int i) const { return text->decode(lineStart(i), lineEnds[i]); }
+
+    // Bytes held by the text and the columns
+    qsizetype memoryBytes() const;
+};
+
+// One run of comments on consecutive lines: a range of its file's arena. The group
+// holds a shared copy of the arena, so it stays valid after the model reallocates its
+// files or evicts and reloads this one. Text is decoded only when it is asked for.
+struct CommentGroup {
+    CommentArena arena;
+    int begin = 0;
+    int end = 0;
+
+    CommentGroup(const CommentArena &fileArena, int group)
+        : arena(fileArena), begin(fileArena.groupBegin(group)), end(fileArena.groupEnd(group)) {}
+
+    int size() const { return end - begin; }
+    int lineNumber(int i) const { return int(arena.lineNumbers[begin + i]); }
+    int lastLineNumber() const { return lineNumber(size() - 1); }
+    bool isInline(int i) const { return arena.flags[begin + i] & CommentArena::InlineFlag; }
+    // Inline lines and lines with several comments are shown and edited as the whole line
+    bool showsFullLine(int i) const
+    {
+        return arena.flags[begin + i] & (CommentArena::InlineFlag | CommentArena::MoreCommentsFlag);
+    }
+    bool hasMoreComments(int i) const { return arena.flags[begin + i] & CommentArena::MoreCommentsFlag; }
+    // Only the first comment of a line is saved, so a group with a line of several
+    // comments is shown but not edited or replaced in; returns that line's index or -1
+    int lineWithMoreComments() const
+    {
+        for (int i = 0; i < size(); ++i) {
+            if (hasMoreComments(i)) {
+                return i;
+            }
+        }
+        return -1;
+    }
+    bool isReadOnly() const { return lineWithMoreComments() >= 0; }
+    QString comment(int i) const { return arena.comment(begin + i); }
+    QString fullLine(int i) const { return arena.fullLine(begin + i); }
+
+    QString getLineRange() const {
+        if (size() == 1) {
+            return QString::number(lineNumber(0));
+        }
+        QStringList lineStrings;
+        for (int i = 0; i < size(); ++i) {
+            lineStrings.append(QString::number(lineNumber(i)));
+        }
+        return lineStrings.join("\n");
+    }
+
+    QString getCombinedComments() const {
+        QStringList displayComments;
+        for (int i = 0; i < size(); ++i) {
+            if (showsFullLine(i)) {
+                // For inline comments, show the full line without leading whitespace
+                displayComments.append(fullLine(i).trimmed());
+            } else {
+                // For standalone comments, show just the comment
+                displayComments.append(comment(i));
+            }
+        }
+        return displayComments.join("\n");
+    }
+};
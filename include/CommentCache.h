@@ -0,0 +1,74 @@
+#pragma once
+
+#include <QString>
+#include <QHash>
+#include <QByteArray>
+#include <QReadWriteLock>
+#include <QMutex>
+#include <QSet>
+#include <QSharedPointer>
+#include "CommentExtractor.h"
+
+// Persistent index of extraction results, so reopening a project only re-parses
+// files that changed since the last session.
+//
+// Entries are keyed by path and validated against the file's size and mtime; when
+// those differ but the content hash still matches, the entry is reused as well.
+// Each entry is a file's CommentArena as it sits in memory: the packed comment
+// columns and the commented lines, served straight from the memory-mapped file.
+//
+// File layout (native byte order, 8-byte aligned records):
+//   Header  "CCPCACHE", version, record count, total bytes, header checksum
+//   Record  fixed header (sizes, mtime, content hash, checksum), UTF-8 path,
+//           line number, line end, text start and text end columns, flag
+//           column, group start table, compacted line bytes
+//
+// lookup() and store() are thread-safe and may be called from extraction workers.
+class CommentCache
+{
+public:
+    static constexpr quint32 FormatVersion = 6;
+    static constexpr qint64 DefaultMaxBytes = 256 * 1024 * 1024;
+
+    explicit CommentCache(const QString &cacheFilePath = defaultPath(), qint64 maxBytes = DefaultMaxBytes);
+
+    // Shared by the GUI and comments-cli
+    static QString defaultPath();
+
+    QString filePath() const { return cacheFilePath_; }
+
+    // Maps the cache file. A missing, outdated or corrupt file leaves the cache empty.
+    bool load();
+
+    // Fills `file` from a fresh entry for this path, size and mtime
+    bool lookup(const QString &filePath, qint64 size, qint64 lastModified, FileComments &file) const;
+    // Fills `file` from the entry for this path if its content hash matches
+    bool lookupByHash(const QString &filePath, quint64 hash, FileComments &file) const;
+
+    // Records a freshly extracted (or revalidated) file; written out by save()
+    void store(const FileComments &file);
+
+    // Writes current and new entries atomically, dropping the least recently used
+    // ones beyond the size cap, then maps the new file. Does nothing when no entry
+    // was stored since the last save.
+    bool save();
+
+private:
+    bool indexMapping();
+    qsizetype recordOffset(const QString &filePath) const;
+    bool decodeRecord(qsizetype offset, FileComments &file) const;
+    void markUsed(const QString &filePath) const;
+    static QByteArray encodeRecord(const FileComments &file, qint64 lastUsed);
+
+    QString cacheFilePath_;
+    qint64 maxBytes_;
+    qint64 sessionTime_;
+
+    mutable QReadWriteLock lock_;
+    QSharedPointer<const SourceBuffer> mapping_; // The loaded cache file
+    QHash<QString, qsizetype> records_;          // Path -> record offset in mapping_
+    QHash<QString, QByteArray> pending_;         // Encoded records not yet saved
+
+    mutable QMutex usedMutex_;
+    mutable QSet<QString> used_; // Served this session, kept first when trimming to the cap
+};
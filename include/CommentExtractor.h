@@ -1,55 +1,51 @@
 #pragma once
 
-#include <QObject>
 #include <QStringList>
 #include <QList>
 #include <QPair>
+#include "CommentArena.h"
+#include "CommentLexer.h"
+#include "CommentMetrics.h"
+#include "SourceBuffer.h"
 
-struct CommentGroup {
-    QList<int> lineNumbers;
-    QStringList comments;
-    QStringList fullLines; // Store full line context for inline comments
-    QList<bool> isInline;  // Track which comments are inline
-    
-    QString getLineRange() const {
-        if (lineNumbers.size() == 1) {
-            return QString::number(lineNumbers.first());
-        }
-        QStringList lineStrings;
-        for (int line : lineNumbers) {
-            lineStrings.append(QString::number(line));
-        }
-        return lineStrings.join("\n");
-    }
-    
-    QString getCombinedComments() const {
-        QStringList displayComments;
-        for (int i = 0; i < comments.size(); ++i) {
-            if (i < isInline.size() && isInline[i] && i < fullLines.size()) {
-                // For inline comments, show the full line without leading whitespace
-                displayComments.append(fullLines[i].trimmed());
-            } else {
-                // For standalone comments, show just the comment
-                displayComments.append(comments[i]);
-            }
-        }
-        return displayComments.join("\n");
-    }
+class CommentCache;
+
+// Everything extracted from one file
+struct FileComments {
+    QString filePath;
+    quint64 contentHash = 0; // contentHash() of the bytes the groups were extracted from
+    qint64 size = 0;          // File size and mtime (ms since epoch) taken before reading
+    qint64 lastModified = 0;
+    int lineCount = 0;        // Lines in the file, commented or not
+    CommentArena comments;
+    CommentMetrics metrics;   // Filled in by ExtractionPipeline when asked to
+
+    int groupCount() const { return comments.groupCount(); }
+    // Shares the arena, so it outlives this FileComments
+    CommentGroup group(int g) const { return CommentGroup(comments, g); }
 };
 
-class CommentExtractor : public QObject
+// Stateless apart from its read mode, so one instance (or one per thread) can
+// extract files concurrently from worker threads.
+class CommentExtractor
 {
-    Q_OBJECT
 public:
-    explicit CommentExtractor(QObject *parent = nullptr);
+    // File name globs of the languages the extractor understands
+    static QStringList supportedNameFilters() { return LanguageRegistry::nameFilters(); }
 
-    QList<QPair<int, QString>> extractComments(const QString &filePath);
-    QList<QPair<int, QPair<QString, QString>>> extractCommentsWithContext(const QString &filePath);
-    QList<CommentGroup> extractGroupedComments(const QString &filePath);
+    // How source files are loaded; Auto memory-maps large files
+    void setReadMode(SourceBuffer::ReadMode mode) { readMode_ = mode; }
 
-private:
-    bool isInlineComment(const QString &fullLine, const QString &comment);
+    // Optional persistent cache consulted by extractFile(); unchanged files are not re-parsed
+    void setCache(CommentCache *cache) { cache_ = cache; }
 
-signals:
+    QList<QPair<int, QString>> extractComments(const QString &filePath) const;
+    QList<QPair<int, QPair<QString, QString>>> extractCommentsWithContext(const QString &filePath) const;
+    FileComments extractFile(const QString &filePath) const;
 
-};
\ No newline at end of file
+private:
+    QSharedPointer<const SourceBuffer> scanFile(const QString &filePath, QList<CommentSpan> &spans) const;
+
+    SourceBuffer::ReadMode readMode_ = SourceBuffer::ReadMode::Auto;
+    CommentCache *cache_ = nullptr;
+};
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <QSortFilterProxyModel>
+#include "CommentIndex.h"
+
+// Shows only the files and comment groups of a CommentTreeModel that matched the
+// last search; shows everything while no search is active.
+class CommentFilterModel : public QSortFilterProxyModel
+{
+    Q_OBJECT
+public:
+    explicit CommentFilterModel(QObject *parent = nullptr);
+
+    void setMatches(const CommentMatches &matches);
+    void clearMatches();
+    bool isFiltering() const { return filtering_; }
+
+protected:
+    bool filterAcceptsRow(int sourceRow, const QModelIndex &sourceParent) const override;
+
+private:
+    CommentMatches matches_;
+    bool filtering_ = false;
+};
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <QBitArray>
+#include <QByteArray>
+#include <QDeadlineTimer>
+#include <QHash>
+#include <QList>
+#include <QRegularExpression>
+#include <QString>
+#include <QStringList>
+#include <QThreadPool>
+#include "CommentArena.h"
+
+// What to look for; every condition that is set must match
+struct CommentQuery {
+    QString text;             // Substring, case-insensitive for ASCII letters
+    QRegularExpression regex; // Matched against the group text when the pattern is not empty
+    QStringList tags;         // Any of these tags, see CommentIndex::knownTags()
+
+    bool isEmpty() const { return text.isEmpty() && regex.pattern().isEmpty() && tags.isEmpty(); }
+};
+
+// Matching comment groups, addressed like CommentTreeModel rows
+struct CommentMatches {
+    QList<QBitArray> groups; // Per file row; empty when nothing in the file matches
+    int groupCount = 0;
+    int fileCount = 0;
+
+    bool fileMatches(int fileRow) const { return fileRow < groups.size() && !groups[fileRow].isEmpty(); }
+    bool groupMatches(int fileRow, int groupRow) const {
+        return fileMatches(fileRow) && groupRow < groups[fileRow].size() && groups[fileRow].testBit(groupRow);
+    }
+};
+
+// Inverted index over the text of every loaded comment group, updated as files
+// load, reload and are edited. Substring queries intersect the posting lists of
+// the query's byte trigrams and only verify the remaining candidates; tags such
+// as TODO and FIXME have posting lists of their own. Queries that cannot use a
+// posting list (short substrings, regular expressions) scan in parallel.
+//
+// Unedited groups are read from their file's CommentArena, which the index shares
+// with the model, so indexing neither decodes nor copies comment text; only edited
+// groups keep a UTF-8 copy of their own. Files the model evicts are removed, so
+// their arena is released, and scanned with scanFile() instead.
+class CommentIndex
+{
+public:
+    CommentIndex();
+
+    // Upper-case markers recognised as whole words, e.g. "TODO:" or "FIXME(ana)"
+    static QStringList knownTags();
+
+    void clear();
+    // Indexes a file's groups, replacing what was indexed for that row before;
+    // `editedText` holds the groups whose text differs from the arena's
+    void setFile(int fileRow, const CommentArena &comments, const QHash<int, QString> &editedText = {});
+    // The same in pieces: beginFile() drops what was indexed for the row, then each
+    // indexMore() adds the next groups until `deadline`. True once the file is done.
+    void beginFile(int fileRow, const CommentArena &comments);
+    bool indexMore(int fileRow, const QHash<int, QString> &editedText, QDeadlineTimer deadline);
+    // Drops a file's groups and its share of the arena, e.g. when the model evicts it
+    void removeFile(int fileRow);
+    // Indexes an edited group's text
+    void setGroup(int fileRow, int groupRow, const QString &text);
+    // Indexes a group's extracted text again, after its edit was undone
+    void restoreGroup(int fileRow, int groupRow);
+
+    CommentMatches search(const CommentQuery &query) const;
+    // Matches the groups of a file that is not indexed by reading each of them, with
+    // `editedText` in place of the arena's text; empty when none match. Thread-safe.
+    static QBitArray scanFile(const CommentQuery &query, const CommentArena &comments,
+                              const QHash<int, QString> &editedText = {});
+
+private:
+    struct Document {
+        int fileRow = 0;
+        int groupRow = 0;
+        quint32 tags = 0;       // Bit i set for knownTags()[i]
+        bool live = false;
+        bool edited = false;
+        QByteArray editedText;  // UTF-8 of an edited group; released when the document is removed
+    };
+
+    QByteArrayView textOf(const Document &document, QByteArray &scratch) const;
+    quint32 addDocument(int fileRow, int groupRow, const QString *editedText);
+    quint32 insertDocument(Document document);
+    void removeDocument(quint32 id);
+    void compactIfSparse();
+
+    QList<Document> documents_;                // Indexed by document id
+    QList<QList<quint32>> fileDocuments_;      // File row -> document id of each group row
+    QList<CommentArena> fileArenas_;           // File row -> its comments, shared with the model
+    QHash<quint32, QList<quint32>> trigrams_;  // ASCII-folded byte trigram -> ascending ids
+    QList<QList<quint32>> tagDocuments_;       // Per known tag, ascending ids
+    int liveCount_ = 0;
+
+    mutable QThreadPool pool_; // Parallel verification for large candidate sets
+};
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <QList>
+#include <QString>
+#include <QByteArray>
+#include "LanguageRegistry.h"
+
+// One comment line found by the lexer, as byte offsets into the scanned buffer.
+// Lines of a block comment are reported separately; when several comments share
+// a line, the first one is reported and flagged with hasMoreComments.
+struct CommentSpan {
+    int lineNumber = 0;       // 1-based
+    qsizetype lineStart = 0;  // First byte of the line
+    qsizetype lineEnd = 0;    // End of the line, excluding "\r\n" / "\n"
+    qsizetype textStart = 0;  // Comment text without marker, decoration and surrounding whitespace
+    qsizetype textEnd = 0;
+    qsizetype commentStart = 0; // The whole comment on this line, markers included ("// x", "/* x */")
+    qsizetype commentEnd = 0;
+    bool isInline = false;    // Code precedes the comment on this line
+    bool isBlockFragment = false; // Part of a block comment that is not both opened and closed on this line
+    bool hasMoreComments = false; // Other comments follow on this line; only the full line shows them
+};
+
+// Single-pass comment lexer. Reads each byte once, tracks string/char literals so
+// markers inside them are ignored, and follows block comments across lines. The
+// scanner is compiled once per language; scan() picks the instance up front.
+class CommentLexer
+{
+public:
+    explicit CommentLexer(Language language) : language_(language) {}
+
+    QList<CommentSpan> scan(const char *data, qsizetype size) const;
+    QList<CommentSpan> scan(const QByteArray &data) const { return scan(data.constData(), data.size()); }
+
+private:
+    Language language_;
+};
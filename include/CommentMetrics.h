@@ -0,0 +1,67 @@
+#pragma once
+
+#include <QHash>
+#include <QSet>
+#include <QString>
+#include <QStringList>
+
+struct FileComments;
+
+// Comment statistics of one file, or summed over the files of a directory
+struct CommentMetrics {
+    int files = 0;
+    qint64 lines = 0;
+    qint64 commentLines = 0;
+    qint64 inlineLines = 0;          // Comments after code on the same line
+    qint64 blockLines = 0;           // Comment lines of their own
+    qint64 todoCount = 0;            // Whole-word TODO and FIXME in comment text
+    qint64 fixmeCount = 0;
+    int longestUncommented = 0;      // Longest run of lines without a comment
+    int longestUncommentedStart = 0; // Its first line, in `longestUncommentedFile`
+    QString longestUncommentedFile;
+
+    // Reads the arena only; cheap enough to run on every extracted file
+    static CommentMetrics forFile(const FileComments &file);
+    // The reduce step: sums the counts and keeps the longer uncommented run
+    void add(const CommentMetrics &other);
+
+    double density() const { return lines > 0 ? double(commentLines) / double(lines) : 0.0; }
+    double inlineRatio() const { return commentLines > 0 ? double(inlineLines) / double(commentLines) : 0.0; }
+};
+
+// Per-file metrics rolled up per directory. A directory's rollup is reduced from
+// its own files and the rollups of its subdirectories, so rebuild() reduces one
+// depth level at a time on a worker pool, deepest first, and updateFile() only
+// reduces the directories above the file again.
+class CommentMetricsReport
+{
+public:
+    void clear();
+    // Records a file's metrics; rollups are brought up to date by rebuild()
+    void setFile(const QString &filePath, const CommentMetrics &metrics);
+    // Records a file and brings the rollups of its directories up to date
+    void updateFile(const QString &filePath, const CommentMetrics &metrics);
+    void rebuild();
+
+    // The deepest directory that holds every file, or an empty string without files
+    QString root() const;
+    // Absolute paths, sorted
+    QStringList subdirectories(const QString &directory) const;
+    QStringList files(const QString &directory) const;
+    CommentMetrics directory(const QString &directory) const { return directories_.value(directory).total; }
+    CommentMetrics file(const QString &filePath) const { return files_.value(filePath); }
+    int fileCount() const { return int(files_.size()); }
+
+private:
+    struct Directory {
+        QSet<QString> files;
+        QSet<QString> subdirectories;
+        CommentMetrics total;
+    };
+
+    QString link(const QString &filePath);
+    void reduce(Directory &directory) const;
+
+    QHash<QString, CommentMetrics> files_;  // By absolute path
+    QHash<QString, Directory> directories_; // Every ancestor of a file, up to the file system root
+};
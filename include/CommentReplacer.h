@@ -0,0 +1,44 @@
+#pragma once
+
+#include <QRegularExpression>
+#include <QString>
+#include "LanguageRegistry.h"
+
+struct CommentGroup;
+
+// Find-and-replace confined to comment text: code on a line with an inline comment
+// is never matched. Holds no mutable state, so worker threads share one instance.
+class CommentReplacer
+{
+public:
+    enum class Syntax {
+        Literal, // `find` and `replacement` are plain text
+        Regex    // `find` is a regular expression; \1..\99 in `replacement` insert its captures
+    };
+
+    CommentReplacer(const QString &find, const QString &replacement, Syntax syntax, Qt::CaseSensitivity cs);
+
+    bool isValid() const { return pattern_.isValid(); }
+    QString errorString() const { return pattern_.errorString(); }
+    Syntax syntax() const { return syntax_; }
+    QString find() const { return find_; }
+    Qt::CaseSensitivity caseSensitivity() const { return cs_; }
+
+    // Replaces every match in one line of comment text; returns the number of matches
+    int replaceInComment(QString &comment) const;
+    // Replaces in one line as the tree shows it; an inline line is lexed so only the
+    // comment after its code changes
+    int replaceInLine(QString &line, bool isInline, Language language) const;
+    // Replaces in a group's text as shown, whose first lines are the lines of `group`.
+    // A read-only group (a line with several comments) is left as is.
+    int replaceInGroup(QString &text, const CommentGroup &group, Language language) const;
+
+private:
+    QString expand(const QRegularExpressionMatch &match) const;
+
+    QString find_;
+    QString replacement_;
+    Syntax syntax_;
+    Qt::CaseSensitivity cs_;
+    QRegularExpression pattern_;
+};
@@ -1,24 +1,107 @@
 #pragma once
 
-#include <QObject>
 #include <QString>
+#include <QStringList>
 #include <QList>
-#include <QPair>
+#include <QByteArrayView>
+#include <functional>
 
-class CommentSaver : public QObject
+struct CommentSpan;
+class QIODevice;
+class SourceBuffer;
+
+// One change to a source file, anchored to a line of the file as it was extracted
+struct CommentEdit {
+    enum class Kind {
+        Replace,     // Replace the comment text on `line`; further lines of `text` become comment lines after it
+        InsertAfter, // Add comment lines after `line`, one per line of `text`; 0 inserts at the top of the file
+        Delete       // Remove the comment on `line`, and the line itself if nothing else is on it
+    };
+
+    Kind kind = Kind::Replace;
+    int line = 0;   // 1-based line in the original file
+    int order = 0;  // InsertAfter: position among the lines inserted after the same anchor
+    QString text;
+
+    static CommentEdit replace(int line, const QString &text) { return {Kind::Replace, line, 0, text}; }
+    static CommentEdit insertAfter(int line, int order, const QString &text) { return {Kind::InsertAfter, line, order, text}; }
+    static CommentEdit remove(int line) { return {Kind::Delete, line, 0, QString()}; }
+};
+
+// The edits for one file and, once saved, the outcome
+struct FileSaveJob {
+    QString filePath;
+    QList<CommentEdit> edits;
+    quint64 contentHash = 0; // contentHash() of the file the edits' lines refer to; 0 skips the check
+    bool saved = false;
+    QString error; // Why the save failed
+};
+
+// A run of changed lines with the unchanged lines around it, as in a unified diff
+struct DiffHunk {
+    int oldStart = 0;   // 1-based first line in the original file
+    int oldCount = 0;
+    int newCount = 0;
+    QStringList lines;  // " context", "-removed" or "+added", without line endings
+    QList<int> edits;   // Indices of the job's edits that make this change
+    bool accepted = true;
+};
+
+// What saving a file's edits would change, computed only around the edited lines
+struct FilePreview {
+    static constexpr int ContextLines = 3;
+
+    QString filePath;
+    QList<DiffHunk> hunks;
+    QString error; // Why the preview could not be made
+
+    // The accepted hunks as a unified diff; line numbers account for rejected hunks
+    QString unifiedDiff() const;
+    // The edits of the accepted hunks, out of the edits the preview was made from
+    QList<CommentEdit> acceptedEdits(const QList<CommentEdit> &edits) const;
+};
+
+// Called as files are written and committed; may be called from worker threads
+using SaveProgress = std::function<void(int completed, int total, const QString &filePath)>;
+
+// Writes comment edits back into source files. One instance per thread; saveAll()
+// writes the files of a batch concurrently and commits them as one transaction.
+class CommentSaver
 {
-    Q_OBJECT
 public:
-    explicit CommentSaver(QObject *parent = nullptr);
+    // Applies a batch of edits in one pass; all anchors refer to the file before the batch.
+    // With `expectedHash`, a file whose content no longer has that hash is left alone,
+    // since its line numbers may no longer be the ones the edits were made against.
+    bool applyEdits(const QString &filePath, const QList<CommentEdit> &edits, quint64 expectedHash = 0);
 
-    bool saveComments(const QString &filePath, const QList<QPair<int, QString>> &comments);
-    bool saveCommentsWithMultiLine(const QString &filePath, const QList<QPair<int, QString>> &comments);
+    // Computes the hunks saving `edits` would produce, without writing anything
+    bool preview(const QString &filePath, const QList<CommentEdit> &edits, FilePreview &preview,
+                 quint64 expectedHash = 0);
+
+    // Description of the last failure
+    QString errorString() const { return errorString_; }
+
+    // Saves a batch as a transaction and waits for it: every new file is written
+    // beside its original on a worker pool and synced to disk, then the originals are
+    // replaced by atomic renames. If any file fails, the replaced originals are
+    // restored and no file is changed. A file that no longer has its job's contentHash,
+    // when staged or just before it is replaced, fails the batch. Returns true if the
+    // batch was committed.
+    static bool saveAll(QList<FileSaveJob> &jobs, const SaveProgress &progress = SaveProgress());
+    // Previews every job of a batch on a worker pool, in the order of `jobs`
+    static QList<FilePreview> previewAll(const QList<FileSaveJob> &jobs);
 
 private:
-    QString getCommentMarker(const QString &filePath);
+    bool checkUnchanged(const QString &filePath, const SourceBuffer &source, quint64 expectedHash);
+    bool writeEdited(const QString &filePath, const QList<CommentEdit> &edits, quint64 expectedHash, QIODevice &out);
+    bool stage(const QString &filePath, const QList<CommentEdit> &edits, quint64 expectedHash, QString &tempPath);
+    bool editLine(QByteArrayView line, const CommentSpan *span, const CommentEdit &edit, const QString &marker,
+                  QByteArrayView eol, QByteArray &result);
+    QByteArray replaceLine(QByteArrayView line, const CommentSpan *span, const QString &comment, const QString &marker,
+                           QByteArrayView eol);
+    static QByteArray deleteComment(QByteArrayView line, const CommentSpan &span);
     QString getIndentation(const QString &line);
     QStringList expandMultiLineComment(const QString &comment, const QString &marker, const QString &indentation);
 
-signals:
-
+    QString errorString_;
 };
\ No newline at end of file
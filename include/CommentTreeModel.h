@@ -0,0 +1,196 @@
+#pragma once
+
+#include <QAbstractItemModel>
+#include <QHash>
+#include <QMap>
+#include <QThreadPool>
+#include <atomic>
+#include <functional>
+#include "CommentExtractor.h"
+#include "CommentIndex.h"
+#include "CommentReplacer.h"
+#include "GitChanges.h"
+
+// What a find-and-replace reads, taken from the model on the GUI thread so the
+// plan can be made on another. Arenas and edits are implicitly shared copies.
+struct ReplaceSnapshot {
+    struct File {
+        QString path;
+        quint64 contentHash = 0;
+        CommentArena comments;
+        bool evicted = false;
+        QHash<int, QString> editedText;
+        QBitArray groups;  // Candidate groups; empty for all
+        bool skip = false; // No candidate in this file
+    };
+    QList<File> files; // Per file row
+    std::function<FileComments(const QString &filePath)> loader; // Reads evicted files
+};
+
+// What a find-and-replace would change: the new text of each affected group
+struct ReplacePlan {
+    QList<QHash<int, QString>> groupTexts; // Per file row: group row -> replaced text
+    QList<quint64> contentHashes;          // Per file row, when planned
+    QList<CommentArena> loadedComments;    // Per file row: the comments each changed file was planned on
+    int matchCount = 0;
+    int groupCount = 0;
+    int fileCount = 0;
+    int readOnlyGroupCount = 0; // Matching groups left out, as they hold a line of several comments
+};
+
+// All loaded files and their comment groups as one tree: a parent row per file and
+// a child row per comment group (columns: Line, Comment). Text is decoded only when
+// a view asks for a row, and row heights are computed once and cached.
+//
+// Comment data is kept within a memory budget: past it, clean files are evicted
+// to their path, hash and group offsets, least recently shown first, and dropped
+// from the search index. When a view asks for their rows they are loaded again in
+// the background (from the comment cache, or by re-parsing) and shown as
+// placeholders until then. Files with unsaved edits are never evicted.
+class CommentTreeModel : public QAbstractItemModel
+{
+    Q_OBJECT
+public:
+    enum Column { LineColumn = 0, CommentColumn = 1, ColumnCount = 2 };
+
+    static constexpr qsizetype DefaultMemoryBudget = qsizetype(512) * 1024 * 1024;
+    using FileLoader = std::function<FileComments(const QString &filePath)>;
+
+    explicit CommentTreeModel(QObject *parent = nullptr);
+
+    void clear();
+    // `changes`, when given, marks each group as new or modified since a revision
+    int appendFile(const FileComments &file, const FileChanges *changes = nullptr);
+    // Swaps in freshly extracted groups for a file row, dropping that file's edits and change marks
+    void replaceFile(int fileRow, const FileComments &file);
+
+    int fileCount() const { return files_.size(); }
+    int rowForPath(const QString &filePath) const { return rowByPath_.value(filePath, -1); }
+    QString filePath(int fileRow) const { return files_[fileRow].path; }
+    quint64 contentHash(int fileRow) const { return files_[fileRow].contentHash; }
+    int groupCount(int fileRow) const { return files_[fileRow].comments.groupCount(); }
+    // The group as extracted, holding its own share of the arena, so it stays valid
+    // after the row is replaced or evicted; loads the file again if it was evicted
+    CommentGroup group(int fileRow, int groupRow) const;
+
+    // Bytes of comment data to keep in memory; 0 keeps every file
+    void setMemoryBudget(qsizetype bytes);
+    // Loads an evicted file again; without a loader nothing is evicted
+    void setFileLoader(const FileLoader &loader) { loader_ = loader; }
+    qsizetype residentBytes() const { return residentBytes_; }
+    bool isResident(int fileRow) const { return !files_[fileRow].evicted; }
+
+    ChangeKind groupChange(int fileRow, int groupRow) const {
+        const QList<ChangeKind> &changes = files_[fileRow].groupChanges;
+        return groupRow < changes.size() ? changes[groupRow] : ChangeKind::Unchanged;
+    }
+
+    // A file or group is dirty while it holds edits that differ from the extracted text
+    bool isDirty(int fileRow) const { return !files_[fileRow].editedText.isEmpty(); }
+    bool isGroupDirty(int fileRow, int groupRow) const { return files_[fileRow].editedText.contains(groupRow); }
+    QList<int> dirtyGroups(int fileRow) const;
+    QList<int> dirtyFiles() const;
+    void clearEdits(int fileRow);
+    // Flags a file whose content changed on disk while it had unsaved edits; its edits
+    // refer to lines that may have moved, so it must not be saved
+    void setChangedOnDisk(int fileRow, bool changed);
+    bool isChangedOnDisk(int fileRow) const { return files_[fileRow].changedOnDisk; }
+    // The user's edit if the group was edited, otherwise the extracted comments
+    QString groupText(int fileRow, int groupRow) const;
+
+    // Appended files are indexed separately, in pieces, so loading a large file does
+    // not hold up painting. Indexes until `deadline`; true once every file is indexed.
+    bool indexPending(QDeadlineTimer deadline);
+    bool hasPendingIndex() const { return indexedRows_ < files_.size(); }
+    // Searches the current text of every group (edits included). Returns at once with
+    // the index's matches; files outside the index (still being indexed, or evicted)
+    // are scanned in the background, and searchCompleted() then delivers the full
+    // result, unless another search or cancelSearch() came first.
+    CommentMatches search(const CommentQuery &query);
+    void cancelSearch();
+    // Files the latest search is still scanning
+    int searchPendingFiles() const { return searchPendingFiles_; }
+
+    // Takes what planReplace() reads; cheap, and narrowed to the index's candidates
+    // for plain text
+    ReplaceSnapshot snapshotForReplace(const CommentReplacer &replacer) const;
+    // Runs a replace over the current text of every group (edits included) on a worker
+    // pool, without changing anything; evicted files are read through the loader.
+    // Touches no model, so it can run off the GUI thread.
+    static ReplacePlan planReplace(const ReplaceSnapshot &snapshot, const CommentReplacer &replacer);
+    // Stores a plan's texts as edits, as if each group had been edited by hand. Files
+    // whose content changed since the snapshot are left out; returns their number.
+    int applyReplace(const ReplacePlan &plan);
+
+    QModelIndex index(int row, int column, const QModelIndex &parent = QModelIndex()) const override;
+    QModelIndex parent(const QModelIndex &child) const override;
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    bool setData(const QModelIndex &index, const QVariant &value, int role = Qt::EditRole) override;
+    Qt::ItemFlags flags(const QModelIndex &index) const override;
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+
+signals:
+    // Every match of the latest search(), once the files outside the index are scanned
+    void searchCompleted(const CommentMatches &matches);
+    // setData() turned an edit down, e.g. one that changed the code of an inline line
+    void editRefused(const QString &reason);
+
+private:
+    struct FileEntry {
+        QString path;
+        quint64 contentHash = 0;
+        bool changedOnDisk = false;
+        QHash<int, QString> editedText;  // Group row -> text as edited
+        QList<ChangeKind> groupChanges;  // Empty unless the file was compared with a revision
+        mutable QList<int> rowHeights;   // Cached size hints, -1 until first requested
+        // Loaded and evicted on demand, also while a view reads the model
+        mutable CommentArena comments;   // Only the group offsets while evicted
+        mutable bool evicted = false;
+        mutable bool reloadQueued = false;
+        mutable quint64 lruKey = 0;
+    };
+
+    // A file search() scans because the index does not hold it
+    struct PendingScan {
+        int fileRow = 0;
+        QString path;
+        quint64 contentHash = 0;
+        CommentArena comments; // Only the group offsets while evicted
+        QHash<int, QString> editedText;
+        bool evicted = false;
+        QBitArray groups;      // Filled in by the scan
+    };
+
+    // LRU keys: files a view has shown rank above files that were only loaded
+    static constexpr quint64 ShownKey = quint64(1) << 62;
+
+    // Child rows carry their file row + 1 as internal id; file rows carry 0
+    static bool isFileRow(const QModelIndex &index) { return index.internalId() == 0; }
+    static int fileRowOf(const QModelIndex &index) { return int(index.internalId()) - 1; }
+
+    bool ensureResident(int fileRow) const;
+    bool loadResident(int fileRow) const;
+    void handleFileLoaded(const FileComments &file);
+    void makeResident(int fileRow, const CommentArena &comments);
+    void addResident(int fileRow, quint64 key) const;
+    void removeResident(int fileRow) const;
+    void evictToBudget() const;
+    void finishSearch(int generation, CommentMatches matches, const QList<PendingScan> &scans);
+
+    QList<FileEntry> files_;
+    QHash<QString, int> rowByPath_;
+    mutable CommentIndex index_; // Evicted and reloaded files leave and rejoin it while a view reads
+    int indexedRows_ = 0;       // Rows below this are indexed
+    bool indexStarted_ = false; // Row indexedRows_ is partly indexed
+
+    FileLoader loader_;
+    qsizetype memoryBudget_ = DefaultMemoryBudget;
+    mutable qsizetype residentBytes_ = 0;
+    mutable QMap<quint64, int> lru_; // LRU key -> row of each resident file, oldest first
+    mutable quint64 useCounter_ = 0;
+    std::atomic<int> searchGeneration_{0}; // Workers of an older search stop early
+    int searchPendingFiles_ = 0;
+    mutable QThreadPool loadPool_;   // Loads evicted files the view asks for, and scans them for search()
+};
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <QtGlobal>
+#include <cstring>
+
+// Fast 64-bit content fingerprint used to tell whether a file really changed.
+// Stable across runs on the same machine; not a cryptographic hash.
+inline quint64 contentHash(const char *data, qsizetype size)
+{
+    const quint64 multiplier = 0x9E3779B97F4A7C15ULL;
+    quint64 hash = 0xCBF29CE484222325ULL ^ quint64(size);
+
+    qsizetype i = 0;
+    for (; i + 8 <= size; i += 8) {
+        quint64 word;
+        std::memcpy(&word, data + i, 8);
+        hash = (hash ^ word) * multiplier;
+        hash ^= hash >> 32;
+    }
+
+    quint64 tail = 0;
+    std::memcpy(&tail, data + i, size_t(size - i));
+    hash = (hash ^ tail) * multiplier;
+    hash ^= hash >> 29;
+    hash *= multiplier;
+    hash ^= hash >> 32;
+    return hash;
+}
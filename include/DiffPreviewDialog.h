@@ -0,0 +1,36 @@
+#pragma once
+
+#include <QDialog>
+#include "CommentSaver.h"
+
+class QLabel;
+class QPushButton;
+class QPlainTextEdit;
+class QTreeWidget;
+class QTreeWidgetItem;
+
+// Shows what a save would change as a unified diff per file, with a check box per
+// hunk to accept or reject it. Only the selected file's diff is rendered.
+class DiffPreviewDialog : public QDialog
+{
+    Q_OBJECT
+public:
+    explicit DiffPreviewDialog(const QList<FilePreview> &previews, QWidget *parent = nullptr);
+
+    // The previews as shown, with each hunk accepted or rejected by the user
+    QList<FilePreview> previews() const { return previews_; }
+
+private slots:
+    void handleItemChanged(QTreeWidgetItem *item);
+    void showCurrentFile();
+
+private:
+    void setAllAccepted(bool accepted);
+    void updateSummary();
+
+    QList<FilePreview> previews_;
+    QTreeWidget *tree_;
+    QPlainTextEdit *diffView_;
+    QLabel *summaryLabel_;
+    QPushButton *saveButton_;
+};
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <QObject>
+#include <QThreadPool>
+#include <QStringList>
+#include <QSharedPointer>
+#include <atomic>
+#include "IgnoreRules.h"
+
+// Walks a directory tree on a worker pool, one task per directory, and streams
+// matching files back to the owning thread as they are found. Honours .gitignore
+// files so ignored directories (build/, node_modules/) are never entered.
+class DirectoryScanner : public QObject
+{
+    Q_OBJECT
+public:
+    explicit DirectoryScanner(QObject *parent = nullptr);
+    ~DirectoryScanner();
+
+    // Globs a file must match (file name, or path relative to the root if the glob
+    // contains '/'). Globs starting with '!' exclude files instead.
+    void setNameFilters(const QStringList &nameFilters) { nameFilters_ = nameFilters; }
+
+    void start(const QString &rootPath);
+    void cancel();
+    bool isRunning() const { return run_ != nullptr; }
+
+signals:
+    void fileFound(const QString &filePath);
+    void finished(bool cancelled);
+
+private:
+    // State shared by all tasks of one walk; tasks of a cancelled walk keep their own copy alive
+    struct Run {
+        QString rootPath; // Ends with '/'
+        QStringList includeFilters;
+        QStringList excludeFilters;
+        std::atomic<int> outstanding{0};
+        std::atomic<bool> cancelled{false};
+    };
+
+    void scanDirectory(const QSharedPointer<Run> &run, const QString &path,
+                       const QSharedPointer<const IgnoreRules> &parentRules);
+    void taskDone(const QSharedPointer<Run> &run);
+    static bool matchesFilters(const Run &run, const QString &filePath, const QString &fileName);
+
+    QThreadPool pool_;
+    QStringList nameFilters_;
+    QSharedPointer<Run> run_; // Owner thread only
+};
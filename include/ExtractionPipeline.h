@@ -0,0 +1,58 @@
+#pragma once
+
+#include <QObject>
+#include <QThreadPool>
+#include <QMap>
+#include <QThread>
+#include <atomic>
+#include "CommentExtractor.h"
+
+// Extracts comment groups from many files on a worker pool (one thread per core)
+// and hands the results back on the owning thread, in the order files were queued.
+class ExtractionPipeline : public QObject
+{
+    Q_OBJECT
+public:
+    explicit ExtractionPipeline(QObject *parent = nullptr);
+    ~ExtractionPipeline();
+
+    // Starts a new run over a known list of files, cancelling any previous run
+    void start(const QStringList &filePaths);
+
+    // Streaming use: begin a run, queue files as they are discovered, then close the input
+    void begin();
+    void enqueue(const QString &filePath);
+    void finishInput();
+
+    void cancel();
+    bool isRunning() const { return running_; }
+
+    // Persistent cache shared with other pipelines; set while no run is active
+    void setCache(CommentCache *cache) { extractor_.setCache(cache); }
+    // Workers also fill in FileComments::metrics (the map step of the metrics report);
+    // set while no run is active
+    void setComputeMetrics(bool compute) { computeMetrics_ = compute; }
+
+signals:
+    void fileExtracted(int index, const FileComments &file);
+    void progressChanged(int completed, int total);
+    void finished(bool cancelled);
+
+private:
+    void deliver(quint64 generation, int index, const FileComments &result);
+    void finishIfDone();
+
+    CommentExtractor extractor_;
+    bool computeMetrics_ = false;
+    QThreadPool pool_;
+    std::atomic<bool> cancelled_{false};
+
+    // Owner-thread state
+    quint64 generation_ = 0;
+    bool running_ = false;
+    bool inputFinished_ = false;
+    int queued_ = 0;
+    int completed_ = 0;
+    int nextToDeliver_ = 0;
+    QMap<int, FileComments> outOfOrder_; // Finished early, waiting for earlier files
+};
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <QHash>
+#include <QList>
+#include <QPair>
+#include <QString>
+#include <QStringList>
+
+// How a line or comment group differs from the revision a scan compares against
+enum class ChangeKind : quint8 {
+    Unchanged,
+    New,      // Only added lines (or a file absent at the revision)
+    Modified  // Replaced lines, or a group mixing changed and unchanged lines
+};
+
+// Lines of one file that differ from the revision, as 1-based inclusive ranges of
+// the current file
+struct FileChanges {
+    bool newFile = false; // Untracked, or absent at the revision
+    QList<QPair<int, int>> added;
+    QList<QPair<int, int>> modified;
+
+    ChangeKind lineChange(int line) const;
+};
+
+// Files of a local git working tree that differ from a revision, read through the
+// `git` executable (diff, ls-files), so it works offline against any local clone.
+// The working tree is compared as it is on disk: staged, unstaged and untracked
+// files all count. Calls block until git is done; run them off the GUI thread.
+class GitChanges
+{
+public:
+    // Compares `path` (a directory or file inside a working tree) with `revision`.
+    // "HEAD" gives uncommitted changes; "main..." compares with the merge base of
+    // main and HEAD, i.e. what the current branch changed.
+    bool load(const QString &path, const QString &revision);
+    QString errorString() const { return errorString_; }
+
+    QString revision() const { return revision_; }
+    // Absolute paths of changed files that still exist
+    QStringList files() const { return files_.keys(); }
+    // Null if the file did not change
+    const FileChanges *changesFor(const QString &filePath) const;
+
+    // Adds the files of `git diff -U0` output, its paths relative to `root`; load()
+    // feeds it git's output, tests feed it diffs of their own
+    void parseDiff(const QString &root, const QByteArray &diff);
+
+private:
+    bool runGit(const QString &workingDirectory, const QStringList &arguments, QByteArray &output);
+
+    QString revision_;
+    QHash<QString, FileChanges> files_;
+    QString errorString_;
+};
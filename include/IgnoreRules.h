@@ -0,0 +1,36 @@
+#pragma once
+
+#include <QString>
+#include <QList>
+#include <QSharedPointer>
+
+// Glob match in .gitignore style: '*' and '?' stop at '/', "**/" spans directories,
+// "[a-z]" / "[!a-z]" classes and '\' escapes are supported.
+bool globMatch(QStringView pattern, QStringView text);
+
+// The .gitignore rules in effect inside one directory, chained to its parent
+// directory's rules. Immutable once built, so worker threads can share them.
+class IgnoreRules
+{
+public:
+    // Rules for `directory`: its own .gitignore (if any) on top of `parent`
+    static QSharedPointer<const IgnoreRules> forDirectory(const QString &directory,
+                                                         const QSharedPointer<const IgnoreRules> &parent);
+
+    bool isIgnored(const QString &absolutePath, bool isDirectory) const;
+
+private:
+    struct Rule {
+        QString pattern;
+        bool negated = false;
+        bool directoryOnly = false;
+        bool anchored = false; // Matched against the path relative to the .gitignore, not the file name
+    };
+
+    // 1 = ignored, 0 = re-included by a negated rule, -1 = no rule matched
+    int match(const QString &absolutePath, bool isDirectory) const;
+
+    QSharedPointer<const IgnoreRules> parent_;
+    QString directory_; // Absolute, ends with '/'
+    QList<Rule> rules_;
+};
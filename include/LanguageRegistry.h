@@ -0,0 +1,167 @@
+#pragma once
+
+#include <QString>
+#include <QStringList>
+
+enum class Language : quint8 { Cpp, Python, TypeScript, JavaScript, Rust, Go, Java, CSharp, Shell, CMake };
+
+// Comment and literal syntax of one language. Each language has one constexpr
+// instance below and the lexer is instantiated once per instance, so these flags
+// are constants in the generated code rather than per-character checks.
+struct LanguageSyntax {
+    Language language = Language::Cpp;
+    const char *name = "";
+    const char *extensions = "";      // Space separated, lower case
+    const char *fileNames = "";       // Space separated exact names, e.g. "CMakeLists.txt"
+    const char *lineMarker = "//";    // Written by the saver for new comment lines
+
+    // Comments
+    bool lineComments = false;        // "//" to end of line
+    bool blockComments = false;       // "/* ... */", may span lines
+    bool nestedBlockComments = false; // Rust: "/* /* */ */" is one comment
+    bool hashComments = false;        // "#" to end of line
+    bool hashAtWordStart = false;     // Shell: "#" only starts a comment at the start of a word ("${#x}" is code)
+    bool bracketComments = false;     // CMake: "#[[ ... ]]", "#[=[ ... ]=]", and "[[ ... ]]" arguments
+
+    // Literals
+    bool singleQuotes = true;         // '...' is a string or char literal
+    bool digitSeparators = false;     // C++14: 1'000 is a number, not a char literal
+    bool lifetimes = false;           // Rust: 'a and 'label are not char literals
+    bool multiLineStrings = false;    // "..." may span lines
+    bool rawStrings = false;          // C++ R"delim(...)delim"
+    bool rustRawStrings = false;      // r"...", r#"..."#, br"..."
+    bool verbatimStrings = false;     // C# @"..." with "" as the only escape
+    bool tripleQuotedStrings = false; // Python """...""" and '''...'''
+    bool textBlocks = false;          // Java and C# """..."""
+    bool backtickStrings = false;     // `...`, may span lines
+    bool backtickEscapes = false;     // Backslash escapes inside `...` (TypeScript, not Go)
+};
+
+inline constexpr LanguageSyntax CppSyntax = [] {
+    LanguageSyntax s;
+    s.language = Language::Cpp;
+    s.name = "C++";
+    s.extensions = "cpp cc cxx c h hpp hh hxx";
+    s.lineComments = true;
+    s.blockComments = true;
+    s.digitSeparators = true;
+    s.rawStrings = true;
+    return s;
+}();
+
+inline constexpr LanguageSyntax PythonSyntax = [] {
+    LanguageSyntax s;
+    s.language = Language::Python;
+    s.name = "Python";
+    s.extensions = "py";
+    s.lineMarker = "#";
+    s.hashComments = true;
+    s.tripleQuotedStrings = true;
+    return s;
+}();
+
+inline constexpr LanguageSyntax TypeScriptSyntax = [] {
+    LanguageSyntax s;
+    s.language = Language::TypeScript;
+    s.name = "TypeScript";
+    s.extensions = "ts tsx";
+    s.lineComments = true;
+    s.blockComments = true;
+    s.backtickStrings = true;
+    s.backtickEscapes = true;
+    return s;
+}();
+
+inline constexpr LanguageSyntax JavaScriptSyntax = [] {
+    LanguageSyntax s = TypeScriptSyntax;
+    s.language = Language::JavaScript;
+    s.name = "JavaScript";
+    s.extensions = "js jsx mjs cjs";
+    return s;
+}();
+
+inline constexpr LanguageSyntax RustSyntax = [] {
+    LanguageSyntax s;
+    s.language = Language::Rust;
+    s.name = "Rust";
+    s.extensions = "rs";
+    s.lineComments = true;
+    s.blockComments = true;
+    s.nestedBlockComments = true;
+    s.lifetimes = true;
+    s.multiLineStrings = true;
+    s.rustRawStrings = true;
+    return s;
+}();
+
+inline constexpr LanguageSyntax GoSyntax = [] {
+    LanguageSyntax s;
+    s.language = Language::Go;
+    s.name = "Go";
+    s.extensions = "go";
+    s.lineComments = true;
+    s.blockComments = true;
+    s.backtickStrings = true;
+    return s;
+}();
+
+inline constexpr LanguageSyntax JavaSyntax = [] {
+    LanguageSyntax s;
+    s.language = Language::Java;
+    s.name = "Java";
+    s.extensions = "java";
+    s.lineComments = true;
+    s.blockComments = true;
+    s.textBlocks = true;
+    return s;
+}();
+
+inline constexpr LanguageSyntax CSharpSyntax = [] {
+    LanguageSyntax s;
+    s.language = Language::CSharp;
+    s.name = "C#";
+    s.extensions = "cs";
+    s.lineComments = true;
+    s.blockComments = true;
+    s.verbatimStrings = true;
+    s.textBlocks = true;
+    return s;
+}();
+
+inline constexpr LanguageSyntax ShellSyntax = [] {
+    LanguageSyntax s;
+    s.language = Language::Shell;
+    s.name = "Shell";
+    s.extensions = "sh bash";
+    s.lineMarker = "#";
+    s.hashComments = true;
+    s.hashAtWordStart = true;
+    return s;
+}();
+
+inline constexpr LanguageSyntax CMakeSyntax = [] {
+    LanguageSyntax s;
+    s.language = Language::CMake;
+    s.name = "CMake";
+    s.extensions = "cmake";
+    s.fileNames = "CMakeLists.txt";
+    s.lineMarker = "#";
+    s.hashComments = true;
+    s.bracketComments = true;
+    s.singleQuotes = false;
+    s.multiLineStrings = true;
+    return s;
+}();
+
+// Maps files to languages. Lookups are hash lookups on the file name and extension;
+// the tables are built from the descriptors above on first use.
+class LanguageRegistry
+{
+public:
+    // By exact file name, then extension. Unknown files are treated as Python,
+    // whose "#" comments were always the fallback.
+    static Language forFile(const QString &filePath);
+    static const LanguageSyntax &syntax(Language language);
+    // Globs for every registered file name and extension, e.g. for folder scans
+    static QStringList nameFilters();
+};
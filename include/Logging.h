@@ -0,0 +1,12 @@
+#pragma once
+
+#include <QLoggingCategory>
+
+// Logging categories. Warnings are on by default; debug and info output is off
+// until enabled, e.g. QT_LOGGING_RULES="ccp.save.debug=true", so disabled log
+// statements cost one flag test and never format their arguments.
+Q_DECLARE_LOGGING_CATEGORY(lcCache)   // ccp.cache
+Q_DECLARE_LOGGING_CATEGORY(lcExtract) // ccp.extract
+Q_DECLARE_LOGGING_CATEGORY(lcSave)    // ccp.save
+Q_DECLARE_LOGGING_CATEGORY(lcSource)  // ccp.source
+Q_DECLARE_LOGGING_CATEGORY(lcUi)      // ccp.ui
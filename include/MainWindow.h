@@ -1,15 +1,28 @@
 #pragma once
 
 #include <QMainWindow>
-#include <QTableWidget>
 #include <QPushButton>
-#include <QScrollArea>
-#include <QVBoxLayout>
-#include <QLabel>
 #include <QWidget>
 #include <QStyledItemDelegate>
 #include <QTextEdit>
+#include <QElapsedTimer>
+#include <QSet>
+#include <QThreadPool>
+#include "CommentCache.h"
 #include "CommentExtractor.h"
+#include "CommentFilterModel.h"
+#include "CommentMetrics.h"
+#include "CommentSaver.h"
+#include "CommentTreeModel.h"
+#include "ExtractionPipeline.h"
+#include "SavePipeline.h"
+#include "DirectoryScanner.h"
+#include "GitChanges.h"
+
+class MetricsDialog;
+class QProgressBar;
+class QFileSystemWatcher;
+class QTimer;
 
 QT_BEGIN_NAMESPACE
 namespace Ui { class MainWindow; }
@@ -37,19 +50,82 @@ public:
 
 private slots:
     void on_openFileButton_clicked();
+    void on_openFolderButton_clicked();
+    void on_openChangedButton_clicked();
     void on_saveFileButton_clicked();
+    void handleFileExtracted(int index, const FileComments &file);
+    void handleExtractionFinished(bool cancelled);
+    void handlePreviewReady(const QList<FileSaveJob> &jobs, const QList<FilePreview> &previews);
+    void handleSaveFinished(const QList<FileSaveJob> &jobs, bool committed);
+    void populatePendingFiles();
+    void handleFileChanged(const QString &filePath);
+    void reloadChangedFiles();
+    void handleFileReloaded(int index, const FileComments &file);
+    void applyFilter();
+    void handleSearchCompleted(const CommentMatches &matches);
+    void on_replaceButton_clicked();
+    void on_metricsButton_clicked();
 
 private:
     Ui::MainWindow *ui;
-    QList<QString> loadedFilePaths;
-    QList<QList<CommentGroup>> fileCommentGroups;
+    CommentTreeModel *commentModel_;
+    CommentFilterModel *filterModel_;
+    QTimer *filterTimer_;
+    QElapsedTimer searchTimer_; // From the latest query until its matches are complete
+    
+    ExtractionPipeline *extractionPipeline_;
+    DirectoryScanner *directoryScanner_;
+    QProgressBar *progressBar_;
+    QPushButton *cancelButton_;
+    QElapsedTimer loadTimer_;
+    qint64 loadTraceStart_ = 0;
+    int loadedGroupCount_ = 0;
+    
+    // Extracted files wait here and are added to the model in time-boxed batches,
+    // so the event loop keeps painting and handling input while a project loads
+    static constexpr qint64 PopulateBudgetMs = 12;
+    QList<FileComments> pendingFiles_;
+    qsizetype pendingHead_ = 0; // Files before this are in the model; compacted now and then
+    QTimer *populateTimer_;
+    bool extractionDone_ = false;
+    bool extractionCancelled_ = false;
+    QSharedPointer<const GitChanges> gitChanges_; // Set while the files came from a git comparison
+    QThreadPool gitPool_;                         // Runs git for "Open Changed Files"
+    QThreadPool replacePool_;                     // Plans "Replace in Comments"
+    
+    SavePipeline *savePipeline_;
+    QElapsedTimer saveTimer_;
+    qint64 saveTraceStart_ = 0;
+    bool saving_ = false; // From the preview until the save has finished, and while a replace is planned
+    
+    QFileSystemWatcher *fileWatcher_;
+    QTimer *reloadTimer_;
+    ExtractionPipeline *reloadPipeline_;
+    CommentCache commentCache_;
+    CommentExtractor fileLoader_; // Loads evicted files again for the model
+    QSet<QString> changedPaths_;  // Waiting for the reload timer
+    QSet<QString> savedPaths_;    // Saved by us; their edits are on disk
+    // Edits of hunks rejected in the save preview, edited again once their partly saved file is reloaded
+    struct KeptEdit {
+        QString originalText; // The group's text as extracted, which the save leaves on disk
+        int firstLine = 0;    // Where the group was before the save
+        QString editedText;
+    };
+    QHash<QString, QList<KeptEdit>> keptEdits_;
+    QHash<QString, QList<int>> editGroups_; // Per file of the save: group row of each edit
+    int unwatchedFileCount_ = 0;
     
-    QScrollArea *scrollArea_;
-    QWidget *scrollWidget_;
-    QVBoxLayout *scrollLayout_;
+    CommentMetricsReport metrics_;           // Rolled up in finishLoading, updated per reload
+    MetricsDialog *metricsDialog_ = nullptr; // Created on first use, kept current while open
     
-    void createFileSection(const QString &filePath, const QList<CommentGroup> &commentGroups, bool addSeparator = false);
-    QList<QPair<int, QString>> getModifiedCommentsForFile(int fileIndex);
-    QString extractCommentFromFullLine(const QString &fullLine);
-    void adjustScrollAreaSizeIntelligently();
+    void beginLoading();
+    void finishLoading();
+    void setSaving(bool saving);
+    void handleReplacePlanned(const ReplacePlan &plan, qint64 elapsedMs);
+    bool resolveChangedOnDisk(const QList<int> &fileRows, int otherFiles);
+    void showFileRows();
+    // The edits of a file's dirty groups; `groupRows`, when given, receives the group of each
+    QList<CommentEdit> getModifiedCommentsForFile(int fileIndex, QList<int> *groupRows = nullptr);
+    int restoreKeptEdits(int fileRow, const QList<KeptEdit> &kept);
+    bool extractCommentFromFullLine(const QString &fullLine, Language language, QString &comment);
 };
\ No newline at end of file
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <QDialog>
+#include <QHash>
+#include "CommentMetrics.h"
+
+class QLabel;
+class QTreeWidget;
+class QTreeWidgetItem;
+
+// Comment metrics of the loaded files, as a directory tree with a rollup per
+// directory. Directories are filled in when first expanded, so a large project
+// opens instantly; updates after a reload only touch the rows of that file's path.
+class MetricsDialog : public QDialog
+{
+    Q_OBJECT
+public:
+    explicit MetricsDialog(const CommentMetricsReport *report, QWidget *parent = nullptr);
+
+    // Rebuilds the tree after the report was rebuilt
+    void reset();
+    // Refreshes the rows of a file and of the directories above it
+    void updateFile(const QString &filePath);
+
+private slots:
+    void populate(QTreeWidgetItem *item);
+
+private:
+    QTreeWidgetItem *addItem(QTreeWidgetItem *parent, const QString &path, bool isDirectory);
+    void fillRow(QTreeWidgetItem *item, const CommentMetrics &metrics);
+    void updateSummary();
+
+    const CommentMetricsReport *report_;
+    QTreeWidget *tree_;
+    QLabel *summaryLabel_;
+    QHash<QString, QTreeWidgetItem *> items_; // Rows created so far, by path
+};
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <QtGlobal>
+
+#ifdef Q_OS_UNIX
+#include <sys/resource.h>
+#endif
+#ifdef Q_OS_LINUX
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#endif
+
+// Peak resident set size of this process in bytes, or -1 where unsupported
+inline qint64 peakResidentSetBytes()
+{
+#ifdef Q_OS_LINUX
+    // VmHWM follows resetPeakResidentSet(); getrusage() never goes down
+    if (FILE *status = std::fopen("/proc/self/status", "r")) {
+        char line[256];
+        qint64 kilobytes = -1;
+        while (std::fgets(line, sizeof(line), status)) {
+            if (std::strncmp(line, "VmHWM:", 6) == 0) {
+                kilobytes = std::atoll(line + 6);
+                break;
+            }
+        }
+        std::fclose(status);
+        if (kilobytes >= 0) {
+            return kilobytes * 1024;
+        }
+    }
+#endif
+#ifdef Q_OS_UNIX
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+#ifdef Q_OS_MACOS
+        return qint64(usage.ru_maxrss); // Bytes on macOS
+#else
+        return qint64(usage.ru_maxrss) * 1024; // Kilobytes on Linux
+#endif
+    }
+#endif
+    return -1;
+}
+
+// Starts a new peak measurement from the current resident set (Linux only), so a
+// benchmark can report the peak of each stage. Returns false if unsupported.
+inline bool resetPeakResidentSet()
+{
+#ifdef Q_OS_LINUX
+    if (FILE *clearRefs = std::fopen("/proc/self/clear_refs", "w")) {
+        const bool reset = std::fputs("5", clearRefs) >= 0;
+        return std::fclose(clearRefs) == 0 && reset;
+    }
+#endif
+    return false;
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <QObject>
+#include <QThreadPool>
+#include "CommentSaver.h"
+
+// Runs CommentSaver::saveAll() off the owning thread, so a save never blocks the
+// event loop, and reports per-file progress and the outcome back on the owning thread.
+class SavePipeline : public QObject
+{
+    Q_OBJECT
+public:
+    explicit SavePipeline(QObject *parent = nullptr);
+    ~SavePipeline();
+
+    // Starts saving a batch as one transaction; ignored while a save is running
+    void start(const QList<FileSaveJob> &jobs);
+    bool isRunning() const { return running_; }
+    // Computes what saving a batch would change; previewReady() carries the result
+    void preview(const QList<FileSaveJob> &jobs);
+
+signals:
+    void progressChanged(int completed, int total, const QString &filePath);
+    // `jobs` carry their outcome; `committed` is false if the batch was rolled back
+    void finished(const QList<FileSaveJob> &jobs, bool committed);
+    void previewReady(const QList<FileSaveJob> &jobs, const QList<FilePreview> &previews);
+
+private:
+    QThreadPool pool_;
+    bool running_ = false;
+};
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <QFile>
+#include <QString>
+#include <QByteArray>
+#include <QSharedPointer>
+
+// Immutable bytes of one source file, either memory-mapped or read into memory.
+// Also holds comment arena text, which is decoded to QString only when a row is
+// displayed or edited.
+class SourceBuffer
+{
+public:
+    enum class ReadMode {
+        Read,   // Read the file into one QByteArray
+        Map,    // Memory-map the file (falls back to Read if mapping fails)
+        Auto    // Map large files, read small ones
+    };
+
+    // Files at least this large are mapped in Auto mode
+    static constexpr qint64 AutoMapThreshold = 256 * 1024;
+
+    static QSharedPointer<const SourceBuffer> open(const QString &filePath, ReadMode mode = ReadMode::Auto);
+
+    // A read-only window onto part of another buffer, which is kept alive by the slice
+    static QSharedPointer<const SourceBuffer> slice(const QSharedPointer<const SourceBuffer> &parent,
+                                                    qsizetype offset, qsizetype size);
+
+    // Takes over bytes built in memory, such as a comment arena
+    static QSharedPointer<const SourceBuffer> fromBytes(const QByteArray &bytes);
+
+    const char *data() const { return data_; }
+    qsizetype size() const { return size_; }
+    bool isMapped() const { return mapped_; }
+
+    QString decode(qsizetype from, qsizetype to) const { return QString::fromUtf8(data_ + from, to - from); }
+
+private:
+    SourceBuffer() = default;
+    Q_DISABLE_COPY(SourceBuffer)
+
+    QFile file_;       // Owns the mapping; unmapped when destroyed
+    QByteArray bytes_; // Owns the data in Read mode
+    QSharedPointer<const SourceBuffer> parent_; // Owns the data of a slice
+    const char *data_ = "";
+    qsizetype size_ = 0;
+    bool mapped_ = false;
+};
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <QString>
+#include <atomic>
+
+// Span tracing for the open, extract, group, populate and save paths, exported in
+// the Chrome trace format (chrome://tracing, Perfetto). Off by default: a span then
+// costs one relaxed atomic load and records nothing. Enabled by Trace::start() or
+// by setting CCP_TRACE=<file> (the trace is written when the process exits).
+class Trace
+{
+public:
+    static bool isEnabled() { return enabled_.load(std::memory_order_relaxed); }
+
+    // Clears earlier events and starts recording
+    static void start();
+    // Stops recording; recorded events are kept until the next start()
+    static void stop();
+    // Starts recording if CCP_TRACE names an output file, and writes it at exit
+    static void startFromEnvironment();
+
+    // Nanoseconds on the trace clock; spans that cross the event loop keep one
+    // and hand it to record() when they end
+    static qint64 now();
+    // `name` must be a string literal; `detail` (usually a file path) may be empty
+    static void record(const char *name, qint64 startNs, qint64 endNs, const QString &detail = QString());
+
+    // Writes every recorded event as Chrome trace JSON
+    static bool writeChromeTrace(const QString &filePath);
+
+private:
+    static std::atomic<bool> enabled_;
+};
+
+// Records the time from construction to destruction as one event, when tracing is on
+class TraceSpan
+{
+public:
+    explicit TraceSpan(const char *name, const QString &detail = QString()) : name_(name)
+    {
+        if (Trace::isEnabled()) {
+            detail_ = detail;
+            startNs_ = Trace::now();
+        }
+    }
+    ~TraceSpan()
+    {
+        if (startNs_ >= 0) {
+            Trace::record(name_, startNs_, Trace::now(), detail_);
+        }
+    }
+
+    TraceSpan(const TraceSpan &) = delete;
+    TraceSpan &operator=(const TraceSpan &) = delete;
+
+private:
+    const char *name_;
+    QString detail_;     // Only set while tracing
+    qint64 startNs_ = -1;
+};
@@ -0,0 +1,152 @@
+#include "ByteScan.h"
+#include <cstring>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define BYTESCAN_X86 1
+#include <immintrin.h>
+#endif
+
+ByteFinder::ByteFinder(std::initializer_list<char> bytes)
+{
+    for (char c : bytes) {
+        if (!table_[uchar(c)] && count_ < int(sizeof(bytes_))) {
+            table_[uchar(c)] = true;
+            std::memset(lanes_[count_], c, sizeof(lanes_[count_]));
+            bytes_[count_++] = c;
+        }
+    }
+}
+
+const char *ByteFinder::find(const char *p, const char *end, Kernel kernel) const
+{
+    return functionFor(isSupported(kernel) ? kernel : Kernel::Scalar)(*this, p, end);
+}
+
+const char *ByteFinder::findScalar(const ByteFinder &finder, const char *p, const char *end)
+{
+    while (p < end && !finder.table_[uchar(*p)]) {
+        ++p;
+    }
+    return p;
+}
+
+#ifdef BYTESCAN_X86
+
+// SSE2 is part of x86-64, so this kernel needs no target attribute
+const char *ByteFinder::findSse2(const ByteFinder &finder, const char *p, const char *end)
+{
+    __m128i needles[16];
+    for (int i = 0; i < finder.count_; ++i) {
+        needles[i] = _mm_load_si128(reinterpret_cast<const __m128i *>(finder.lanes_[i]));
+    }
+    for (; end - p >= 16; p += 16) {
+        const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+        __m128i hits = _mm_setzero_si128();
+        for (int i = 0; i < finder.count_; ++i) {
+            hits = _mm_or_si128(hits, _mm_cmpeq_epi8(block, needles[i]));
+        }
+        const int mask = _mm_movemask_epi8(hits);
+        if (mask) {
+            return p + __builtin_ctz(unsigned(mask));
+        }
+    }
+    return findScalar(finder, p, end);
+}
+
+__attribute__((target("avx2")))
+const char *ByteFinder::findAvx2(const ByteFinder &finder, const char *p, const char *end)
+{
+    __m256i needles[16];
+    for (int i = 0; i < finder.count_; ++i) {
+        needles[i] = _mm256_load_si256(reinterpret_cast<const __m256i *>(finder.lanes_[i]));
+    }
+    for (; end - p >= 32; p += 32) {
+        const __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+        __m256i hits = _mm256_setzero_si256();
+        for (int i = 0; i < finder.count_; ++i) {
+            hits = _mm256_or_si256(hits, _mm256_cmpeq_epi8(block, needles[i]));
+        }
+        const unsigned mask = unsigned(_mm256_movemask_epi8(hits));
+        if (mask) {
+            return p + __builtin_ctz(mask);
+        }
+    }
+    return findSse2(finder, p, end);
+}
+
+#else
+
+const char *ByteFinder::findSse2(const ByteFinder &finder, const char *p, const char *end)
+{
+    return findScalar(finder, p, end);
+}
+
+const char *ByteFinder::findAvx2(const ByteFinder &finder, const char *p, const char *end)
+{
+    return findScalar(finder, p, end);
+}
+
+#endif
+
+bool ByteFinder::isSupported(Kernel kernel)
+{
+    switch (kernel) {
+    case Kernel::Scalar:
+        return true;
+#ifdef BYTESCAN_X86
+    case Kernel::Sse2:
+        return true;
+    case Kernel::Avx2:
+        __builtin_cpu_init(); // May run from a static initializer, before the runtime does it
+        return __builtin_cpu_supports("avx2");
+#else
+    default:
+        return false;
+#endif
+    }
+    return false;
+}
+
+ByteFinder::Kernel ByteFinder::activeKernel()
+{
+    if (isSupported(Kernel::Avx2)) {
+        return Kernel::Avx2;
+    }
+    return isSupported(Kernel::Sse2) ? Kernel::Sse2 : Kernel::Scalar;
+}
+
+const char *ByteFinder::kernelName(Kernel kernel)
+{
+    switch (kernel) {
+    case Kernel::Scalar:
+        return "scalar";
+    case Kernel::Sse2:
+        return "sse2";
+    case Kernel::Avx2:
+        return "avx2";
+    }
+    return "unknown";
+}
+
+ByteFinder::FindFunction ByteFinder::functionFor(Kernel kernel)
+{
+    switch (kernel) {
+    case Kernel::Sse2:
+        return &ByteFinder::findSse2;
+    case Kernel::Avx2:
+        return &ByteFinder::findAvx2;
+    case Kernel::Scalar:
+        break;
+    }
+    return &ByteFinder::findScalar;
+}
+
+void ByteFinder::setSelectedKernel(Kernel kernel)
+{
+    selectedKernel_ = isSupported(kernel) ? kernel : Kernel::Scalar;
+    activeFind_ = functionFor(selectedKernel_);
+}
+
+// Chosen once, before main(); the lexer only calls through the pointer
+ByteFinder::Kernel ByteFinder::selectedKernel_ = ByteFinder::activeKernel();
+ByteFinder::FindFunction ByteFinder::activeFind_ = ByteFinder::functionFor(ByteFinder::selectedKernel_);
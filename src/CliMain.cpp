@@ -0,0 +1,394 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QDir>
+#include <QEventLoop>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMap>
+#include <QTextStream>
+#include "CommentCache.h"
+#include "CommentExtractor.h"
+#include "CommentMetrics.h"
+#include "CommentSaver.h"
+#include "DirectoryScanner.h"
+#include "ExtractionPipeline.h"
+#include "GitChanges.h"
+#include "Trace.h"
+
+// Headless front end for CI: extraction to JSON Lines / CSV and batch edits.
+// Uses QCoreApplication only, so no display or widget modules are needed.
+
+namespace {
+
+QByteArray csvField(const QString &value)
+{
+    QByteArray utf8 = value.toUtf8();
+    if (utf8.contains(',') || utf8.contains('"') || utf8.contains('\n') || utf8.contains('\r')) {
+        utf8.replace("\"", "\"\"");
+        return '"' + utf8 + '"';
+    }
+    return utf8;
+}
+
+const char *changeName(ChangeKind kind)
+{
+    switch (kind) {
+    case ChangeKind::New:
+        return "new";
+    case ChangeKind::Modified:
+        return "modified";
+    default:
+        return "unchanged";
+    }
+}
+
+// One record per comment line; `group` is the index of its CommentGroup in the file.
+// With `changes` (--since), each line also says how it changed since the revision.
+void writeGroups(QFile &out, bool csv, const FileComments &file, const FileChanges *changes)
+{
+    const QString &filePath = file.filePath;
+    QByteArray buffer;
+    for (int g = 0; g < file.groupCount(); ++g) {
+        const CommentGroup group = file.group(g);
+        for (int i = 0; i < group.size(); ++i) {
+            if (csv) {
+                buffer += csvField(filePath) + ',' + QByteArray::number(group.lineNumber(i)) + ','
+                        + QByteArray::number(g) + ',' + (group.isInline(i) ? "true" : "false") + ','
+                        + csvField(group.comment(i));
+                if (changes) {
+                    buffer += QByteArray(",") + changeName(changes->lineChange(group.lineNumber(i)));
+                }
+                buffer += '\n';
+            } else {
+                QJsonObject record{{"file", filePath},
+                                   {"line", group.lineNumber(i)},
+                                   {"group", g},
+                                   {"inline", group.isInline(i)},
+                                   {"text", group.comment(i)}};
+                if (changes) {
+                    record.insert("change", changeName(changes->lineChange(group.lineNumber(i))));
+                }
+                buffer += QJsonDocument(record).toJson(QJsonDocument::Compact) + '\n';
+            }
+        }
+    }
+    out.write(buffer);
+}
+
+void writeMetricsRecord(QFile &out, bool csv, const char *type, const QString &path, const CommentMetrics &metrics)
+{
+    const QString density = QString::number(metrics.density(), 'f', 4);
+    if (csv) {
+        out.write(type + QByteArray(",") + csvField(path) + ',' + QByteArray::number(metrics.files) + ','
+                  + QByteArray::number(metrics.lines) + ',' + QByteArray::number(metrics.commentLines) + ','
+                  + QByteArray::number(metrics.inlineLines) + ',' + QByteArray::number(metrics.blockLines) + ','
+                  + density.toUtf8() + ',' + QByteArray::number(metrics.todoCount) + ','
+                  + QByteArray::number(metrics.fixmeCount) + ',' + QByteArray::number(metrics.longestUncommented) + ','
+                  + csvField(metrics.longestUncommentedFile) + ','
+                  + QByteArray::number(metrics.longestUncommentedStart) + '\n');
+    } else {
+        QJsonObject record{{"type", type},
+                           {"path", path},
+                           {"files", metrics.files},
+                           {"lines", metrics.lines},
+                           {"commentLines", metrics.commentLines},
+                           {"inlineLines", metrics.inlineLines},
+                           {"blockLines", metrics.blockLines},
+                           {"density", density.toDouble()},
+                           {"todo", metrics.todoCount},
+                           {"fixme", metrics.fixmeCount},
+                           {"longestUncommented", metrics.longestUncommented}};
+        if (metrics.longestUncommented > 0) {
+            record.insert("longestUncommentedFile", metrics.longestUncommentedFile);
+            record.insert("longestUncommentedStart", metrics.longestUncommentedStart);
+        }
+        out.write(QJsonDocument(record).toJson(QJsonDocument::Compact) + '\n');
+    }
+}
+
+// One record per directory, followed by its files and then its subdirectories, from
+// the deepest directory that holds every file down
+void writeMetrics(QFile &out, bool csv, const CommentMetricsReport &report, const QString &directory)
+{
+    writeMetricsRecord(out, csv, "directory", directory, report.directory(directory));
+    for (const QString &filePath : report.files(directory)) {
+        writeMetricsRecord(out, csv, "file", filePath, report.file(filePath));
+    }
+    for (const QString &subdirectory : report.subdirectories(directory)) {
+        writeMetrics(out, csv, report, subdirectory);
+    }
+}
+
+int runExtract(const QStringList &arguments)
+{
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Extract comments from files or directories.");
+    parser.addHelpOption();
+    QCommandLineOption formatOption({"f", "format"}, "Output format: jsonl (default) or csv.", "format", "jsonl");
+    QCommandLineOption outputOption({"o", "output"}, "Write to <file> instead of standard output.", "file");
+    QCommandLineOption includeOption({"i", "include"}, "Extra file glob for directory scans, ! prefix excludes. Repeatable.", "glob");
+    QCommandLineOption cacheOption("cache", "Comment cache file (default: the cache shared with the GUI).", "file",
+                                   CommentCache::defaultPath());
+    QCommandLineOption noCacheOption("no-cache", "Re-parse every file and leave the cache untouched.");
+    QCommandLineOption sinceOption("since", "Only files changed in the git working tree since <revision> (HEAD for "
+                                   "uncommitted changes, main... for the current branch); adds a change field.", "revision");
+    QCommandLineOption metricsOption("metrics", "Write comment metrics per file and per directory instead of the comments.");
+    parser.addOptions({formatOption, outputOption, includeOption, cacheOption, noCacheOption, sinceOption, metricsOption});
+    parser.addPositionalArgument("paths", "Files or directories to extract from.", "<path>...");
+    parser.process(arguments);
+
+    QTextStream err(stderr);
+    const QString format = parser.value(formatOption);
+    if (format != "jsonl" && format != "csv") {
+        err << "Unknown format: " << format << "\n";
+        return 2;
+    }
+    if (parser.positionalArguments().isEmpty()) {
+        parser.showHelp(2);
+    }
+
+    QFile out;
+    bool opened = false;
+    if (parser.isSet(outputOption)) {
+        out.setFileName(parser.value(outputOption));
+        opened = out.open(QIODevice::WriteOnly | QIODevice::Truncate);
+    } else {
+        opened = out.open(stdout, QIODevice::WriteOnly);
+    }
+    if (!opened) {
+        err << "Could not open output: " << out.errorString() << "\n";
+        return 1;
+    }
+    const bool csv = format == "csv";
+    const bool since = parser.isSet(sinceOption);
+    const bool metrics = parser.isSet(metricsOption);
+    if (csv && metrics) {
+        out.write("type,path,files,lines,comment_lines,inline_lines,block_lines,density,todo,fixme,"
+                  "longest_uncommented,longest_uncommented_file,longest_uncommented_start\n");
+    } else if (csv) {
+        out.write(since ? "file,line,group,inline,text,change\n" : "file,line,group,inline,text\n");
+    }
+
+    CommentCache cache(parser.value(cacheOption));
+    ExtractionPipeline pipeline;
+    CommentMetricsReport report;
+    pipeline.setComputeMetrics(metrics);
+    if (!parser.isSet(noCacheOption)) {
+        cache.load();
+        pipeline.setCache(&cache);
+    }
+    DirectoryScanner scanner;
+    scanner.setNameFilters(CommentExtractor::supportedNameFilters() + parser.values(includeOption));
+
+    int exitCode = 0;
+    QStringList directories;
+    QHash<QString, FileChanges> changedFiles;
+    pipeline.begin();
+    for (const QString &path : parser.positionalArguments()) {
+        QFileInfo info(path);
+        if (since && info.exists()) {
+            // Only files git reports as changed under the path; directories are not walked
+            GitChanges changes;
+            if (!changes.load(path, parser.value(sinceOption))) {
+                err << "git: " << changes.errorString() << "\n";
+                exitCode = 1;
+                continue;
+            }
+            QStringList includes;
+            QStringList excludes;
+            for (const QString &glob : CommentExtractor::supportedNameFilters() + parser.values(includeOption)) {
+                if (glob.startsWith('!')) {
+                    excludes.append(glob.mid(1));
+                } else {
+                    includes.append(glob);
+                }
+            }
+            QStringList files = changes.files();
+            files.sort();
+            for (const QString &filePath : std::as_const(files)) {
+                const QString fileName = QFileInfo(filePath).fileName();
+                if (QDir::match(includes, fileName) && !QDir::match(excludes, fileName)) {
+                    changedFiles.insert(filePath, *changes.changesFor(filePath));
+                    pipeline.enqueue(filePath);
+                }
+            }
+        } else if (info.isDir()) {
+            directories.append(path);
+        } else if (info.isFile()) {
+            pipeline.enqueue(path);
+        } else {
+            err << "No such file or directory: " << path << "\n";
+            exitCode = 1;
+        }
+    }
+
+    // Directories are walked one after another, all feeding the same pipeline
+    auto scanNext = [&]() {
+        if (directories.isEmpty()) {
+            pipeline.finishInput();
+        } else {
+            scanner.start(directories.takeFirst());
+        }
+    };
+
+    QEventLoop loop;
+    QObject::connect(&pipeline, &ExtractionPipeline::fileExtracted, &loop,
+                     [&](int, const FileComments &file) {
+        if (metrics) {
+            report.setFile(file.filePath, file.metrics);
+            return;
+        }
+        auto changes = changedFiles.constFind(file.filePath);
+        writeGroups(out, csv, file, changes != changedFiles.constEnd() ? &changes.value() : nullptr);
+    });
+    QObject::connect(&scanner, &DirectoryScanner::fileFound, &pipeline, &ExtractionPipeline::enqueue);
+    QObject::connect(&scanner, &DirectoryScanner::finished, &loop, [&](bool) { scanNext(); });
+    QObject::connect(&pipeline, &ExtractionPipeline::finished, &loop, &QEventLoop::quit);
+
+    scanNext();
+    if (pipeline.isRunning()) {
+        loop.exec();
+    }
+    if (metrics) {
+        report.rebuild();
+        const QString root = report.root();
+        for (const QString &directory : root.isEmpty() ? report.subdirectories(QString()) : QStringList{root}) {
+            writeMetrics(out, csv, report, directory);
+        }
+    }
+    out.close();
+    if (!parser.isSet(noCacheOption)) {
+        cache.save();
+    }
+    return exitCode;
+}
+
+// Edit file: JSON Lines, one edit per line; line numbers refer to the files before the batch.
+//   {"file": "a.cpp", "line": 12, "text": "new comment"}   replaces the comment on line 12
+//   {"file": "a.cpp", "after": 12, "text": "added line"}   inserts a comment line after line 12
+//   {"file": "a.cpp", "delete": 12}                        deletes the comment on line 12
+// A "\n" in "text" starts another comment line; code on the edited line is kept.
+int runApply(const QStringList &arguments)
+{
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Apply a batch of comment edits (JSON Lines) to source files.");
+    parser.addHelpOption();
+    QCommandLineOption dryRunOption("dry-run", "Print the changes as a unified diff instead of saving them.");
+    parser.addOption(dryRunOption);
+    parser.addPositionalArgument("edits", "Edit file, or - for standard input.", "<edits.jsonl>");
+    parser.process(arguments);
+
+    QTextStream err(stderr);
+    QTextStream log(stdout);
+    if (parser.positionalArguments().size() != 1) {
+        parser.showHelp(2);
+    }
+
+    const QString editsPath = parser.positionalArguments().first();
+    QFile editsFile;
+    bool opened = false;
+    if (editsPath == "-") {
+        opened = editsFile.open(stdin, QIODevice::ReadOnly);
+    } else {
+        editsFile.setFileName(editsPath);
+        opened = editsFile.open(QIODevice::ReadOnly);
+    }
+    if (!opened) {
+        err << "Could not open edit file: " << editsPath << "\n";
+        return 1;
+    }
+
+    QMap<QString, QList<CommentEdit>> editsByFile;
+    QHash<QPair<QString, int>, int> insertionCounts;
+    int lineNumber = 0;
+    while (!editsFile.atEnd()) {
+        const QByteArray line = editsFile.readLine().trimmed();
+        lineNumber++;
+        if (line.isEmpty()) {
+            continue;
+        }
+
+        QJsonParseError parseError;
+        const QJsonObject edit = QJsonDocument::fromJson(line, &parseError).object();
+        const QString file = edit.value("file").toString();
+        bool valid = parseError.error == QJsonParseError::NoError && !file.isEmpty();
+        CommentEdit parsed;
+        if (edit.contains("delete")) {
+            parsed = CommentEdit::remove(edit.value("delete").toInt(-1));
+            valid = valid && parsed.line >= 1;
+        } else if (edit.contains("after")) {
+            // Lines inserted after the same anchor keep the order they appear in
+            const int anchor = edit.value("after").toInt(-1);
+            parsed = CommentEdit::insertAfter(anchor, insertionCounts[qMakePair(file, anchor)]++, edit.value("text").toString());
+            valid = valid && anchor >= 0 && edit.value("text").isString();
+        } else {
+            parsed = CommentEdit::replace(edit.value("line").toInt(-1), edit.value("text").toString());
+            valid = valid && parsed.line >= 1 && edit.value("text").isString();
+        }
+        if (!valid) {
+            err << editsPath << ":" << lineNumber << ": invalid edit\n";
+            return 2;
+        }
+        editsByFile[file].append(parsed);
+    }
+
+    // Files are independent, so they are written concurrently
+    QList<FileSaveJob> jobs;
+    for (auto it = editsByFile.constBegin(); it != editsByFile.constEnd(); ++it) {
+        FileSaveJob job;
+        job.filePath = it.key();
+        job.edits = it.value();
+        jobs.append(job);
+    }
+    if (parser.isSet(dryRunOption)) {
+        // Diffed only around the edited lines; nothing is written
+        int failures = 0;
+        for (const FilePreview &preview : CommentSaver::previewAll(jobs)) {
+            if (!preview.error.isEmpty()) {
+                err << "failed " << preview.filePath << ": " << preview.error << "\n";
+                failures++;
+            } else {
+                log << preview.unifiedDiff();
+            }
+        }
+        return failures > 0 ? 1 : 0;
+    }
+    CommentSaver::saveAll(jobs);
+
+    int failures = 0;
+    for (const FileSaveJob &job : std::as_const(jobs)) {
+        if (job.saved) {
+            log << "saved " << job.filePath << " (" << job.edits.size() << " edits)\n";
+        } else {
+            err << "failed " << job.filePath << ": " << job.error << "\n";
+            failures++;
+        }
+    }
+    return failures > 0 ? 1 : 0;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("comments-cli");
+    Trace::startFromEnvironment();
+
+    QStringList arguments = app.arguments();
+    const QString command = arguments.size() > 1 ? arguments.takeAt(1) : QString();
+    if (command == "extract") {
+        return runExtract(arguments);
+    }
+    if (command == "apply") {
+        return runApply(arguments);
+    }
+
+    QTextStream(stderr) << "Usage: comments-cli extract [--metrics] [options] <path>...\n"
+                        << "       comments-cli apply [--dry-run] <edits.jsonl>\n"
+                        << "Run a command with --help for its options.\n";
+    return 2;
+}
@@ -0,0 +1,41 @@
+#include "CommentArena.h"
+
+CommentArena CommentArena::build(const char *source, const QList<CommentSpan> &spans)
+{
+    CommentArena arena;
+    qsizetype textBytes = 0;
+    for (const CommentSpan &span : spans) {
+        textBytes += span.lineEnd - span.lineStart;
+    }
+
+    QByteArray bytes;
+    bytes.reserve(textBytes);
+    arena.lineNumbers.reserve(spans.size());
+    arena.lineEnds.reserve(spans.size());
+    arena.textStarts.reserve(spans.size());
+    arena.textEnds.reserve(spans.size());
+    arena.flags.reserve(spans.size());
+    for (qsizetype i = 0; i < spans.size(); ++i) {
+        const CommentSpan &span = spans[i];
+        // Consecutive lines stay in the current group, anything else starts a new one
+        if (i == 0 || span.lineNumber != spans[i - 1].lineNumber + 1) {
+            arena.groupStarts.append(quint32(i));
+        }
+        const quint32 base = quint32(bytes.size());
+        bytes.append(source + span.lineStart, span.lineEnd - span.lineStart);
+        arena.lineNumbers.append(quint32(span.lineNumber));
+        arena.lineEnds.append(quint32(bytes.size()));
+        arena.textStarts.append(quint32(base + span.textStart - span.lineStart));
+        arena.textEnds.append(quint32(base + span.textEnd - span.lineStart));
+        arena.flags.append(quint8((span.isInline ? InlineFlag : 0) | (span.isBlockFragment ? BlockFragmentFlag : 0)
+                                  | (span.hasMoreComments ? MoreCommentsFlag : 0)));
+    }
+    arena.text = SourceBuffer::fromBytes(bytes);
+    return arena;
+}
+
+qsizetype CommentArena::memoryBytes() const
+{
+    const qsizetype perComment = 4 * sizeof(quint32) + sizeof(quint8);
+    return (text ? text->size() : 0) + commentCount() * perComment + groupCount() * qsizetype(sizeof(quint32));
+}
@@ -0,0 +1,374 @@
+#include "CommentCache.h"
+#include "ContentHash.h"
+#include "Logging.h"
+#include <QDateTime>
+#include <QDir>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+
+namespace {
+
+struct FileHeader {
+    char magic[8];
+    quint32 version;
+    quint32 recordCount;
+    quint64 totalBytes;
+    quint64 checksum; // contentHash() of the fields above
+};
+
+struct RecordHeader {
+    quint64 recordBytes; // Including this header and the trailing padding
+    quint64 checksum;    // contentHash() of everything after lastUsed
+    qint64 lastUsed;     // Outside the checksum so it can be refreshed on save
+    qint64 size;
+    qint64 lastModified;
+    quint64 contentHash;
+    quint32 pathBytes;
+    quint32 spanCount;
+    quint32 groupCount;
+    quint32 textBytes;
+    quint32 lineCount;
+    quint32 reserved;
+};
+
+static_assert(sizeof(FileHeader) == 32, "cache header layout");
+static_assert(sizeof(RecordHeader) == 72, "cache record layout");
+
+const char Magic[8] = {'C', 'C', 'P', 'C', 'A', 'C', 'H', 'E'};
+const qsizetype ChecksumStart = offsetof(RecordHeader, size);
+
+qsizetype alignUp(qsizetype value, qsizetype alignment)
+{
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+// Section offsets within a record; one column per CommentArena array
+struct RecordLayout {
+    qsizetype lineNumbers;
+    qsizetype lineEnds;
+    qsizetype textStarts;
+    qsizetype textEnds;
+    qsizetype flags;
+    qsizetype groups;
+    qsizetype text;
+    qsizetype end;
+
+    explicit RecordLayout(const RecordHeader &header)
+    {
+        const qsizetype column = qsizetype(header.spanCount) * qsizetype(sizeof(quint32));
+        lineNumbers = alignUp(qsizetype(sizeof(RecordHeader)) + header.pathBytes, 4);
+        lineEnds = lineNumbers + column;
+        textStarts = lineEnds + column;
+        textEnds = textStarts + column;
+        flags = textEnds + column;
+        groups = alignUp(flags + header.spanCount, 4);
+        text = groups + qsizetype(header.groupCount) * qsizetype(sizeof(quint32));
+        end = alignUp(text + header.textBytes, 8);
+    }
+};
+
+template <typename T>
+QList<T> readColumn(const char *data, quint32 count)
+{
+    QList<T> column(count);
+    std::memcpy(column.data(), data, count * sizeof(T));
+    return column;
+}
+
+template <typename T>
+void writeColumn(char *data, const QList<T> &column)
+{
+    std::memcpy(data, column.constData(), column.size() * sizeof(T));
+}
+
+quint64 headerChecksum(const FileHeader &header)
+{
+    return contentHash(reinterpret_cast<const char *>(&header), offsetof(FileHeader, checksum));
+}
+
+} // namespace
+
+CommentCache::CommentCache(const QString &cacheFilePath, qint64 maxBytes)
+    : cacheFilePath_(cacheFilePath), maxBytes_(maxBytes), sessionTime_(QDateTime::currentMSecsSinceEpoch())
+{
+}
+
+QString CommentCache::defaultPath()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation)
+           + "/code-comments-platform/comment-index.bin";
+}
+
+bool CommentCache::load()
+{
+    QWriteLocker locker(&lock_);
+    mapping_.reset();
+    records_.clear();
+    if (!QFileInfo::exists(cacheFilePath_)) {
+        return false;
+    }
+    mapping_ = SourceBuffer::open(cacheFilePath_, SourceBuffer::ReadMode::Map);
+    return indexMapping();
+}
+
+// Validates the file header and walks the record headers. Record contents are
+// checked lazily, when an entry is first served.
+bool CommentCache::indexMapping()
+{
+    records_.clear();
+    if (!mapping_) {
+        return false;
+    }
+
+    FileHeader header;
+    if (mapping_->size() < qsizetype(sizeof(header))) {
+        qCWarning(lcCache) << "Comment cache is truncated, ignoring:" << cacheFilePath_;
+        mapping_.reset();
+        return false;
+    }
+    std::memcpy(&header, mapping_->data(), sizeof(header));
+    if (std::memcmp(header.magic, Magic, sizeof(Magic)) != 0 || header.checksum != headerChecksum(header)) {
+        qCWarning(lcCache) << "Comment cache is corrupt, ignoring:" << cacheFilePath_;
+        mapping_.reset();
+        return false;
+    }
+    if (header.version != FormatVersion) {
+        mapping_.reset(); // Written by another version; rebuilt on the next save
+        return false;
+    }
+    if (header.totalBytes != quint64(mapping_->size())) {
+        qCWarning(lcCache) << "Comment cache is truncated, ignoring:" << cacheFilePath_;
+        mapping_.reset();
+        return false;
+    }
+
+    qsizetype offset = sizeof(FileHeader);
+    for (quint32 i = 0; i < header.recordCount; ++i) {
+        RecordHeader record;
+        if (mapping_->size() - offset < qsizetype(sizeof(record))) {
+            break;
+        }
+        std::memcpy(&record, mapping_->data() + offset, sizeof(record));
+        if (record.recordBytes != quint64(RecordLayout(record).end)
+            || record.recordBytes > quint64(mapping_->size() - offset)) {
+            break;
+        }
+        records_.insert(QString::fromUtf8(mapping_->data() + offset + sizeof(record), record.pathBytes), offset);
+        offset += qsizetype(record.recordBytes);
+    }
+    if (offset != mapping_->size()) {
+        qCWarning(lcCache) << "Comment cache is corrupt after" << records_.size() << "entries:" << cacheFilePath_;
+    }
+    return true;
+}
+
+qsizetype CommentCache::recordOffset(const QString &filePath) const
+{
+    return records_.value(filePath, -1);
+}
+
+bool CommentCache::lookup(const QString &filePath, qint64 size, qint64 lastModified, FileComments &file) const
+{
+    QReadLocker locker(&lock_);
+    const qsizetype offset = recordOffset(filePath);
+    if (offset < 0) {
+        return false;
+    }
+    RecordHeader record;
+    std::memcpy(&record, mapping_->data() + offset, sizeof(record));
+    if (record.size != size || record.lastModified != lastModified || !decodeRecord(offset, file)) {
+        return false;
+    }
+    markUsed(filePath);
+    return true;
+}
+
+bool CommentCache::lookupByHash(const QString &filePath, quint64 hash, FileComments &file) const
+{
+    QReadLocker locker(&lock_);
+    const qsizetype offset = recordOffset(filePath);
+    if (offset < 0) {
+        return false;
+    }
+    RecordHeader record;
+    std::memcpy(&record, mapping_->data() + offset, sizeof(record));
+    if (record.contentHash != hash || !decodeRecord(offset, file)) {
+        return false;
+    }
+    markUsed(filePath);
+    return true;
+}
+
+void CommentCache::markUsed(const QString &filePath) const
+{
+    QMutexLocker locker(&usedMutex_);
+    used_.insert(filePath);
+}
+
+// Fills the arena, content hash and line count of `file`; the text stays in the mapping
+bool CommentCache::decodeRecord(qsizetype offset, FileComments &file) const
+{
+    const char *data = mapping_->data() + offset;
+    RecordHeader record;
+    std::memcpy(&record, data, sizeof(record));
+    if (contentHash(data + ChecksumStart, qsizetype(record.recordBytes) - ChecksumStart) != record.checksum) {
+        qCWarning(lcCache) << "Comment cache entry is corrupt, re-extracting:" << file.filePath;
+        return false;
+    }
+
+    // The columns are copied as they are; only the offsets need checking
+    const RecordLayout layout(record);
+    CommentArena arena;
+    arena.lineNumbers = readColumn<quint32>(data + layout.lineNumbers, record.spanCount);
+    arena.lineEnds = readColumn<quint32>(data + layout.lineEnds, record.spanCount);
+    arena.textStarts = readColumn<quint32>(data + layout.textStarts, record.spanCount);
+    arena.textEnds = readColumn<quint32>(data + layout.textEnds, record.spanCount);
+    arena.flags = readColumn<quint8>(data + layout.flags, record.spanCount);
+    arena.groupStarts = readColumn<quint32>(data + layout.groups, record.groupCount);
+    for (int i = 0; i < arena.commentCount(); ++i) {
+        if (arena.lineStart(i) > arena.textStarts[i] || arena.textStarts[i] > arena.textEnds[i]
+            || arena.textEnds[i] > arena.lineEnds[i] || arena.lineEnds[i] > record.textBytes) {
+            qCWarning(lcCache) << "Comment cache entry is corrupt, re-extracting:" << file.filePath;
+            return false;
+        }
+    }
+    for (int g = 0; g < arena.groupCount(); ++g) {
+        if (arena.groupStarts[g] >= record.spanCount || (g > 0 && arena.groupStarts[g] <= arena.groupStarts[g - 1])) {
+            qCWarning(lcCache) << "Comment cache entry is corrupt, re-extracting:" << file.filePath;
+            return false;
+        }
+    }
+    arena.text = SourceBuffer::slice(mapping_, offset + layout.text, record.textBytes);
+
+    file.contentHash = record.contentHash;
+    file.lineCount = int(record.lineCount);
+    file.comments = arena;
+    return true;
+}
+
+// The arena already holds only the lines with comments, so an entry is a fraction of the file
+QByteArray CommentCache::encodeRecord(const FileComments &file, qint64 lastUsed)
+{
+    const QByteArray path = file.filePath.toUtf8();
+    const CommentArena &arena = file.comments;
+    const qsizetype textBytes = arena.text ? arena.text->size() : 0;
+
+    RecordHeader record = {};
+    record.lastUsed = lastUsed;
+    record.size = file.size;
+    record.lastModified = file.lastModified;
+    record.contentHash = file.contentHash;
+    record.pathBytes = quint32(path.size());
+    record.lineCount = quint32(file.lineCount);
+    record.spanCount = quint32(arena.commentCount());
+    record.groupCount = quint32(arena.groupCount());
+    record.textBytes = quint32(textBytes);
+    const RecordLayout layout(record);
+    record.recordBytes = quint64(layout.end);
+
+    QByteArray bytes(layout.end, '\0');
+    char *data = bytes.data();
+    std::memcpy(data + sizeof(record), path.constData(), size_t(path.size()));
+    writeColumn(data + layout.lineNumbers, arena.lineNumbers);
+    writeColumn(data + layout.lineEnds, arena.lineEnds);
+    writeColumn(data + layout.textStarts, arena.textStarts);
+    writeColumn(data + layout.textEnds, arena.textEnds);
+    writeColumn(data + layout.flags, arena.flags);
+    writeColumn(data + layout.groups, arena.groupStarts);
+    if (textBytes > 0) {
+        std::memcpy(data + layout.text, arena.text->data(), size_t(textBytes));
+    }
+    std::memcpy(data, &record, sizeof(record));
+    record.checksum = contentHash(data + ChecksumStart, layout.end - ChecksumStart);
+    std::memcpy(data, &record, sizeof(record));
+    return bytes;
+}
+
+void CommentCache::store(const FileComments &file)
+{
+    // Encoding is done on the calling worker thread, outside the lock
+    QByteArray record = encodeRecord(file, sessionTime_);
+    QWriteLocker locker(&lock_);
+    pending_.insert(file.filePath, record);
+}
+
+bool CommentCache::save()
+{
+    QWriteLocker locker(&lock_);
+    if (pending_.isEmpty()) {
+        return true;
+    }
+
+    // Candidates are new records and every loaded record they don't replace
+    struct Candidate {
+        qint64 lastUsed;
+        qsizetype bytes;
+        const char *data;
+    };
+    QList<Candidate> candidates;
+    candidates.reserve(pending_.size() + records_.size());
+    for (auto it = pending_.constBegin(); it != pending_.constEnd(); ++it) {
+        candidates.append({sessionTime_, it.value().size(), it.value().constData()});
+    }
+    {
+        QMutexLocker usedLocker(&usedMutex_);
+        for (auto it = records_.constBegin(); it != records_.constEnd(); ++it) {
+            if (pending_.contains(it.key())) {
+                continue;
+            }
+            RecordHeader record;
+            std::memcpy(&record, mapping_->data() + it.value(), sizeof(record));
+            candidates.append({used_.contains(it.key()) ? sessionTime_ : record.lastUsed,
+                               qsizetype(record.recordBytes), mapping_->data() + it.value()});
+        }
+    }
+
+    // Most recently used first; whatever does not fit under the cap is dropped
+    std::stable_sort(candidates.begin(), candidates.end(), [](const Candidate &a, const Candidate &b) {
+        return a.lastUsed > b.lastUsed;
+    });
+    FileHeader header = {};
+    std::memcpy(header.magic, Magic, sizeof(Magic));
+    header.version = FormatVersion;
+    header.totalBytes = sizeof(FileHeader);
+    int kept = 0;
+    while (kept < candidates.size() && header.totalBytes + candidates[kept].bytes <= quint64(maxBytes_)) {
+        header.totalBytes += candidates[kept].bytes;
+        ++kept;
+    }
+    header.recordCount = quint32(kept);
+    header.checksum = headerChecksum(header);
+
+    QDir().mkpath(QFileInfo(cacheFilePath_).absolutePath());
+    QSaveFile out(cacheFilePath_);
+    if (!out.open(QIODevice::WriteOnly)) {
+        qCWarning(lcCache) << "Could not write comment cache:" << cacheFilePath_ << out.errorString();
+        return false;
+    }
+    out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    for (int i = 0; i < kept; ++i) {
+        // Only the unchecksummed lastUsed field differs from the source bytes
+        RecordHeader record;
+        std::memcpy(&record, candidates[i].data, sizeof(record));
+        record.lastUsed = candidates[i].lastUsed;
+        out.write(reinterpret_cast<const char *>(&record), sizeof(record));
+        out.write(candidates[i].data + sizeof(record), candidates[i].bytes - qsizetype(sizeof(record)));
+    }
+    if (!out.commit()) {
+        qCWarning(lcCache) << "Could not write comment cache:" << cacheFilePath_ << out.errorString();
+        return false;
+    }
+
+    // Groups handed out earlier keep the previous mapping alive
+    pending_.clear();
+    {
+        QMutexLocker usedLocker(&usedMutex_);
+        used_.clear();
+    }
+    mapping_ = SourceBuffer::open(cacheFilePath_, SourceBuffer::ReadMode::Map);
+    return indexMapping();
+}
@@ -1,199 +1,102 @@
 #include "CommentExtractor.h"
-#include <QFile>
-#include <QTextStream>
-#include <QRegularExpression>
-#include <QDebug>
-
-CommentExtractor::CommentExtractor(QObject *parent) : QObject(parent)
+#include "CommentCache.h"
+#include "ContentHash.h"
+#include "Trace.h"
+#include <QDateTime>
+#include <QFileInfo>
+#include <cstring>
+
+QSharedPointer<const SourceBuffer> CommentExtractor::scanFile(const QString &filePath, QList<CommentSpan> &spans) const
 {
-
+    // Load (or map) the file once and let the lexer walk it in a single pass
+    QSharedPointer<const SourceBuffer> source = SourceBuffer::open(filePath, readMode_);
+    if (source) {
+        spans = CommentLexer(LanguageRegistry::forFile(filePath)).scan(source->data(), source->size());
+    }
+    return source;
 }
 
-QList<QPair<int, QString>> CommentExtractor::extractComments(const QString &filePath)
+QList<QPair<int, QString>> CommentExtractor::extractComments(const QString &filePath) const
 {
     QList<QPair<int, QString>> comments;
-    QFile file(filePath);
-
-    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
-        qWarning() << "Could not open file:" << filePath;
+    QList<CommentSpan> spans;
+    QSharedPointer<const SourceBuffer> source = scanFile(filePath, spans);
+    if (!source) {
         return comments;
     }
 
-    QTextStream in(&file);
-    int lineNumber = 0;
-    while (!in.atEnd()) {
-        QString line = in.readLine();
-        lineNumber++;
-
-        // Regex for C++ style single-line comments (//)
-        QRegularExpression cppSingleLineCommentRegex("//(.*?)$", QRegularExpression::MultilineOption);
-        QRegularExpressionMatchIterator i = cppSingleLineCommentRegex.globalMatch(line);
-        while (i.hasNext()) {
-            QRegularExpressionMatch match = i.next();
-            QString comment = match.captured(1).trimmed(); // Capture group 1 for content
-            if (!comment.isEmpty()) {
-                comments.append(qMakePair(lineNumber, comment));
-            }
-        }
-
-        // Regex for Python style single-line comments (#)
-        QRegularExpression pythonSingleLineCommentRegex("#(.*?)$", QRegularExpression::MultilineOption);
-        QRegularExpressionMatchIterator j = pythonSingleLineCommentRegex.globalMatch(line);
-        while (j.hasNext()) {
-            QRegularExpressionMatch match = j.next();
-            QString comment = match.captured(1).trimmed(); // Capture group 1 for content
-            if (!comment.isEmpty()) {
-                comments.append(qMakePair(lineNumber, comment));
-            }
-        }
-
-        // Regex for C-style multi-line comments (/* */)
-        // Might need to be refined for complex cases
-        QRegularExpression multiLineCommentRegex("/\\*(.*?)\\*/", QRegularExpression::DotMatchesEverythingOption);
-        QRegularExpressionMatchIterator k = multiLineCommentRegex.globalMatch(line);
-        while (k.hasNext()) {
-            QRegularExpressionMatch match = k.next();
-            QString comment = match.captured(1).trimmed(); // Capture group 1 for content
-            if (!comment.isEmpty()) {
-                comments.append(qMakePair(lineNumber, comment));
-            }
-        }
+    comments.reserve(spans.size());
+    for (const CommentSpan &span : spans) {
+        comments.append(qMakePair(span.lineNumber, source->decode(span.textStart, span.textEnd)));
     }
-
-    file.close();
     return comments;
 }
 
 // Extract comments with full context (for inlines)
-QList<QPair<int, QPair<QString, QString>>> CommentExtractor::extractCommentsWithContext(const QString &filePath)
+QList<QPair<int, QPair<QString, QString>>> CommentExtractor::extractCommentsWithContext(const QString &filePath) const
 {
     QList<QPair<int, QPair<QString, QString>>> commentsWithContext; // lineNumber, (comment, fullLine)
-    QFile file(filePath);
-
-    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
-        qWarning() << "Could not open file:" << filePath;
+    QList<CommentSpan> spans;
+    QSharedPointer<const SourceBuffer> source = scanFile(filePath, spans);
+    if (!source) {
         return commentsWithContext;
     }
 
-    QTextStream in(&file);
-    int lineNumber = 0;
-    while (!in.atEnd()) {
-        QString line = in.readLine();
-        lineNumber++;
-
-        // Check for C++ style comments (//)
-        QRegularExpression cppSingleLineCommentRegex("//(.*?)$", QRegularExpression::MultilineOption);
-        QRegularExpressionMatch cppMatch = cppSingleLineCommentRegex.match(line);
-        if (cppMatch.hasMatch()) {
-            QString comment = cppMatch.captured(1).trimmed();
-            if (!comment.isEmpty()) {
-                commentsWithContext.append(qMakePair(lineNumber, qMakePair(comment, line)));
-            }
-        }
-
-        // Check for Python style comments (#)
-        QRegularExpression pythonSingleLineCommentRegex("#(.*?)$", QRegularExpression::MultilineOption);
-        QRegularExpressionMatch pythonMatch = pythonSingleLineCommentRegex.match(line);
-        if (pythonMatch.hasMatch()) {
-            QString comment = pythonMatch.captured(1).trimmed();
-            if (!comment.isEmpty()) {
-                commentsWithContext.append(qMakePair(lineNumber, qMakePair(comment, line)));
-            }
-        }
-
-        // Check for C-style multi-line comments (/* */)
-        QRegularExpression multiLineCommentRegex("/\\*(.*?)\\*/", QRegularExpression::DotMatchesEverythingOption);
-        QRegularExpressionMatch multiMatch = multiLineCommentRegex.match(line);
-        if (multiMatch.hasMatch()) {
-            QString comment = multiMatch.captured(1).trimmed();
-            if (!comment.isEmpty()) {
-                commentsWithContext.append(qMakePair(lineNumber, qMakePair(comment, line)));
-            }
-        }
+    commentsWithContext.reserve(spans.size());
+    for (const CommentSpan &span : spans) {
+        commentsWithContext.append(qMakePair(span.lineNumber, qMakePair(source->decode(span.textStart, span.textEnd),
+                                                                        source->decode(span.lineStart, span.lineEnd))));
     }
-
-    file.close();
     return commentsWithContext;
 }
 
-QList<CommentGroup> CommentExtractor::extractGroupedComments(const QString &filePath)
+FileComments CommentExtractor::extractFile(const QString &filePath) const
 {
-    QList<CommentGroup> groupedComments;
-    QList<QPair<int, QPair<QString, QString>>> allCommentsWithContext = extractCommentsWithContext(filePath);
-    
-    if (allCommentsWithContext.isEmpty()) {
-        return groupedComments;
+    TraceSpan extractSpan("extract", filePath);
+    FileComments file;
+    file.filePath = filePath;
+
+    // Stat before reading, so a file that changes mid-read is re-parsed next time
+    const QFileInfo info(filePath);
+    file.size = info.size();
+    file.lastModified = info.lastModified().toMSecsSinceEpoch();
+    if (cache_ && cache_->lookup(filePath, file.size, file.lastModified, file)) {
+        return file;
+    }
+
+    QSharedPointer<const SourceBuffer> source = SourceBuffer::open(filePath, readMode_);
+    if (!source) {
+        return file;
     }
-    
-    CommentGroup currentGroup;
-    auto firstComment = allCommentsWithContext.first();
-    currentGroup.lineNumbers.append(firstComment.first);
-    currentGroup.comments.append(firstComment.second.first);
-    currentGroup.fullLines.append(firstComment.second.second);
-    currentGroup.isInline.append(isInlineComment(firstComment.second.second, firstComment.second.first));
-    
-    for (int i = 1; i < allCommentsWithContext.size(); ++i) {
-        int currentLine = allCommentsWithContext[i].first;
-        int previousLine = allCommentsWithContext[i-1].first;
-        QString comment = allCommentsWithContext[i].second.first;
-        QString fullLine = allCommentsWithContext[i].second.second;
-        
-        // If current line is consecutive to previous line, add to current group
-        if (currentLine == previousLine + 1) {
-            currentGroup.lineNumbers.append(currentLine);
-            currentGroup.comments.append(comment);
-            currentGroup.fullLines.append(fullLine);
-            currentGroup.isInline.append(isInlineComment(fullLine, comment));
-        } else {
-            // Start a new group
-            groupedComments.append(currentGroup);
-            currentGroup = CommentGroup();
-            currentGroup.lineNumbers.append(currentLine);
-            currentGroup.comments.append(comment);
-            currentGroup.fullLines.append(fullLine);
-            currentGroup.isInline.append(isInlineComment(fullLine, comment));
+    file.contentHash = contentHash(source->data(), source->size());
+    {
+        // A last line without a newline still counts
+        const char *data = source->data();
+        const char *end = data + source->size();
+        for (const char *p = data; p < end; ++file.lineCount) {
+            const char *newline = static_cast<const char *>(std::memchr(p, '\n', size_t(end - p)));
+            p = newline ? newline + 1 : end;
         }
     }
-    
-    // Don't forget the last group
-    if (!currentGroup.lineNumbers.isEmpty()) {
-        groupedComments.append(currentGroup);
+    if (cache_ && cache_->lookupByHash(filePath, file.contentHash, file)) {
+        cache_->store(file); // Touched but unchanged, e.g. by a checkout; remember the new mtime
+        return file;
     }
-    
-    return groupedComments;
-}
-
-bool CommentExtractor::isInlineComment(const QString &fullLine, const QString &comment)
-{
-    // A comment is inline if there's non-whitespace code before the comment marker
-    QString trimmedLine = fullLine.trimmed();
-    
-    // Check for C++ style comments
-    int cppCommentPos = fullLine.indexOf("//");
-    if (cppCommentPos > 0) {
-        QString beforeComment = fullLine.left(cppCommentPos).trimmed();
-        if (!beforeComment.isEmpty()) {
-            return true; // There's code before the comment
-        }
+    QList<CommentSpan> spans;
+    {
+        TraceSpan lexSpan("lex", filePath);
+        spans = CommentLexer(LanguageRegistry::forFile(filePath)).scan(source->data(), source->size());
     }
-    
-    // Check for Python style comments
-    int pythonCommentPos = fullLine.indexOf("#");
-    if (pythonCommentPos > 0) {
-        QString beforeComment = fullLine.left(pythonCommentPos).trimmed();
-        if (!beforeComment.isEmpty()) {
-            return true; // There's code before the comment
-        }
+
+    // Only the commented lines are copied out, so the source is released on return
+    {
+        TraceSpan groupSpan("group", filePath);
+        file.comments = CommentArena::build(source->data(), spans);
     }
-    
-    // Check for C-style comments
-    int cStyleCommentPos = fullLine.indexOf("/*");
-    if (cStyleCommentPos > 0) {
-        QString beforeComment = fullLine.left(cStyleCommentPos).trimmed();
-        if (!beforeComment.isEmpty()) {
-            return true; // There's code before the comment
-        }
+
+    if (cache_) {
+        cache_->store(file);
     }
-    
-    return false; // It's a standalone comment
-}
\ No newline at end of file
+
+    return file;
+}
@@ -0,0 +1,35 @@
+#include "CommentFilterModel.h"
+
+CommentFilterModel::CommentFilterModel(QObject *parent) : QSortFilterProxyModel(parent)
+{
+    // Matches are recomputed by the caller; edits must not make rows vanish under the editor
+    setDynamicSortFilter(false);
+}
+
+void CommentFilterModel::setMatches(const CommentMatches &matches)
+{
+    matches_ = matches;
+    filtering_ = true;
+    invalidateFilter();
+}
+
+void CommentFilterModel::clearMatches()
+{
+    if (!filtering_) {
+        return;
+    }
+    matches_ = CommentMatches();
+    filtering_ = false;
+    invalidateFilter();
+}
+
+bool CommentFilterModel::filterAcceptsRow(int sourceRow, const QModelIndex &sourceParent) const
+{
+    if (!filtering_) {
+        return true;
+    }
+    if (!sourceParent.isValid()) {
+        return matches_.fileMatches(sourceRow);
+    }
+    return matches_.groupMatches(sourceParent.row(), sourceRow);
+}
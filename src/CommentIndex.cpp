@@ -0,0 +1,441 @@
+#include "CommentIndex.h"
+#include <QThread>
+#include <algorithm>
+#include <optional>
+
+namespace {
+
+// Candidate sets larger than this are verified on the pool
+const qsizetype ParallelThreshold = 32 * 1024;
+
+inline char foldAscii(char c)
+{
+    return c >= 'A' && c <= 'Z' ? char(c + ('a' - 'A')) : c;
+}
+
+inline bool isBlank(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r' || c == '\f' || c == '\v';
+}
+
+inline bool isWordByte(char c)
+{
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+}
+
+inline quint32 trigramAt(const char *p)
+{
+    return quint32(uchar(foldAscii(p[0]))) << 16 | quint32(uchar(foldAscii(p[1]))) << 8 | uchar(foldAscii(p[2]));
+}
+
+// Distinct trigrams of `text`, ascending
+QList<quint32> trigramsOf(QByteArrayView text)
+{
+    QList<quint32> keys;
+    if (text.size() < 3) {
+        return keys;
+    }
+    keys.reserve(text.size() - 2);
+    for (qsizetype i = 0; i + 3 <= text.size(); ++i) {
+        keys.append(trigramAt(text.data() + i));
+    }
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+    return keys;
+}
+
+// `needle` must already be folded
+bool containsFolded(QByteArrayView haystack, const QByteArray &needle)
+{
+    const qsizetype last = haystack.size() - needle.size();
+    const char *h = haystack.data();
+    for (qsizetype i = 0; i <= last; ++i) {
+        if (foldAscii(h[i]) != needle[0]) {
+            continue;
+        }
+        qsizetype j = 1;
+        while (j < needle.size() && foldAscii(h[i + j]) == needle[j]) {
+            ++j;
+        }
+        if (j == needle.size()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Bit t set for each knownTags()[t] that occurs in `text` as a whole word
+quint32 tagsOf(QByteArrayView text)
+{
+    quint32 found = 0;
+    const QStringList tags = CommentIndex::knownTags();
+    for (int t = 0; t < tags.size(); ++t) {
+        const QByteArray tag = tags[t].toLatin1();
+        for (qsizetype at = text.indexOf(tag); at >= 0; at = text.indexOf(tag, at + 1)) {
+            const qsizetype end = at + tag.size();
+            if ((at == 0 || !isWordByte(text[at - 1])) && (end == text.size() || !isWordByte(text[end]))) {
+                found |= 1u << t;
+                break;
+            }
+        }
+    }
+    return found;
+}
+
+// A group's text as the model shows it, its lines joined by '\n'. A one-line group
+// is viewed in place; other groups are joined into `scratch`.
+QByteArrayView groupTextOf(const CommentArena &arena, int groupRow, QByteArray &scratch)
+{
+    const char *text = arena.text ? arena.text->data() : "";
+    // Mirrors CommentGroup::getCombinedComments(): whole lines, trimmed, where the
+    // line is shown whole, otherwise the comment text
+    auto lineText = [&](int i) {
+        qsizetype from = arena.textStarts[i];
+        qsizetype to = arena.textEnds[i];
+        if (arena.flags[i] & (CommentArena::InlineFlag | CommentArena::MoreCommentsFlag)) {
+            from = arena.lineStart(i);
+            to = arena.lineEnds[i];
+            while (from < to && isBlank(text[from])) {
+                ++from;
+            }
+            while (to > from && isBlank(text[to - 1])) {
+                --to;
+            }
+        }
+        return QByteArrayView(text + from, to - from);
+    };
+    const int begin = arena.groupBegin(groupRow);
+    const int end = arena.groupEnd(groupRow);
+    if (end - begin == 1) {
+        return lineText(begin);
+    }
+    scratch.clear();
+    for (int i = begin; i < end; ++i) {
+        if (i > begin) {
+            scratch.append('\n');
+        }
+        scratch.append(lineText(i));
+    }
+    return scratch;
+}
+
+// The conditions of a query, prepared once per thread
+struct Matcher {
+    QByteArray needle; // ASCII-folded
+    QRegularExpression regex;
+    quint32 tagMask = 0;
+
+    explicit Matcher(const CommentQuery &query)
+        : needle(query.text.toUtf8()), regex(query.regex.pattern(), query.regex.patternOptions())
+    {
+        for (char &c : needle) {
+            c = foldAscii(c);
+        }
+        const QStringList tags = CommentIndex::knownTags();
+        for (const QString &tag : query.tags) {
+            const int t = tags.indexOf(tag);
+            if (t >= 0) {
+                tagMask |= 1u << t;
+            }
+        }
+    }
+
+    bool matches(QByteArrayView text, quint32 tags) const
+    {
+        if (tagMask && !(tags & tagMask)) {
+            return false;
+        }
+        if (!needle.isEmpty() && !containsFolded(text, needle)) {
+            return false;
+        }
+        return regex.pattern().isEmpty() || regex.match(QString::fromUtf8(text)).hasMatch();
+    }
+};
+
+QList<quint32> intersect(const QList<quint32> &a, const QList<quint32> &b)
+{
+    QList<quint32> result;
+    result.reserve(std::min(a.size(), b.size()));
+    std::set_intersection(a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(result));
+    return result;
+}
+
+} // namespace
+
+CommentIndex::CommentIndex()
+{
+    pool_.setMaxThreadCount(QThread::idealThreadCount());
+    tagDocuments_.resize(knownTags().size());
+}
+
+QStringList CommentIndex::knownTags()
+{
+    return {"TODO", "FIXME", "HACK", "XXX", "BUG", "NOTE"};
+}
+
+void CommentIndex::clear()
+{
+    documents_.clear();
+    fileDocuments_.clear();
+    fileArenas_.clear();
+    trigrams_.clear();
+    tagDocuments_.fill(QList<quint32>());
+    liveCount_ = 0;
+}
+
+void CommentIndex::setFile(int fileRow, const CommentArena &comments, const QHash<int, QString> &editedText)
+{
+    beginFile(fileRow, comments);
+    indexMore(fileRow, editedText, QDeadlineTimer(QDeadlineTimer::Forever));
+}
+
+void CommentIndex::beginFile(int fileRow, const CommentArena &comments)
+{
+    if (fileRow >= fileDocuments_.size()) {
+        fileDocuments_.resize(fileRow + 1);
+        fileArenas_.resize(fileRow + 1);
+    }
+    for (quint32 id : std::as_const(fileDocuments_[fileRow])) {
+        removeDocument(id);
+    }
+    fileDocuments_[fileRow].clear();
+    fileArenas_[fileRow] = comments;
+}
+
+void CommentIndex::removeFile(int fileRow)
+{
+    if (fileRow < fileDocuments_.size()) {
+        beginFile(fileRow, CommentArena());
+        compactIfSparse();
+    }
+}
+
+bool CommentIndex::indexMore(int fileRow, const QHash<int, QString> &editedText, QDeadlineTimer deadline)
+{
+    // Groups already indexed keep their ids; the clock is read once per batch of groups
+    const int groupCount = fileArenas_[fileRow].groupCount();
+    const int first = int(fileDocuments_[fileRow].size());
+    fileDocuments_[fileRow].reserve(groupCount);
+    for (int groupRow = first; groupRow < groupCount; ++groupRow) {
+        if (groupRow > first && (groupRow - first) % 64 == 0 && deadline.hasExpired()) {
+            compactIfSparse();
+            return false;
+        }
+        auto edited = editedText.constFind(groupRow);
+        const quint32 id = addDocument(fileRow, groupRow, edited != editedText.constEnd() ? &edited.value() : nullptr);
+        fileDocuments_[fileRow].append(id);
+    }
+    compactIfSparse();
+    return true;
+}
+
+void CommentIndex::setGroup(int fileRow, int groupRow, const QString &text)
+{
+    if (fileRow >= fileDocuments_.size() || groupRow >= fileDocuments_[fileRow].size()) {
+        return;
+    }
+    quint32 &id = fileDocuments_[fileRow][groupRow];
+    removeDocument(id);
+    id = addDocument(fileRow, groupRow, &text);
+    compactIfSparse();
+}
+
+void CommentIndex::restoreGroup(int fileRow, int groupRow)
+{
+    if (fileRow >= fileDocuments_.size() || groupRow >= fileDocuments_[fileRow].size()) {
+        return;
+    }
+    quint32 &id = fileDocuments_[fileRow][groupRow];
+    removeDocument(id);
+    id = addDocument(fileRow, groupRow, nullptr);
+    compactIfSparse();
+}
+
+// A document's text as the model shows it; an edited group is viewed in place
+QByteArrayView CommentIndex::textOf(const Document &document, QByteArray &scratch) const
+{
+    if (document.edited) {
+        return document.editedText;
+    }
+    return groupTextOf(fileArenas_[document.fileRow], document.groupRow, scratch);
+}
+
+// `editedText` is null for a group indexed from its file's arena
+quint32 CommentIndex::addDocument(int fileRow, int groupRow, const QString *editedText)
+{
+    Document document;
+    document.fileRow = fileRow;
+    document.groupRow = groupRow;
+    if (editedText) {
+        document.edited = true;
+        document.editedText = editedText->toUtf8();
+    }
+    return insertDocument(std::move(document));
+}
+
+// New ids only grow, so every posting list stays sorted by appending
+quint32 CommentIndex::insertDocument(Document document)
+{
+    const quint32 id = quint32(documents_.size());
+    QByteArray scratch;
+    const QByteArrayView text = textOf(document, scratch);
+
+    // Tags are whole upper-case words; a document re-inserted by compaction has them already
+    if (document.tags == 0) {
+        document.tags = tagsOf(text);
+    }
+    for (quint32 key : trigramsOf(text)) {
+        trigrams_[key].append(id);
+    }
+    for (int t = 0; t < tagDocuments_.size(); ++t) {
+        if (document.tags & (1u << t)) {
+            tagDocuments_[t].append(id);
+        }
+    }
+    document.live = true;
+    documents_.append(std::move(document));
+    ++liveCount_;
+    return id;
+}
+
+// Posting lists keep the id; searches skip documents that are no longer live
+void CommentIndex::removeDocument(quint32 id)
+{
+    Document &document = documents_[id];
+    if (document.live) {
+        document.live = false;
+        document.editedText = QByteArray();
+        --liveCount_;
+    }
+}
+
+// Rebuilds the index once removed documents outnumber live ones
+void CommentIndex::compactIfSparse()
+{
+    const qsizetype dead = documents_.size() - liveCount_;
+    if (dead < 64 * 1024 || dead < liveCount_) {
+        return;
+    }
+
+    QList<Document> documents;
+    documents.swap(documents_);
+    trigrams_.clear();
+    tagDocuments_.fill(QList<quint32>());
+    liveCount_ = 0;
+    for (Document &document : documents) {
+        if (document.live) {
+            const int fileRow = document.fileRow;
+            const int groupRow = document.groupRow;
+            fileDocuments_[fileRow][groupRow] = insertDocument(std::move(document));
+        }
+    }
+}
+
+CommentMatches CommentIndex::search(const CommentQuery &query) const
+{
+    // Candidates from the posting lists; none means every document
+    std::optional<QList<quint32>> candidates;
+    const Matcher matcher(query);
+
+    if (!query.tags.isEmpty()) {
+        QList<quint32> tagged;
+        for (int t = 0; t < tagDocuments_.size(); ++t) {
+            if (matcher.tagMask & (1u << t)) {
+                tagged += tagDocuments_[t];
+            }
+        }
+        std::sort(tagged.begin(), tagged.end());
+        tagged.erase(std::unique(tagged.begin(), tagged.end()), tagged.end());
+        candidates = tagged;
+    }
+
+    const QByteArray &needle = matcher.needle;
+    if (needle.size() >= 3) {
+        // Intersect the rarest posting lists first
+        QList<const QList<quint32> *> postings;
+        for (quint32 key : trigramsOf(needle)) {
+            auto it = trigrams_.constFind(key);
+            if (it == trigrams_.constEnd()) {
+                return CommentMatches();
+            }
+            postings.append(&it.value());
+        }
+        std::sort(postings.begin(), postings.end(), [](const QList<quint32> *a, const QList<quint32> *b) {
+            return a->size() < b->size();
+        });
+        for (const QList<quint32> *list : std::as_const(postings)) {
+            candidates = candidates ? intersect(*candidates, *list) : *list;
+            if (candidates->isEmpty()) {
+                break;
+            }
+        }
+    }
+
+    // Verify candidates: trigrams only say the substring may occur
+    const QList<quint32> *candidateIds = candidates ? &*candidates : nullptr;
+    auto verify = [&](qsizetype from, qsizetype to, QList<quint32> &matched) {
+        const Matcher threadMatcher(query); // One regex per thread
+        QByteArray scratch;
+        for (qsizetype i = from; i < to; ++i) {
+            const quint32 id = candidateIds ? candidateIds->at(i) : quint32(i);
+            const Document &document = documents_[id];
+            if (document.live && threadMatcher.matches(textOf(document, scratch), document.tags)) {
+                matched.append(id);
+            }
+        }
+    };
+
+    const qsizetype total = candidateIds ? candidateIds->size() : documents_.size();
+    QList<QList<quint32>> chunks(total > ParallelThreshold ? pool_.maxThreadCount() * 4 : 1);
+    const qsizetype chunkSize = (total + chunks.size() - 1) / chunks.size();
+    if (chunks.size() == 1) {
+        verify(0, total, chunks[0]);
+    } else {
+        for (int c = 0; c < chunks.size(); ++c) {
+            const qsizetype from = std::min(total, c * chunkSize);
+            const qsizetype to = std::min(total, from + chunkSize);
+            QList<quint32> *matched = &chunks[c];
+            pool_.start([&verify, matched, from, to]() { verify(from, to, *matched); });
+        }
+        pool_.waitForDone();
+    }
+
+    CommentMatches matches;
+    matches.groups.resize(fileDocuments_.size());
+    for (const QList<quint32> &chunk : std::as_const(chunks)) {
+        for (quint32 id : chunk) {
+            const Document &document = documents_[id];
+            QBitArray &groups = matches.groups[document.fileRow];
+            if (groups.isEmpty()) {
+                groups.resize(fileDocuments_[document.fileRow].size());
+                ++matches.fileCount;
+            }
+            groups.setBit(document.groupRow);
+            ++matches.groupCount;
+        }
+    }
+    return matches;
+}
+
+QBitArray CommentIndex::scanFile(const CommentQuery &query, const CommentArena &comments,
+                                 const QHash<int, QString> &editedText)
+{
+    const Matcher matcher(query);
+    QBitArray groups;
+    QByteArray scratch;
+    for (int groupRow = 0; groupRow < comments.groupCount(); ++groupRow) {
+        const auto edited = editedText.constFind(groupRow);
+        if (edited != editedText.constEnd()) {
+            scratch = edited->toUtf8();
+        }
+        const QByteArrayView text = edited != editedText.constEnd() ? QByteArrayView(scratch)
+                                                                    : groupTextOf(comments, groupRow, scratch);
+        if (matcher.matches(text, matcher.tagMask ? tagsOf(text) : 0)) {
+            if (groups.isEmpty()) {
+                groups.resize(comments.groupCount());
+            }
+            groups.setBit(groupRow);
+        }
+    }
+    return groups;
+}
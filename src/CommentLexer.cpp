@@ -0,0 +1,516 @@
+#include "CommentLexer.h"
+#include "ByteScan.h"
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+inline bool isBlank(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r' || c == '\f' || c == '\v';
+}
+
+inline bool isIdentifierChar(char c)
+{
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+}
+
+// Lexer state for one buffer. Every scan* method starts at an opening token and
+// returns the position just after the construct it consumed. `S` is a constexpr
+// descriptor, so each test of one of its flags folds away in that language's instance.
+template <const LanguageSyntax &S>
+class Scanner
+{
+public:
+    Scanner(const char *data, qsizetype size, QList<CommentSpan> &spans)
+        : begin_(data), end_(data + size), spans_(spans)
+    {
+        lineStart_ = begin_;
+    }
+
+    // The bytes that can start a comment, a literal or a line in this language.
+    // Everything between two of them is code, so the vector kernel skips it.
+    static const ByteFinder &codeBytes()
+    {
+        // Bytes a language does not use collapse into '\n'
+        static const ByteFinder finder{
+            '\n', '"',
+            S.lineComments || S.blockComments ? '/' : '\n',
+            S.hashComments ? '#' : '\n',
+            S.singleQuotes ? '\'' : '\n',
+            S.backtickStrings ? '`' : '\n',
+            S.rustRawStrings ? 'r' : '\n',
+            S.verbatimStrings ? '@' : '\n',
+            S.bracketComments ? '[' : '\n',
+        };
+        return finder;
+    }
+
+    // Inside a block comment only a newline, "*/" and (if comments nest) "/*" matter
+    static const ByteFinder &blockCommentBytes()
+    {
+        static const ByteFinder finder{'\n', '*', S.nestedBlockComments ? '/' : '\n'};
+        return finder;
+    }
+
+    void run()
+    {
+        const char *p = begin_;
+        // Skip a UTF-8 byte order mark, as QTextStream did
+        if (end_ - p >= 3 && uchar(p[0]) == 0xEF && uchar(p[1]) == 0xBB && uchar(p[2]) == 0xBF) {
+            p += 3;
+            lineStart_ = p;
+        }
+
+        const ByteFinder &candidates = codeBytes();
+        while (p < end_) {
+            const char *next = candidates.find(p, end_);
+            if (next != p) {
+                // Skipped bytes are code unless they are all blank
+                if (!codeOnLine_) {
+                    codeOnLine_ = std::any_of(p, next, [](char c) { return !isBlank(c); });
+                }
+                p = next;
+                if (p == end_) {
+                    break;
+                }
+            }
+
+            const char c = *p;
+            if (c == '\n') {
+                finishLine(p);
+                ++p;
+            } else if (S.lineComments && c == '/' && p + 1 < end_ && p[1] == '/') {
+                p = scanLineComment(p, 2, '/');
+            } else if (S.blockComments && c == '/' && p + 1 < end_ && p[1] == '*') {
+                p = scanBlockComment(p);
+            } else if (S.hashComments && c == '#' && (!S.hashAtWordStart || isWordStart(p))) {
+                const int level = S.bracketComments ? bracketLevel(p + 1) : -1;
+                p = level >= 0 ? scanBracket(p, p + 1, level, true) : scanLineComment(p, 1, '#');
+            } else if (c == '"' || (S.singleQuotes && c == '\'') || (S.backtickStrings && c == '`')) {
+                codeOnLine_ = true;
+                p = scanLiteral(p);
+            } else if (S.rustRawStrings && c == 'r' && isRustRawStringStart(p)) {
+                codeOnLine_ = true;
+                p = scanRustRawString(p);
+            } else if (S.verbatimStrings && c == '@' && p + 1 < end_ && p[1] == '"') {
+                codeOnLine_ = true;
+                p = scanVerbatimString(p + 2);
+            } else if (S.bracketComments && c == '[' && bracketLevel(p) >= 0) {
+                codeOnLine_ = true; // Bracket argument; "#" inside is not a comment
+                p = scanBracket(p, p, bracketLevel(p), false);
+            } else {
+                codeOnLine_ = true; // A candidate byte that starts nothing, e.g. a division
+                ++p;
+            }
+        }
+
+        if (hasPending_) {
+            finishLine(end_);
+        }
+    }
+
+private:
+    // Called with p at a '\n' (or the end of the buffer)
+    void finishLine(const char *newline)
+    {
+        if (hasPending_) {
+            const char *lineEnd = newline;
+            if (lineEnd > lineStart_ && lineEnd[-1] == '\r') {
+                --lineEnd;
+            }
+            pending_.lineEnd = lineEnd - begin_;
+            pending_.commentEnd = std::min(pending_.commentEnd, pending_.lineEnd);
+            spans_.append(pending_);
+            hasPending_ = false;
+        }
+        ++lineNumber_;
+        lineStart_ = newline + 1;
+        codeOnLine_ = false;
+    }
+
+    // Records [from, to) on the current line as comment text, trimmed; the comment
+    // including its markers spans [commentStart, commentEnd)
+    void record(const char *commentStart, const char *from, const char *to, const char *commentEnd, bool continuation,
+                bool fragment = false)
+    {
+        while (from < to && isBlank(*from)) {
+            ++from;
+        }
+        while (to > from && isBlank(to[-1])) {
+            --to;
+        }
+        if (from == to) {
+            return; // Empty comments are not reported
+        }
+        if (hasPending_) {
+            // One comment per line: the first keeps its place, e.g. "/* a */ x; // b"
+            // reports "a", and the line is flagged so it is shown whole
+            pending_.hasMoreComments = true;
+            return;
+        }
+
+        pending_.lineNumber = lineNumber_;
+        pending_.lineStart = lineStart_ - begin_;
+        pending_.textStart = from - begin_;
+        pending_.textEnd = to - begin_;
+        pending_.commentStart = commentStart - begin_;
+        pending_.commentEnd = commentEnd - begin_;
+        pending_.isInline = !continuation && codeOnLine_;
+        pending_.isBlockFragment = fragment;
+        pending_.hasMoreComments = false;
+        hasPending_ = true;
+    }
+
+    // Shell: "#" starts a comment only where a new word could begin
+    bool isWordStart(const char *p) const
+    {
+        if (p == lineStart_) {
+            return true;
+        }
+        const char before = p[-1];
+        return isBlank(before) || before == ';' || before == '|' || before == '&' || before == '(' || before == ')';
+    }
+
+    // CMake: the number of '=' in a "[[", "[=[", ... opener at p, or -1
+    int bracketLevel(const char *p) const
+    {
+        if (p >= end_ || *p != '[') {
+            return -1;
+        }
+        const char *q = p + 1;
+        while (q < end_ && *q == '=') {
+            ++q;
+        }
+        return q < end_ && *q == '[' ? int(q - p - 1) : -1;
+    }
+
+    const char *findNewline(const char *p) const
+    {
+        const void *hit = std::memchr(p, '\n', size_t(end_ - p));
+        return hit ? static_cast<const char *>(hit) : end_;
+    }
+
+    const char *scanLineComment(const char *p, int markerLength, char marker)
+    {
+        const char *text = p + markerLength;
+        // Doc-comment markers ("///", "//!", "##") are decoration, not text
+        while (text < end_ && *text == marker) {
+            ++text;
+        }
+        if (marker == '/' && text < end_ && *text == '!') {
+            ++text;
+        }
+        const char *newline = findNewline(text);
+        record(p, text, newline, newline, false);
+        return newline;
+    }
+
+    const char *scanBlockComment(const char *p)
+    {
+        const char *q = p + 2;
+        while (q < end_ && *q == '*' && !(q + 1 < end_ && q[1] == '/')) {
+            ++q;
+        }
+        if (q < end_ && *q == '!') {
+            ++q;
+        }
+
+        bool continuation = false;
+        int depth = 1;
+        const char *segmentStart = p;
+        const char *segment = q;
+        const ByteFinder &commentBytes = blockCommentBytes();
+        while (true) {
+            bool closed = false;
+            while ((q = commentBytes.find(q, end_)) < end_ && *q != '\n') {
+                if (*q == '*' && q + 1 < end_ && q[1] == '/') {
+                    if (--depth == 0) {
+                        closed = true;
+                        break;
+                    }
+                    q += 2;
+                } else if (S.nestedBlockComments && *q == '/' && q + 1 < end_ && q[1] == '*') {
+                    ++depth;
+                    q += 2;
+                } else {
+                    ++q;
+                }
+            }
+            record(segmentStart, segment, q, closed ? q + 2 : q, continuation, continuation || !closed);
+            if (q >= end_) {
+                return end_;
+            }
+            if (closed) {
+                return q + 2; // Closing "*/"
+            }
+
+            finishLine(q);
+            ++q;
+            continuation = true;
+
+            // Strip the leading " * " decoration of continuation lines
+            while (q < end_ && isBlank(*q)) {
+                ++q;
+            }
+            segmentStart = q;
+            while (q < end_ && *q == '*' && !(q + 1 < end_ && q[1] == '/')) {
+                ++q;
+            }
+            segment = q;
+        }
+    }
+
+    // CMake bracket comment ("#[[ ... ]]", start at '#') or bracket argument ("[[ ... ]]",
+    // start at '['); `open` is the first '[' and `level` the number of '=' between brackets
+    const char *scanBracket(const char *start, const char *open, int level, bool isComment)
+    {
+        const char *q = open + level + 2;
+        bool continuation = false;
+        const char *segmentStart = start;
+        const char *segment = q;
+        while (true) {
+            bool closed = false;
+            while (q < end_ && *q != '\n') {
+                if (*q == ']' && end_ - q >= level + 2 && q[level + 1] == ']'
+                    && std::all_of(q + 1, q + 1 + level, [](char c) { return c == '='; })) {
+                    closed = true;
+                    break;
+                }
+                ++q;
+            }
+            if (isComment) {
+                record(segmentStart, segment, q, closed ? q + level + 2 : q, continuation, continuation || !closed);
+            }
+            if (q >= end_) {
+                return end_;
+            }
+            if (closed) {
+                return q + level + 2;
+            }
+
+            finishLine(q);
+            ++q;
+            if (!isComment) {
+                codeOnLine_ = true;
+            }
+            continuation = true;
+            segmentStart = q;
+            segment = q;
+        }
+    }
+
+    // A quote inside a number is a digit separator: the token it ends starts with a
+    // digit, which also covers hex digits after "0x". "u8'x'" or "L'x'" start a char literal.
+    bool continuesNumber(const char *p) const
+    {
+        const char *start = p;
+        while (start > lineStart_ && (isIdentifierChar(start[-1]) || start[-1] == '\'')) {
+            --start;
+        }
+        return start < p && *start >= '0' && *start <= '9';
+    }
+
+    const char *scanLiteral(const char *p)
+    {
+        const char quote = *p;
+
+        if (S.digitSeparators && quote == '\'' && continuesNumber(p)) {
+            return p + 1; // C++14 digit separator, e.g. 1'000'000 or 0xFF'FF
+        }
+        if (S.lifetimes && quote == '\'' && end_ - p >= 3 && isIdentifierChar(p[1]) && p[2] != '\'') {
+            return p + 1; // Rust lifetime or loop label, e.g. &'a str
+        }
+        if (S.rawStrings && quote == '"' && p > lineStart_ && p[-1] == 'R'
+            && (p - 1 == lineStart_ || !isIdentifierChar(p[-2]) || p[-2] == '8' || p[-2] == 'u' || p[-2] == 'U' || p[-2] == 'L')) {
+            return scanRawString(p);
+        }
+        if (S.tripleQuotedStrings && quote != '`' && end_ - p >= 3 && p[1] == quote && p[2] == quote) {
+            return scanMultiLineString(p + 3, quote, 3, true);
+        }
+        if (S.textBlocks && quote == '"' && end_ - p >= 3 && p[1] == '"' && p[2] == '"') {
+            return scanMultiLineString(p + 3, quote, 3, true);
+        }
+        if (quote == '`') {
+            return scanMultiLineString(p + 1, quote, 1, S.backtickEscapes);
+        }
+        if (S.multiLineStrings && quote == '"') {
+            return scanMultiLineString(p + 1, quote, 1, true);
+        }
+
+        // Ordinary string or char literal. An unterminated literal ends at the end of the
+        // line, so a stray quote cannot swallow the rest of the file.
+        static const ByteFinder doubleQuoted{'"', '\\', '\n'};
+        static const ByteFinder singleQuoted{'\'', '\\', '\n'};
+        const ByteFinder &literalBytes = quote == '"' ? doubleQuoted : singleQuoted;
+        const char *q = p + 1;
+        while ((q = literalBytes.find(q, end_)) < end_) {
+            const char c = *q;
+            if (c == quote) {
+                return q + 1;
+            }
+            if (c == '\n') {
+                return q;
+            }
+            if (c == '\\' && q + 1 < end_) {
+                if (q[1] == '\n') {
+                    finishLine(q + 1); // Escaped newline continues the literal
+                    codeOnLine_ = true;
+                } else if (q[1] == '\r' && q + 2 < end_ && q[2] == '\n') {
+                    finishLine(q + 2);
+                    codeOnLine_ = true;
+                    ++q;
+                }
+                q += 2;
+                continue;
+            }
+            ++q;
+        }
+        return end_;
+    }
+
+    // Consumes up to and including `count` consecutive closing quotes, honouring
+    // backslash escapes if the literal has them
+    const char *scanMultiLineString(const char *q, char quote, int count, bool escapes)
+    {
+        while (q < end_) {
+            const char c = *q;
+            if (escapes && c == '\\' && q + 1 < end_) {
+                if (q[1] == '\n') {
+                    finishLine(q + 1);
+                    codeOnLine_ = true;
+                }
+                q += 2;
+                continue;
+            }
+            if (c == '\n') {
+                finishLine(q);
+                codeOnLine_ = true;
+            } else if (c == quote && end_ - q >= count && (count == 1 || (q[1] == quote && q[2] == quote))) {
+                return q + count;
+            }
+            ++q;
+        }
+        return end_;
+    }
+
+    const char *scanRawString(const char *p)
+    {
+        // R"delim( ... )delim"
+        const char *delimiter = p + 1;
+        const char *open = delimiter;
+        while (open < end_ && *open != '(' && open - delimiter <= 16 && *open != '\n') {
+            ++open;
+        }
+        if (open >= end_ || *open != '(') {
+            return p + 1; // Not a well-formed raw string, treat the quote as code
+        }
+        const qsizetype delimiterLength = open - delimiter;
+
+        const char *q = open + 1;
+        while (q < end_) {
+            if (*q == '\n') {
+                finishLine(q);
+                codeOnLine_ = true;
+            } else if (*q == ')' && end_ - q > delimiterLength + 1
+                       && std::memcmp(q + 1, delimiter, size_t(delimiterLength)) == 0
+                       && q[1 + delimiterLength] == '"') {
+                return q + delimiterLength + 2;
+            }
+            ++q;
+        }
+        return end_;
+    }
+
+    // Rust: r"...", r#"..."# or br"..." starting at the 'r'
+    bool isRustRawStringStart(const char *p) const
+    {
+        const char *prefix = p > lineStart_ && p[-1] == 'b' ? p - 1 : p;
+        if (prefix > lineStart_ && isIdentifierChar(prefix[-1])) {
+            return false; // Part of an identifier, e.g. `for`
+        }
+        const char *q = p + 1;
+        while (q < end_ && *q == '#') {
+            ++q;
+        }
+        return q < end_ && *q == '"';
+    }
+
+    // Rust raw strings have no escapes and close with '"' and as many '#' as opened them
+    const char *scanRustRawString(const char *p)
+    {
+        const char *q = p + 1;
+        while (*q == '#') {
+            ++q;
+        }
+        const qsizetype hashes = q - p - 1;
+        ++q;
+        while (q < end_) {
+            if (*q == '\n') {
+                finishLine(q);
+                codeOnLine_ = true;
+            } else if (*q == '"' && end_ - q > hashes
+                       && std::all_of(q + 1, q + 1 + hashes, [](char c) { return c == '#'; })) {
+                return q + 1 + hashes;
+            }
+            ++q;
+        }
+        return end_;
+    }
+
+    // C# @"...": may span lines, "" is an escaped quote and backslashes are literal
+    const char *scanVerbatimString(const char *q)
+    {
+        while (q < end_) {
+            if (*q == '\n') {
+                finishLine(q);
+                codeOnLine_ = true;
+            } else if (*q == '"') {
+                if (q + 1 < end_ && q[1] == '"') {
+                    q += 2;
+                    continue;
+                }
+                return q + 1;
+            }
+            ++q;
+        }
+        return end_;
+    }
+
+    const char *const begin_;
+    const char *const end_;
+    QList<CommentSpan> &spans_;
+
+    const char *lineStart_ = nullptr;
+    int lineNumber_ = 1;
+    bool codeOnLine_ = false;
+    CommentSpan pending_;
+    bool hasPending_ = false;
+};
+
+template <const LanguageSyntax &S>
+void scanAs(const char *data, qsizetype size, QList<CommentSpan> &spans)
+{
+    Scanner<S>(data, size, spans).run();
+}
+
+} // namespace
+
+QList<CommentSpan> CommentLexer::scan(const char *data, qsizetype size) const
+{
+    QList<CommentSpan> spans;
+    // The only language branch: everything below runs the instance for this language
+    switch (language_) {
+    case Language::Cpp:        scanAs<CppSyntax>(data, size, spans); break;
+    case Language::Python:     scanAs<PythonSyntax>(data, size, spans); break;
+    case Language::TypeScript: scanAs<TypeScriptSyntax>(data, size, spans); break;
+    case Language::JavaScript: scanAs<JavaScriptSyntax>(data, size, spans); break;
+    case Language::Rust:       scanAs<RustSyntax>(data, size, spans); break;
+    case Language::Go:         scanAs<GoSyntax>(data, size, spans); break;
+    case Language::Java:       scanAs<JavaSyntax>(data, size, spans); break;
+    case Language::CSharp:     scanAs<CSharpSyntax>(data, size, spans); break;
+    case Language::Shell:      scanAs<ShellSyntax>(data, size, spans); break;
+    case Language::CMake:      scanAs<CMakeSyntax>(data, size, spans); break;
+    }
+    return spans;
+}
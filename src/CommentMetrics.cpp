@@ -0,0 +1,243 @@
+#include "CommentMetrics.h"
+#include "CommentExtractor.h"
+#include "Trace.h"
+#include <QByteArrayView>
+#include <QDir>
+#include <QFileInfo>
+#include <QMap>
+#include <QThread>
+#include <QThreadPool>
+#include <algorithm>
+
+namespace {
+
+inline bool isWordByte(char c)
+{
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+}
+
+// Occurrences of `word` as a whole word, as CommentIndex recognises tags
+int countWord(QByteArrayView text, QByteArrayView word)
+{
+    int count = 0;
+    for (qsizetype at = text.indexOf(word); at >= 0; at = text.indexOf(word, at + word.size())) {
+        const qsizetype end = at + word.size();
+        if ((at == 0 || !isWordByte(text[at - 1])) && (end == text.size() || !isWordByte(text[end]))) {
+            count++;
+        }
+    }
+    return count;
+}
+
+// The directory above `path`, or an empty string at a file system root
+QString parentOf(const QString &path)
+{
+    const qsizetype slash = path.lastIndexOf('/');
+    if (slash < 0 || slash == path.size() - 1) {
+        return QString(); // "/" or "C:/"
+    }
+    if (slash == 0) {
+        return QStringLiteral("/");
+    }
+    return path[slash - 1] == ':' ? path.left(slash + 1) : path.left(slash);
+}
+
+// Roots are 0; only the order matters, a subdirectory is always deeper than its parent
+int depthOf(const QString &directory)
+{
+    return int(directory.count('/')) - (directory.endsWith('/') ? 1 : 0);
+}
+
+} // namespace
+
+CommentMetrics CommentMetrics::forFile(const FileComments &file)
+{
+    CommentMetrics metrics;
+    metrics.files = 1;
+    metrics.lines = file.lineCount;
+
+    // Comments are in line order, so the gaps between them are the uncommented runs
+    auto uncommented = [&](int from, int to) {
+        if (to - from > metrics.longestUncommented) {
+            metrics.longestUncommented = to - from;
+            metrics.longestUncommentedStart = from;
+        }
+    };
+    const CommentArena &arena = file.comments;
+    const char *text = arena.text ? arena.text->data() : "";
+    int previous = 0;
+    for (int i = 0; i < arena.commentCount(); ++i) {
+        const int line = int(arena.lineNumbers[i]);
+        metrics.commentLines++;
+        if (arena.flags[i] & CommentArena::InlineFlag) {
+            metrics.inlineLines++;
+        } else {
+            metrics.blockLines++;
+        }
+        uncommented(previous + 1, line);
+        previous = line;
+
+        // Tags are counted in the arena's bytes; nothing is decoded
+        const QByteArrayView comment(text + arena.textStarts[i], arena.textEnds[i] - arena.textStarts[i]);
+        metrics.todoCount += countWord(comment, "TODO");
+        metrics.fixmeCount += countWord(comment, "FIXME");
+    }
+    uncommented(previous + 1, std::max(int(metrics.lines), previous) + 1);
+    if (metrics.longestUncommented > 0) {
+        metrics.longestUncommentedFile = file.filePath;
+    }
+    return metrics;
+}
+
+void CommentMetrics::add(const CommentMetrics &other)
+{
+    files += other.files;
+    lines += other.lines;
+    commentLines += other.commentLines;
+    inlineLines += other.inlineLines;
+    blockLines += other.blockLines;
+    todoCount += other.todoCount;
+    fixmeCount += other.fixmeCount;
+    // Ties go to the first path, so the result does not depend on the reduce order
+    if (other.longestUncommented > longestUncommented
+        || (other.longestUncommented == longestUncommented && other.longestUncommented > 0
+            && other.longestUncommentedFile < longestUncommentedFile)) {
+        longestUncommented = other.longestUncommented;
+        longestUncommentedStart = other.longestUncommentedStart;
+        longestUncommentedFile = other.longestUncommentedFile;
+    }
+}
+
+void CommentMetricsReport::clear()
+{
+    files_.clear();
+    directories_.clear();
+}
+
+void CommentMetricsReport::setFile(const QString &filePath, const CommentMetrics &metrics)
+{
+    files_.insert(link(filePath), metrics);
+}
+
+void CommentMetricsReport::updateFile(const QString &filePath, const CommentMetrics &metrics)
+{
+    const QString path = link(filePath);
+    files_.insert(path, metrics);
+    for (QString directory = parentOf(path); !directory.isEmpty(); directory = parentOf(directory)) {
+        reduce(directories_[directory]);
+    }
+}
+
+void CommentMetricsReport::rebuild()
+{
+    TraceSpan rollupSpan("metricsRollup");
+    // Pointers are taken once the hash is detached; workers only write their own entries
+    QMap<int, QList<Directory *>> levels;
+    for (auto it = directories_.begin(); it != directories_.end(); ++it) {
+        levels[depthOf(it.key())].append(&it.value());
+    }
+
+    QThreadPool pool;
+    pool.setMaxThreadCount(QThread::idealThreadCount());
+    for (auto level = levels.constEnd(); level != levels.constBegin();) {
+        --level;
+        const QList<Directory *> &directories = level.value();
+        const qsizetype chunk = std::max<qsizetype>(64, directories.size() / (pool.maxThreadCount() * 4));
+        for (qsizetype from = 0; from < directories.size(); from += chunk) {
+            const qsizetype to = std::min(directories.size(), from + chunk);
+            pool.start([this, &directories, from, to]() {
+                for (qsizetype i = from; i < to; ++i) {
+                    reduce(*directories[i]);
+                }
+            });
+        }
+        // The next level up reads these rollups
+        pool.waitForDone();
+    }
+}
+
+QString CommentMetricsReport::root() const
+{
+    QStringList tops = subdirectories(QString());
+    if (tops.size() != 1) {
+        return QString(); // No files, or files on several drives
+    }
+    QString directory = tops.first();
+    for (;;) {
+        const Directory &entry = directories_.constFind(directory).value();
+        if (!entry.files.isEmpty() || entry.subdirectories.size() != 1) {
+            return directory;
+        }
+        directory = *entry.subdirectories.constBegin();
+    }
+}
+
+QStringList CommentMetricsReport::subdirectories(const QString &directory) const
+{
+    QStringList result;
+    if (directory.isEmpty()) {
+        // The file system roots
+        for (auto it = directories_.constBegin(); it != directories_.constEnd(); ++it) {
+            if (parentOf(it.key()).isEmpty()) {
+                result.append(it.key());
+            }
+        }
+    } else {
+        auto it = directories_.constFind(directory);
+        if (it != directories_.constEnd()) {
+            result = it->subdirectories.values();
+        }
+    }
+    result.sort();
+    return result;
+}
+
+QStringList CommentMetricsReport::files(const QString &directory) const
+{
+    auto it = directories_.constFind(directory);
+    if (it == directories_.constEnd()) {
+        return QStringList();
+    }
+    QStringList result = it->files.values();
+    result.sort();
+    return result;
+}
+
+// Adds the file and its directories to the tree; returns the file's absolute path
+QString CommentMetricsReport::link(const QString &filePath)
+{
+    const QString path = QDir::cleanPath(QFileInfo(filePath).absoluteFilePath());
+    QString child = path;
+    bool isFile = true;
+    for (QString directory = parentOf(path); !directory.isEmpty(); directory = parentOf(directory)) {
+        auto it = directories_.find(directory);
+        const bool known = it != directories_.end();
+        if (!known) {
+            it = directories_.insert(directory, Directory());
+        }
+        if (isFile) {
+            it->files.insert(child);
+        } else {
+            it->subdirectories.insert(child);
+        }
+        if (known) {
+            break; // Its ancestors are linked already
+        }
+        child = directory;
+        isFile = false;
+    }
+    return path;
+}
+
+// A directory's rollup from its own files and its subdirectories' rollups
+void CommentMetricsReport::reduce(Directory &directory) const
+{
+    CommentMetrics total;
+    for (const QString &file : std::as_const(directory.files)) {
+        total.add(files_.value(file));
+    }
+    for (const QString &subdirectory : std::as_const(directory.subdirectories)) {
+        total.add(directories_.constFind(subdirectory)->total);
+    }
+    directory.total = total;
+}
@@ -0,0 +1,105 @@
+#include "CommentReplacer.h"
+#include "CommentArena.h"
+#include "CommentLexer.h"
+#include <QStringList>
+
+CommentReplacer::CommentReplacer(const QString &find, const QString &replacement, Syntax syntax, Qt::CaseSensitivity cs)
+    : find_(find), replacement_(replacement), syntax_(syntax), cs_(cs)
+{
+    QRegularExpression::PatternOptions options = QRegularExpression::UseUnicodePropertiesOption;
+    if (cs == Qt::CaseInsensitive) {
+        options |= QRegularExpression::CaseInsensitiveOption;
+    }
+    pattern_ = QRegularExpression(syntax == Syntax::Literal ? QRegularExpression::escape(find) : find, options);
+    pattern_.optimize();
+}
+
+int CommentReplacer::replaceInComment(QString &comment) const
+{
+    // One pass: unmatched text is copied, each match is replaced as it is found
+    QString result;
+    qsizetype copied = 0;
+    int count = 0;
+    QRegularExpressionMatchIterator it = pattern_.globalMatch(comment);
+    while (it.hasNext()) {
+        const QRegularExpressionMatch match = it.next();
+        if (match.capturedLength() == 0) {
+            continue; // A pattern that can match nothing would insert between every character
+        }
+        result += QStringView(comment).mid(copied, match.capturedStart() - copied);
+        result += expand(match);
+        copied = match.capturedEnd();
+        count++;
+    }
+    if (count > 0) {
+        result += QStringView(comment).mid(copied);
+        comment = result;
+    }
+    return count;
+}
+
+int CommentReplacer::replaceInLine(QString &line, bool isInline, Language language) const
+{
+    if (!isInline) {
+        return replaceInComment(line);
+    }
+
+    // Lex the line with the file's own syntax; it holds one comment, the one that is saved
+    const QByteArray utf8 = line.toUtf8();
+    const QList<CommentSpan> spans = CommentLexer(language).scan(utf8);
+    if (spans.isEmpty()) {
+        return 0;
+    }
+    const CommentSpan &span = spans.first();
+    QString comment = QString::fromUtf8(utf8.mid(span.textStart, span.textEnd - span.textStart));
+    const int count = replaceInComment(comment);
+    if (count > 0) {
+        line = QString::fromUtf8(utf8.first(span.textStart)) + comment + QString::fromUtf8(utf8.sliced(span.textEnd));
+    }
+    return count;
+}
+
+int CommentReplacer::replaceInGroup(QString &text, const CommentGroup &group, Language language) const
+{
+    if (text.isEmpty() || group.isReadOnly()) {
+        return 0; // Only the first comment of a line with several could be saved
+    }
+    // Lines added beyond the group's own are new comment lines without code
+    QStringList lines = text.split('\n');
+    int count = 0;
+    for (int i = 0; i < lines.size(); ++i) {
+        count += replaceInLine(lines[i], i < group.size() && group.showsFullLine(i), language);
+    }
+    if (count > 0) {
+        text = lines.join('\n');
+    }
+    return count;
+}
+
+QString CommentReplacer::expand(const QRegularExpressionMatch &match) const
+{
+    if (syntax_ == Syntax::Literal || !replacement_.contains('\\')) {
+        return replacement_;
+    }
+    // \1..\99 insert captures and \\ a backslash; other backslashes are kept
+    QString result;
+    for (qsizetype i = 0; i < replacement_.size(); ++i) {
+        const QChar c = replacement_[i];
+        if (c != '\\' || i + 1 >= replacement_.size()) {
+            result += c;
+        } else if (replacement_[i + 1].isDigit()) {
+            int group = replacement_[++i].digitValue();
+            if (i + 1 < replacement_.size() && replacement_[i + 1].isDigit()
+                && group * 10 + replacement_[i + 1].digitValue() <= pattern_.captureCount()) {
+                group = group * 10 + replacement_[++i].digitValue();
+            }
+            result += match.captured(group);
+        } else if (replacement_[i + 1] == '\\') {
+            result += c;
+            i++;
+        } else {
+            result += c;
+        }
+    }
+    return result;
+}
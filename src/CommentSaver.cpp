@@ -1,292 +1,795 @@
 #include "CommentSaver.h"
-#include <QFile>
-#include <QTextStream>
-#include <QRegularExpression>
-#include <QDebug>
+#include "CommentLexer.h"
+#include "ContentHash.h"
+#include "Logging.h"
+#include "SourceBuffer.h"
+#include "Trace.h"
+#include <QDir>
 #include <QFileInfo>
+#include <QSaveFile>
+#include <QSet>
+#include <QTemporaryFile>
+#include <QThread>
+#include <QThreadPool>
 #include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <filesystem>
+#include <numeric>
 
-CommentSaver::CommentSaver(QObject *parent) : QObject(parent)
+#if defined(Q_OS_UNIX)
+#include <fcntl.h>
+#include <unistd.h>
+#elif defined(Q_OS_WIN)
+#include <io.h>
+#include <qt_windows.h>
+#endif
+
+namespace {
+
+// Edits are sorted once by (line, order) and applied in a single pass over the
+// file, so a save costs O(file + edits). A replace or delete of a line comes
+// before the lines inserted after it.
+bool editBefore(const CommentEdit &a, const CommentEdit &b)
+{
+    if (a.line != b.line) {
+        return a.line < b.line;
+    }
+    const int aOrder = a.kind == CommentEdit::Kind::InsertAfter ? a.order + 1 : 0;
+    const int bOrder = b.kind == CommentEdit::Kind::InsertAfter ? b.order + 1 : 0;
+    return aOrder < bOrder;
+}
+
+// New comment lines of an insertion: every line of the text gets the marker, so none
+// of it can end up in the file as code
+QStringList markedLines(const QString &text, const QString &marker)
 {
+    QStringList lines = text.split('\n');
+    for (QString &line : lines) {
+        line = marker + " " + line;
+    }
+    return lines;
+}
+
+// A block comment's inner line cannot grow into several lines: line markers would
+// land inside the comment and its "*/" would move
+bool splitsBlockComment(const CommentSpan *span, const CommentEdit &edit)
+{
+    return edit.kind == CommentEdit::Kind::Replace && span && span->isBlockFragment && edit.text.contains('\n');
+}
 
+std::filesystem::path fsPath(const QString &path)
+{
+    return QFileInfo(path).filesystemFilePath();
 }
 
-bool CommentSaver::saveComments(const QString &filePath, const QList<QPair<int, QString>> &comments)
+// Forces a written file's data to disk
+bool syncFile(const QString &path)
 {
-    QFile originalFile(filePath);
-    if (!originalFile.open(QIODevice::ReadOnly | QIODevice::Text)) {
-        qWarning() << "Could not open original file for reading:" << filePath;
+    QFile file(path);
+    if (!file.open(QIODevice::ReadWrite)) {
         return false;
     }
+#if defined(Q_OS_UNIX)
+    return ::fsync(file.handle()) == 0;
+#elif defined(Q_OS_WIN)
+    return FlushFileBuffers(HANDLE(_get_osfhandle(file.handle())));
+#else
+    return file.flush();
+#endif
+}
 
-    QString tempFilePath = filePath + ".tmp";
-    QFile tempFile(tempFilePath);
-    if (!tempFile.open(QIODevice::WriteOnly | QIODevice::Text | QIODevice::Truncate)) {
-        qWarning() << "Could not open temporary file for writing:" << tempFilePath;
-        originalFile.close();
+// Makes renames within a directory durable; Windows has no equivalent, nor needs one
+bool syncDirectory(const QString &path)
+{
+#if defined(Q_OS_UNIX)
+    const int fd = ::open(QFile::encodeName(path).constData(), O_RDONLY);
+    if (fd < 0) {
         return false;
     }
+    const bool synced = ::fsync(fd) == 0;
+    ::close(fd);
+    return synced;
+#else
+    Q_UNUSED(path)
+    return true;
+#endif
+}
 
-    QTextStream in(&originalFile);
-    QTextStream out(&tempFile);
-
-    int lineNumber = 0;
-    while (!in.atEnd()) {
-        QString line = in.readLine();
-        lineNumber++;
-
-        // Check if this line number has a modified comment
-        for (const auto &commentPair : comments) {
-            if (commentPair.first == lineNumber) {
-                // Regex for C++ style single-line comments (//)
-                // Captures the comment marker and leading whitespace in group 1, and the comment content in group 2
-                QRegularExpression cppSingleLineCommentRegex("^(\\s*//\\s*)(.*)$", QRegularExpression::MultilineOption);
-                if (cppSingleLineCommentRegex.match(line).hasMatch()) {
-                    line.replace(cppSingleLineCommentRegex, "\\1" + commentPair.second);
-                }
-                // Regex for Python style single-line comments (#)
-                // Captures the comment marker and leading whitespace in group 1, and the comment content in group 2
-                else {
-                    QRegularExpression pythonSingleLineCommentRegex("^(\\s*#\\s*)(.*)$", QRegularExpression::MultilineOption);
-                    if (pythonSingleLineCommentRegex.match(line).hasMatch()) {
-                        line.replace(pythonSingleLineCommentRegex, "\\1" + commentPair.second);
-                    }
-                }
-                // Note: Multi-line comments (/* */) are not handled for editing in this version.
-                break; // Assumption: one relevant comment per line for replacement
-            }
+// True if the line holds nothing but a comment that opens and closes on it
+bool isCommentOnly(QByteArrayView line, const CommentSpan &span)
+{
+    if (span.isInline || span.isBlockFragment) {
+        return false;
+    }
+    for (qsizetype i = span.commentEnd - span.lineStart; i < line.size(); ++i) {
+        if (line[i] != ' ' && line[i] != '\t') {
+            return false; // Code follows, e.g. "/* x */ int a;"
         }
-        out << line << "\n";
     }
+    return true;
+}
 
-    originalFile.close();
-    tempFile.close();
+// Finds line boundaries on demand, only as far into the file as the highest line asked for
+class LineIndex
+{
+public:
+    LineIndex(const char *data, qsizetype size, qsizetype bodyStart) : data_(data), size_(size) { starts_.append(bodyStart); }
 
-    // Replace the original file with the temporary file
-    if (originalFile.remove()) {
-        if (tempFile.rename(filePath)) {
-            qDebug() << "Comments saved successfully to:" << filePath;
-            return true;
-        } else {
-            qWarning() << "Could not rename temporary file to original:" << tempFilePath;
+    // Line `number` (1-based) without its terminator; false past the end of the file
+    bool line(int number, QByteArrayView &text)
+    {
+        while (starts_.size() <= number && starts_.last() < size_) {
+            const qsizetype pos = starts_.last();
+            const char *newline = static_cast<const char *>(std::memchr(data_ + pos, '\n', size_t(size_ - pos)));
+            starts_.append(newline ? newline - data_ + 1 : size_);
+        }
+        if (number < 1 || starts_.size() <= number) {
             return false;
         }
-    } else {
-        qWarning() << "Could not remove original file:" << filePath;
+        const qsizetype start = starts_[number - 1];
+        qsizetype end = starts_[number];
+        if (end > start && data_[end - 1] == '\n') {
+            end--;
+        }
+        if (end > start && data_[end - 1] == '\r') {
+            end--;
+        }
+        text = QByteArrayView(data_ + start, end - start);
+        return true;
+    }
+
+    int lineCount()
+    {
+        QByteArrayView text;
+        while (starts_.last() < size_) {
+            line(int(starts_.size()), text);
+        }
+        return int(starts_.size()) - 1;
+    }
+
+private:
+    const char *data_;
+    qsizetype size_;
+    QList<qsizetype> starts_; // starts_[n] is where line n + 1 starts
+};
+
+// Original lines [oldLine, oldLine + oldCount) replaced by `newLines`
+struct LineChange {
+    int oldLine = 0;
+    int oldCount = 0;
+    QStringList newLines;
+    QList<int> edits;
+};
+
+} // namespace
+
+bool CommentSaver::applyEdits(const QString &filePath, const QList<CommentEdit> &edits, quint64 expectedHash)
+{
+    TraceSpan saveSpan("saveFile", filePath);
+    errorString_.clear();
+
+    // Written to a temporary file and renamed over the original on commit()
+    QSaveFile out(filePath);
+    if (!out.open(QIODevice::WriteOnly)) {
+        errorString_ = out.errorString();
+        qCWarning(lcSave) << "Could not open file for writing:" << filePath << errorString_;
+        return false;
+    }
+    if (!writeEdited(filePath, edits, expectedHash, out)) {
+        out.cancelWriting();
         return false;
     }
+    if (!out.commit()) {
+        errorString_ = out.errorString();
+        qCWarning(lcSave) << "Could not write file:" << filePath << errorString_;
+        return false;
+    }
+    return true;
 }
 
-bool CommentSaver::saveCommentsWithMultiLine(const QString &filePath, const QList<QPair<int, QString>> &comments)
+// False if the file is no longer the one the edits were made against
+bool CommentSaver::checkUnchanged(const QString &filePath, const SourceBuffer &source, quint64 expectedHash)
 {
-    QFile originalFile(filePath);
-    if (!originalFile.open(QIODevice::ReadOnly | QIODevice::Text)) {
-        qWarning() << "Could not open original file for reading:" << filePath;
+    if (expectedHash == 0 || contentHash(source.data(), source.size()) == expectedHash) {
+        return true;
+    }
+    errorString_ = "The file changed on disk since its comments were loaded; reload it and edit again";
+    qCWarning(lcSave) << "Not saving" << filePath << "- it changed on disk since it was extracted";
+    return false;
+}
+
+// Streams the edited file to `out`; the original is only read
+bool CommentSaver::writeEdited(const QString &filePath, const QList<CommentEdit> &edits, quint64 expectedHash,
+                               QIODevice &out)
+{
+    // Map the file rather than reading it, so memory use does not grow with file size;
+    // the lexer locates existing comment text so replacements never touch code or literals
+    QSharedPointer<const SourceBuffer> source = SourceBuffer::open(filePath, SourceBuffer::ReadMode::Map);
+    if (!source) {
+        errorString_ = "Could not open the file for reading";
+        qCWarning(lcSave) << "Could not open original file for reading:" << filePath;
         return false;
     }
+    // Checked on the very bytes that are about to be rewritten
+    if (!checkUnchanged(filePath, *source, expectedHash)) {
+        return false;
+    }
+    const char *data = source->data();
+    const qsizetype size = source->size();
+    const Language language = LanguageRegistry::forFile(filePath);
+    const QList<CommentSpan> spans = CommentLexer(language).scan(data, size);
+
+    // Sort once; equal keys keep their order so the last replace or delete of a line wins
+    QList<CommentEdit> sorted = edits;
+    std::stable_sort(sorted.begin(), sorted.end(), editBefore);
+
+    // New lines use the file's own line ending; a missing final newline stays missing
+    const char *firstNewline = static_cast<const char *>(std::memchr(data, '\n', size_t(size)));
+    const QByteArray defaultEol = firstNewline && firstNewline > data && firstNewline[-1] == '\r' ? "\r\n" : "\n";
+    const qsizetype bodyStart = size >= 3 && std::memcmp(data, "\xEF\xBB\xBF", 3) == 0 ? 3 : 0;
+    const bool endsOpen = size > bodyStart && data[size - 1] != '\n';
+
+    const QString commentMarker = QString::fromLatin1(LanguageRegistry::syntax(language).lineMarker);
+    auto nextEdit = sorted.constBegin();
+    auto nextSpan = spans.constBegin();
+
+    // Unchanged bytes are copied straight from the source in as few writes as possible
+    qsizetype copyFrom = 0;
+    auto copyUpTo = [&](qsizetype to) {
+        if (to > copyFrom) {
+            out.write(data + copyFrom, to - copyFrom);
+            copyFrom = to;
+        }
+    };
+    // Writes the lines inserted after `line`, whose terminator is `eol` ("" if it has none)
+    auto insertAfter = [&](int line, QByteArrayView eol) {
+        for (; nextEdit != sorted.constEnd() && nextEdit->line == line; ++nextEdit) {
+            if (nextEdit->kind != CommentEdit::Kind::InsertAfter) {
+                qCWarning(lcSave) << "Skipping edit of line" << line << "in" << filePath << "(no such line)";
+                continue;
+            }
+            for (const QString &text : markedLines(nextEdit->text, commentMarker)) {
+                if (eol.isEmpty()) {
+                    out.write(defaultEol);
+                    out.write(text.toUtf8());
+                } else {
+                    out.write(text.toUtf8());
+                    out.write(eol.data(), eol.size());
+                }
+            }
+        }
+    };
+
+    copyUpTo(bodyStart);
+    insertAfter(0, defaultEol);
+
+    int lineNumber = 0;
+    qsizetype pos = bodyStart;
+    while (pos < size) {
+        const char *newline = static_cast<const char *>(std::memchr(data + pos, '\n', size_t(size - pos)));
+        const qsizetype next = newline ? newline - data + 1 : size;
+        qsizetype lineEnd = newline ? newline - data : size;
+        if (lineEnd > pos && data[lineEnd - 1] == '\r') {
+            lineEnd--;
+        }
+        lineNumber++;
+
+        while (nextSpan != spans.constEnd() && nextSpan->lineNumber < lineNumber) {
+            ++nextSpan;
+        }
+        const CommentSpan *span = nextSpan != spans.constEnd() && nextSpan->lineNumber == lineNumber ? &*nextSpan : nullptr;
+
+        const CommentEdit *lineEdit = nullptr;
+        for (; nextEdit != sorted.constEnd() && nextEdit->line == lineNumber
+               && nextEdit->kind != CommentEdit::Kind::InsertAfter; ++nextEdit) {
+            lineEdit = &*nextEdit;
+        }
 
-    // Read all lines into memory
-    QStringList allLines;
-    QTextStream in(&originalFile);
-    while (!in.atEnd()) {
-        allLines.append(in.readLine());
+        const QByteArrayView line(data + pos, lineEnd - pos);
+        const QByteArrayView eol(data + lineEnd, next - lineEnd);
+        if (lineEdit && splitsBlockComment(span, *lineEdit)) {
+            errorString_ = QString("Line %1 is inside a block comment and cannot be replaced by several lines")
+                           .arg(lineNumber);
+            qCWarning(lcSave) << "Not saving" << filePath << "-" << errorString_;
+            return false;
+        }
+        if (lineEdit && lineEdit->kind == CommentEdit::Kind::Delete && !span) {
+            qCWarning(lcSave) << "Not deleting line" << lineNumber << "of" << filePath << "- it holds no comment";
+        } else if (lineEdit) {
+            // Only the edited line is decoded and rewritten; its terminator is copied as is
+            copyUpTo(pos);
+            QByteArray edited;
+            if (editLine(line, span, *lineEdit, commentMarker, eol.isEmpty() ? QByteArrayView(defaultEol) : eol, edited)) {
+                out.write(edited);
+                copyFrom = lineEnd;
+            } else {
+                copyFrom = next;
+            }
+        }
+        if (nextEdit != sorted.constEnd() && nextEdit->line == lineNumber) {
+            copyUpTo(next);
+            insertAfter(lineNumber, eol);
+        }
+        pos = next;
     }
-    originalFile.close();
+    copyUpTo(size);
 
-    QString commentMarker = getCommentMarker(filePath);
-    
-    // Process insertions and replacements separately
-    // First do all replacements, then do all insertions in the correct order
-    QList<QPair<int, QString>> replacements;
-    QList<QPair<int, QString>> insertions;
-    
-    for (const auto &comment : comments) {
-        if (comment.first < 0) {
-            insertions.append(comment);
+    // Replacements past the end pad the file with empty lines; other edits there have no anchor
+    const QByteArrayView tailEol = endsOpen ? QByteArrayView() : QByteArrayView(defaultEol);
+    while (nextEdit != sorted.constEnd()) {
+        if (nextEdit->kind == CommentEdit::Kind::Replace) {
+            while (++lineNumber < nextEdit->line) {
+                out.write(defaultEol);
+            }
+            for (const QString &text : markedLines(nextEdit->text, commentMarker)) {
+                if (endsOpen) {
+                    out.write(defaultEol);
+                    out.write(text.toUtf8());
+                } else {
+                    out.write(text.toUtf8());
+                    out.write(defaultEol);
+                }
+            }
+            ++nextEdit;
+            insertAfter(lineNumber, tailEol);
         } else {
-            replacements.append(comment);
+            qCWarning(lcSave) << "Skipping edit of line" << nextEdit->line << "past the end of" << filePath;
+            ++nextEdit;
         }
     }
-    
-    // Sort replacements by line number (any order is fine for replacements)
-    std::sort(replacements.begin(), replacements.end(), 
-              [](const QPair<int, QString> &a, const QPair<int, QString> &b) {
-                  return a.first < b.first;
-              });
-              
-    // Sort insertions by decoded line number and offset (process sequentially)
-    std::sort(insertions.begin(), insertions.end(), 
-              [](const QPair<int, QString> &a, const QPair<int, QString> &b) {
-                  int aEncoded = -a.first;
-                  int bEncoded = -b.first;
-                  int aBaseLine = aEncoded / 1000;
-                  int bBaseLine = bEncoded / 1000;
-                  int aOffset = (aEncoded % 1000) - 1;
-                  int bOffset = (bEncoded % 1000) - 1;
-                  
-                  if (aBaseLine != bBaseLine) {
-                      return aBaseLine < bBaseLine; // Process earlier base lines first
-                  }
-                  return aOffset < bOffset; // Process lower offsets first
-              });
-    
-    QList<QPair<int, QString>> sortedComments = replacements + insertions;
 
-    // Track how many lines have been inserted so far
-    int totalInsertedLines = 0;
-    
-    for (const auto &commentPair : sortedComments) {
-        int lineNumber = commentPair.first;
-        QString newComment = commentPair.second;
-        
-        qDebug() << "Processing comment for line" << lineNumber << ":" << newComment;
-        
-        // Handle special line number signals for insertions
-        if (lineNumber < 0) {
-            // Format: -(baseLine * 1000 + offset + 1)
-            int encoded = -lineNumber;
-            int baseLine = encoded / 1000; // Extract base line (1-based line number from original file)
-            int offset = (encoded % 1000) - 1; // Extract offset (0, 1, 2, ...)
-            
-            // Account for previous insertions that happened before this base line
-            int insertionsBefore = 0;
-            for (const auto &prevComment : insertions) {
-                if (prevComment.first == commentPair.first) break; // Don't count self and later insertions
-                int prevEncoded = -prevComment.first;
-                int prevBaseLine = prevEncoded / 1000;
-                if (prevBaseLine < baseLine) {
-                    insertionsBefore++;
+    // The mapping is released on return, before the original is replaced (required on Windows)
+    return true;
+}
+
+// Mirrors writeEdited() line by line, but only for the lines with edits: each anchor
+// becomes a LineChange, and nearby changes share a hunk. Lines are never compared and
+// nothing is written, but the file is still hashed and lexed in full, so a preview
+// costs one O(file) pass per file, like a save without its writes.
+bool CommentSaver::preview(const QString &filePath, const QList<CommentEdit> &edits, FilePreview &preview,
+                           quint64 expectedHash)
+{
+    TraceSpan previewSpan("previewFile", filePath);
+    errorString_.clear();
+    preview.filePath = filePath;
+    preview.hunks.clear();
+    preview.error.clear();
+
+    QSharedPointer<const SourceBuffer> source = SourceBuffer::open(filePath, SourceBuffer::ReadMode::Map);
+    if (!source) {
+        errorString_ = preview.error = "Could not open the file for reading";
+        qCWarning(lcSave) << "Could not open file for preview:" << filePath;
+        return false;
+    }
+    if (!checkUnchanged(filePath, *source, expectedHash)) {
+        preview.error = errorString_;
+        return false;
+    }
+    const char *data = source->data();
+    const qsizetype size = source->size();
+    const Language language = LanguageRegistry::forFile(filePath);
+    const QList<CommentSpan> spans = CommentLexer(language).scan(data, size);
+    const QString commentMarker = QString::fromLatin1(LanguageRegistry::syntax(language).lineMarker);
+    const qsizetype bodyStart = size >= 3 && std::memcmp(data, "\xEF\xBB\xBF", 3) == 0 ? 3 : 0;
+    LineIndex lines(data, size, bodyStart);
+
+    // Sorted as writeEdited() sorts them, keeping each edit's index in `edits`
+    QList<int> sorted(edits.size());
+    std::iota(sorted.begin(), sorted.end(), 0);
+    std::stable_sort(sorted.begin(), sorted.end(), [&](int a, int b) { return editBefore(edits[a], edits[b]); });
+
+    QList<LineChange> changes;
+    int lineCount = -1; // Counted only once an edit lies past the last line
+    LineChange tail;    // Replacements past the end pad the file with empty lines
+    int tailLine = 0;   // Last line of the file once padded
+    for (qsizetype i = 0; i < sorted.size();) {
+        const int anchor = edits[sorted[i]].line;
+        qsizetype end = i;
+        while (end < sorted.size() && edits[sorted[end]].line == anchor) {
+            end++;
+        }
+
+        QByteArrayView original;
+        if (anchor > 0 && !lines.line(anchor, original)) {
+            if (lineCount < 0) {
+                lineCount = lines.lineCount();
+                tail.oldLine = lineCount + 1;
+                tailLine = lineCount;
+            }
+            // The first replacement of a line adds it; only insertions may follow it
+            bool replaced = false;
+            for (qsizetype k = i; k < end; ++k) {
+                const CommentEdit &edit = edits[sorted[k]];
+                if (edit.kind == CommentEdit::Kind::Replace && !replaced) {
+                    while (++tailLine < edit.line) {
+                        tail.newLines.append(QString());
+                    }
+                    replaced = true;
+                } else if (edit.kind != CommentEdit::Kind::InsertAfter || !replaced) {
+                    continue; // No anchor; writeEdited() skips it as well
                 }
+                tail.newLines.append(markedLines(edit.text, commentMarker));
+                tail.edits.append(sorted[k]);
             }
-            
-            // Calculate insertion index: baseLine + offset + adjustments for previous insertions
-            int insertIndex = baseLine + offset + insertionsBefore;
-            
-            qDebug() << "Insert after original line" << baseLine << "with offset" << offset << "and" << insertionsBefore << "previous insertions -> final index" << insertIndex;
-            
-            QString commentMarkerLine = commentMarker + " " + newComment;
-            if (insertIndex >= 0 && insertIndex <= allLines.size()) {
-                allLines.insert(insertIndex, commentMarkerLine);
-                totalInsertedLines++;
-                qDebug() << "Inserted new line:" << commentMarkerLine << "at index" << insertIndex;
+            i = end;
+            continue;
+        }
+
+        LineChange change;
+        change.oldLine = anchor + 1;
+        qsizetype k = i;
+        const CommentEdit *lineEdit = nullptr;
+        for (; k < end && edits[sorted[k]].kind != CommentEdit::Kind::InsertAfter; ++k) {
+            lineEdit = &edits[sorted[k]];
+            change.edits.append(sorted[k]);
+        }
+        if (lineEdit && anchor > 0) {
+            auto span = std::lower_bound(spans.constBegin(), spans.constEnd(), anchor,
+                                         [](const CommentSpan &s, int line) { return s.lineNumber < line; });
+            const CommentSpan *lineSpan = span != spans.constEnd() && span->lineNumber == anchor ? &*span : nullptr;
+            if (splitsBlockComment(lineSpan, *lineEdit)) {
+                errorString_ = preview.error = QString("Line %1 is inside a block comment and cannot be replaced by several lines")
+                                               .arg(anchor);
+                return false;
             }
-            continue; // Skip normal processing
-        }
-        
-        int lineIndex = lineNumber - 1; // Convert to 0-based index
-        qDebug() << "File has" << allLines.size() << "lines, trying to access line index" << lineIndex;
-        
-        if (lineIndex >= 0 && lineIndex < allLines.size()) {
-            QString originalLine = allLines[lineIndex];
-            QString indentation = getIndentation(originalLine);
-            
-            // Check if the comment spans multiple lines
-            QStringList commentLines = newComment.split('\n');
-            
-            if (commentLines.size() == 1) {
-                // Single line comment - update existing line
-                QRegularExpression cppRegex("^(\\s*//\\s*)(.*)$");
-                QRegularExpression pythonRegex("^(\\s*#\\s*)(.*)$");
-                QRegularExpression inlineRegex("^(.+)(//|#)(.*)$");
-                
-                if (cppRegex.match(originalLine).hasMatch()) {
-                    allLines[lineIndex] = originalLine.replace(cppRegex, "\\1" + newComment);
-                    qDebug() << "Replaced C++ comment:" << allLines[lineIndex];
-                } else if (pythonRegex.match(originalLine).hasMatch()) {
-                    allLines[lineIndex] = originalLine.replace(pythonRegex, "\\1" + newComment);
-                    qDebug() << "Replaced Python comment:" << allLines[lineIndex];
-                } else if (inlineRegex.match(originalLine).hasMatch()) {
-                    // Handle inline comments
-                    QRegularExpressionMatch match = inlineRegex.match(originalLine);
-                    QString codePart = match.captured(1);
-                    QString marker = match.captured(2);
-                    allLines[lineIndex] = codePart + marker + " " + newComment;
-                    qDebug() << "Replaced inline comment:" << allLines[lineIndex];
-                } else {
-                    // Line exists but has no comment - insert new comment
-                    QString newCommentLine = indentation + commentMarker + " " + newComment;
-                    allLines[lineIndex] = newCommentLine;
-                    qDebug() << "Inserted new comment on existing line:" << newCommentLine;
+            QByteArray edited;
+            const bool kept = editLine(original, lineSpan, *lineEdit, commentMarker, "\n", edited);
+            if (!kept || QByteArrayView(edited) != original) {
+                change.oldLine = anchor;
+                change.oldCount = 1;
+                if (kept) {
+                    change.newLines = QString::fromUtf8(edited).split('\n');
                 }
             } else {
-                // Multi-line comment - replace original and insert new lines
-                QStringList expandedLines = expandMultiLineComment(newComment, commentMarker, indentation);
-                
-                // Replace the original line with the first comment line
-                allLines[lineIndex] = expandedLines.first();
-                
-                // Insert additional lines after the original
-                for (int i = 1; i < expandedLines.size(); ++i) {
-                    allLines.insert(lineIndex + i, expandedLines[i]);
-                }
+                change.edits.clear(); // Nothing would change on this line
             }
         } else {
-            // This is a new line to be inserted - push everything down
-            qDebug() << "Inserting completely new line at position" << commentPair.first;
-            
-            QString commentMarkerLine = commentMarker + " " + newComment;
-            
-            // Insert at the correct position, pushing existing lines down
-            if (lineIndex <= allLines.size()) {
-                allLines.insert(lineIndex, commentMarkerLine);
+            change.edits.clear();
+        }
+        for (; k < end; ++k) {
+            change.newLines.append(markedLines(edits[sorted[k]].text, commentMarker));
+            change.edits.append(sorted[k]);
+        }
+        if (!change.edits.isEmpty()) {
+            changes.append(change);
+        }
+        i = end;
+    }
+    if (!tail.edits.isEmpty()) {
+        changes.append(tail);
+    }
+
+    // Changes with at most two contexts' worth of unchanged lines between them share a hunk
+    const int context = FilePreview::ContextLines;
+    int next = 1; // Next original line to show
+    auto addContext = [&](DiffHunk &hunk, int to) {
+        QByteArrayView text;
+        for (; next < to && lines.line(next, text); ++next) {
+            hunk.lines.append(" " + QString::fromUtf8(text));
+            hunk.oldCount++;
+            hunk.newCount++;
+        }
+    };
+    for (const LineChange &change : std::as_const(changes)) {
+        if (preview.hunks.isEmpty() || change.oldLine - next > 2 * context) {
+            if (!preview.hunks.isEmpty()) {
+                addContext(preview.hunks.last(), next + context);
+            }
+            DiffHunk hunk;
+            hunk.oldStart = std::max(1, change.oldLine - context);
+            next = hunk.oldStart;
+            preview.hunks.append(hunk);
+        }
+        DiffHunk &hunk = preview.hunks.last();
+        addContext(hunk, change.oldLine);
+        QByteArrayView text;
+        for (int line = change.oldLine; line < change.oldLine + change.oldCount && lines.line(line, text); ++line) {
+            hunk.lines.append("-" + QString::fromUtf8(text));
+            hunk.oldCount++;
+        }
+        for (const QString &line : change.newLines) {
+            hunk.lines.append("+" + line);
+            hunk.newCount++;
+        }
+        hunk.edits.append(change.edits);
+        next = change.oldLine + change.oldCount;
+    }
+    if (!preview.hunks.isEmpty()) {
+        addContext(preview.hunks.last(), next + context);
+    }
+    return true;
+}
+
+QList<FilePreview> CommentSaver::previewAll(const QList<FileSaveJob> &jobs)
+{
+    TraceSpan previewSpan("preview");
+    QList<FilePreview> previews(jobs.size());
+    FilePreview *preview = previews.data();
+    QThreadPool pool;
+    pool.setMaxThreadCount(QThread::idealThreadCount());
+    for (qsizetype i = 0; i < jobs.size(); ++i) {
+        pool.start([&, i]() {
+            CommentSaver saver;
+            saver.preview(jobs[i].filePath, jobs[i].edits, preview[i], jobs[i].contentHash);
+        });
+    }
+    pool.waitForDone();
+    return previews;
+}
+
+QString FilePreview::unifiedDiff() const
+{
+    QString diff;
+    int offset = 0; // Lines added minus lines removed by the accepted hunks so far
+    for (const DiffHunk &hunk : hunks) {
+        if (!hunk.accepted) {
+            continue;
+        }
+        if (diff.isEmpty()) {
+            diff = QString("--- %1\n+++ %1\n").arg(filePath);
+        }
+        // An empty side is numbered by the line before it, as diff does
+        const int oldStart = hunk.oldCount > 0 ? hunk.oldStart : hunk.oldStart - 1;
+        const int newStart = hunk.newCount > 0 ? hunk.oldStart + offset : hunk.oldStart + offset - 1;
+        diff += QString("@@ -%1,%2 +%3,%4 @@\n").arg(oldStart).arg(hunk.oldCount).arg(newStart).arg(hunk.newCount);
+        diff += hunk.lines.join('\n') + '\n';
+        offset += hunk.newCount - hunk.oldCount;
+    }
+    return diff;
+}
+
+QList<CommentEdit> FilePreview::acceptedEdits(const QList<CommentEdit> &edits) const
+{
+    QList<int> indices;
+    for (const DiffHunk &hunk : hunks) {
+        if (hunk.accepted) {
+            indices.append(hunk.edits);
+        }
+    }
+    // In their original order, so edits of one line keep their last-wins order
+    std::sort(indices.begin(), indices.end());
+    QList<CommentEdit> accepted;
+    accepted.reserve(indices.size());
+    for (int index : std::as_const(indices)) {
+        accepted.append(edits[index]);
+    }
+    return accepted;
+}
+
+// Writes the edited file to a new temporary file beside the original, keeping its permissions
+bool CommentSaver::stage(const QString &filePath, const QList<CommentEdit> &edits, quint64 expectedHash,
+                         QString &tempPath)
+{
+    TraceSpan saveSpan("saveFile", filePath);
+    errorString_.clear();
+    const QFileInfo info(filePath);
+    QTemporaryFile out(info.dir().filePath("." + info.fileName() + ".XXXXXX.ccp-save"));
+    out.setAutoRemove(false);
+    if (!out.open()) {
+        errorString_ = out.errorString();
+        qCWarning(lcSave) << "Could not create a temporary file for:" << filePath << errorString_;
+        return false;
+    }
+    out.setPermissions(info.permissions());
+    const bool written = writeEdited(filePath, edits, expectedHash, out);
+    if (!written || !out.flush() || out.error() != QFileDevice::NoError) {
+        if (errorString_.isEmpty()) {
+            errorString_ = out.errorString();
+            qCWarning(lcSave) << "Could not write file:" << filePath << errorString_;
+        }
+        out.remove();
+        return false;
+    }
+    tempPath = out.fileName();
+    return true;
+}
+
+bool CommentSaver::saveAll(QList<FileSaveJob> &jobs, const SaveProgress &progress)
+{
+    TraceSpan saveSpan("save");
+    // Each file is reported once when its new content is written and once when it is committed
+    const int total = int(jobs.size()) * 2;
+    std::atomic<int> completed{0};
+    auto report = [&](const QString &filePath) {
+        const int done = ++completed;
+        if (progress) {
+            progress(done, total, filePath);
+        }
+    };
+
+    // Detached once here; each task then only touches its own entries
+    FileSaveJob *job = jobs.data();
+    QStringList tempPaths(jobs.size());
+    QString *tempPath = tempPaths.data();
+    std::atomic<bool> failed{false};
+
+    // 1. Write every new file next to its original; no original is touched yet
+    QThreadPool pool;
+    pool.setMaxThreadCount(QThread::idealThreadCount());
+    for (qsizetype i = 0; i < jobs.size(); ++i) {
+        pool.start([&, i]() {
+            if (failed) {
+                return; // The batch is rolled back anyway
+            }
+            CommentSaver saver;
+            if (saver.stage(job[i].filePath, job[i].edits, job[i].contentHash, tempPath[i])) {
+                report(job[i].filePath);
             } else {
-                // Beyond file size - add empty lines first, then the comment
-                while (allLines.size() < lineIndex) {
-                    allLines.append("");
+                job[i].error = saver.errorString();
+                failed = true;
+            }
+        });
+    }
+    pool.waitForDone();
+
+    // 2. Flush them all to disk together, so no rename can expose a file that is not durable
+    if (!failed) {
+        for (qsizetype i = 0; i < jobs.size(); ++i) {
+            pool.start([&, i]() {
+                if (!syncFile(tempPath[i])) {
+                    job[i].error = "Could not flush the new file to disk";
+                    qCWarning(lcSave) << "Could not sync temporary file:" << tempPath[i];
+                    failed = true;
                 }
-                allLines.append(commentMarkerLine);
+            });
+        }
+        pool.waitForDone();
+    }
+
+    // 3. Replace the originals by atomic renames, each one backed by a hard link to
+    // its old content until the whole batch is in place. Each original is checked
+    // once more first: a preview may have been open for a long time since staging.
+    QStringList backupPaths(jobs.size());
+    qsizetype committed = 0;
+    for (; !failed && committed < jobs.size(); ++committed) {
+        const QString &filePath = job[committed].filePath;
+        if (job[committed].contentHash != 0) {
+            CommentSaver saver;
+            QSharedPointer<const SourceBuffer> original = SourceBuffer::open(filePath, SourceBuffer::ReadMode::Map);
+            if (!original || !saver.checkUnchanged(filePath, *original, job[committed].contentHash)) {
+                job[committed].error = original ? saver.errorString() : QString("Could not open the file for reading");
+                failed = true;
+                break;
             }
-            
-            qDebug() << "Inserted new line:" << commentMarkerLine << "at index" << lineIndex;
         }
+        const QString backupPath = tempPath[committed] + ".orig";
+        std::error_code error;
+        std::filesystem::create_hard_link(fsPath(filePath), fsPath(backupPath), error);
+        if (error) {
+            error.clear(); // No hard links on this file system
+            std::filesystem::copy_file(fsPath(filePath), fsPath(backupPath), error);
+        }
+        if (!error) {
+            backupPaths[committed] = backupPath;
+            std::filesystem::rename(fsPath(tempPath[committed]), fsPath(filePath), error);
+        }
+        if (error) {
+            job[committed].error = QString::fromStdString(error.message());
+            qCWarning(lcSave) << "Could not replace file:" << filePath << job[committed].error;
+            failed = true;
+            break;
+        }
+        report(filePath);
     }
 
-    // Write the modified content back to file
-    QString tempFilePath = filePath + ".tmp";
-    QFile tempFile(tempFilePath);
-    if (!tempFile.open(QIODevice::WriteOnly | QIODevice::Text | QIODevice::Truncate)) {
-        qWarning() << "Could not open temporary file for writing:" << tempFilePath;
+    if (failed) {
+        // Put back the originals already replaced, newest first, and drop every new file
+        for (qsizetype i = committed - 1; i >= 0; --i) {
+            std::error_code error;
+            std::filesystem::rename(fsPath(backupPaths[i]), fsPath(job[i].filePath), error);
+            if (error) {
+                qCWarning(lcSave) << "Could not restore" << job[i].filePath << "- its original is kept at" << backupPaths[i];
+                job[i].error = QString("Could not be restored; the original is kept at %1").arg(backupPaths[i]);
+                backupPaths[i].clear();
+            }
+        }
+        for (qsizetype i = 0; i < jobs.size(); ++i) {
+            if (i >= committed && !tempPath[i].isEmpty()) {
+                QFile::remove(tempPath[i]);
+            }
+            if (!backupPaths[i].isEmpty()) {
+                QFile::remove(backupPaths[i]);
+            }
+            job[i].saved = false;
+            if (job[i].error.isEmpty()) {
+                job[i].error = "Not saved: another file in the batch failed, so no file was changed";
+            }
+        }
         return false;
     }
 
-    QTextStream out(&tempFile);
-    for (int i = 0; i < allLines.size(); ++i) {
-        out << allLines[i];
-        if (i < allLines.size() - 1) {
-            out << "\n";
+    // 4. Make the renames durable, then drop the backups
+    QSet<QString> directories;
+    for (qsizetype i = 0; i < jobs.size(); ++i) {
+        directories.insert(QFileInfo(job[i].filePath).absolutePath());
+        QFile::remove(backupPaths[i]);
+        job[i].saved = true;
+        job[i].error.clear();
+    }
+    for (const QString &directory : std::as_const(directories)) {
+        if (!syncDirectory(directory)) {
+            qCWarning(lcSave) << "Could not sync directory:" << directory;
         }
     }
-    // Always end with a newline
-    out << "\n";
-    tempFile.close();
+    return true;
+}
 
-    // Replace the original file
-    QFile originalFileForRemoval(filePath);
-    if (originalFileForRemoval.remove()) {
-        if (tempFile.rename(filePath)) {
-            qDebug() << "Multi-line comments saved successfully to:" << filePath;
-            return true;
-        } else {
-            qWarning() << "Could not rename temporary file:" << tempFilePath;
-            return false;
-        }
-    } else {
-        qWarning() << "Could not remove original file:" << filePath;
+// The new content of a line with a replace or delete edit, without its terminator;
+// false if the whole line goes away, terminator included
+bool CommentSaver::editLine(QByteArrayView line, const CommentSpan *span, const CommentEdit &edit,
+                            const QString &marker, QByteArrayView eol, QByteArray &result)
+{
+    if (edit.kind == CommentEdit::Kind::Replace) {
+        result = replaceLine(line, span, edit.text, marker, eol);
+        return true;
+    }
+    if (!span) {
+        // Never delete a line that holds no comment (the file changed since extraction)
+        result = line.toByteArray();
+        return true;
+    }
+    if (isCommentOnly(line, *span)) {
         return false;
     }
+    result = deleteComment(line, *span);
+    return true;
 }
 
-QString CommentSaver::getCommentMarker(const QString &filePath)
+// Rewrites one original line (without its terminator) for a replacement edit. The
+// first line of the text takes the place of the comment; further lines become comment
+// lines of their own after it, joined with `eol`, so code on the line is kept.
+QByteArray CommentSaver::replaceLine(QByteArrayView line, const CommentSpan *span, const QString &comment,
+                                     const QString &marker, QByteArrayView eol)
 {
-    QString extension = QFileInfo(filePath).suffix().toLower();
-    
-    if (extension == "py") {
-        return "#";
-    } else if (extension == "cpp" || extension == "h" || extension == "ts" || extension == "js") {
-        return "//";
+    const qsizetype firstBreak = comment.indexOf('\n');
+    const QString firstLine = firstBreak < 0 ? comment : comment.first(firstBreak);
+    QByteArray result;
+    if (span) {
+        // Replace just the located comment text, keeping markers, code and "*/"
+        result.reserve(line.size() + comment.size());
+        result.append(line.first(span->textStart - span->lineStart));
+        result.append(firstLine.toUtf8());
+        result.append(line.sliced(span->textEnd - span->lineStart));
+    } else {
+        // The lexer found no comment in this language. A blank line becomes a comment
+        // line; a line with code is kept (the file changed since extraction)
+        const QString originalLine = QString::fromUtf8(line);
+        if (!originalLine.trimmed().isEmpty()) {
+            qCWarning(lcSave) << "Not replacing line without a comment:" << originalLine;
+            return line.toByteArray();
+        }
+        result = (originalLine + marker + " " + firstLine).toUtf8();
     }
-    
-    return "#"; // Default to Python style
+
+    if (firstBreak >= 0) {
+        const QString indentation = getIndentation(QString::fromUtf8(line));
+        for (const QString &extra : expandMultiLineComment(comment.sliced(firstBreak + 1), marker, indentation)) {
+            result.append(eol);
+            result.append(extra.toUtf8());
+        }
+    }
+    return result;
+}
+
+// Removes the comment from a line that keeps code, with the blanks before it. A block
+// comment that continues onto other lines keeps its markers and only loses its text.
+QByteArray CommentSaver::deleteComment(QByteArrayView line, const CommentSpan &span)
+{
+    qsizetype cutStart = span.textStart - span.lineStart;
+    qsizetype cutEnd = span.textEnd - span.lineStart;
+    if (!span.isBlockFragment) {
+        cutStart = span.commentStart - span.lineStart;
+        cutEnd = span.commentEnd - span.lineStart;
+        while (cutStart > 0 && (line[cutStart - 1] == ' ' || line[cutStart - 1] == '\t')) {
+            --cutStart;
+        }
+    }
+    QByteArray result;
+    result.reserve(line.size());
+    result.append(line.first(cutStart));
+    result.append(line.sliced(cutEnd));
+    return result;
 }
 
 QString CommentSaver::getIndentation(const QString &line)
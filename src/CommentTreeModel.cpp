@@ -0,0 +1,757 @@
+#include "CommentTreeModel.h"
+#include "CommentLexer.h"
+#include "Trace.h"
+#include <QColor>
+#include <QFileInfo>
+#include <QFont>
+#include <QSize>
+#include <QThread>
+#include <QThreadPool>
+#include <algorithm>
+
+CommentTreeModel::CommentTreeModel(QObject *parent) : QAbstractItemModel(parent)
+{
+
+}
+
+void CommentTreeModel::clear()
+{
+    beginResetModel();
+    files_.clear();
+    rowByPath_.clear();
+    index_.clear();
+    indexedRows_ = 0;
+    indexStarted_ = false;
+    lru_.clear();
+    residentBytes_ = 0;
+    cancelSearch();
+    endResetModel();
+}
+
+namespace {
+
+// An inline line is saved as its comment alone, so an edit of it may change nothing
+// but the comment text. Returns why `text` cannot be saved for `group`, or nothing.
+QString refusedEditReason(const CommentGroup &group, const QString &text, Language language)
+{
+    const QStringList lines = text.split('\n');
+    const CommentLexer lexer(language);
+    for (int i = 0; i < std::min(group.size(), int(lines.size())); ++i) {
+        if (!group.showsFullLine(i)) {
+            continue;
+        }
+        const QByteArray original = group.fullLine(i).trimmed().toUtf8();
+        const QByteArray edited = lines[i].toUtf8();
+        const QList<CommentSpan> originalSpans = lexer.scan(original);
+        const QList<CommentSpan> editedSpans = lexer.scan(edited);
+        if (editedSpans.isEmpty() || originalSpans.isEmpty()) {
+            return CommentTreeModel::tr("Line %1 no longer has a comment marker; edit was not kept")
+                .arg(group.lineNumber(i));
+        }
+        const CommentSpan &a = originalSpans.first();
+        const CommentSpan &b = editedSpans.first();
+        if (QByteArrayView(original).first(a.textStart) != QByteArrayView(edited).first(b.textStart)
+            || QByteArrayView(original).sliced(a.textEnd) != QByteArrayView(edited).sliced(b.textEnd)) {
+            return CommentTreeModel::tr("Only the comment on line %1 can be edited here, not its code; edit was not kept")
+                .arg(group.lineNumber(i));
+        }
+    }
+    return QString();
+}
+
+// A group is new when all of its lines are, modified when any line changed
+ChangeKind groupChangeOf(const CommentGroup &group, const FileChanges &changes)
+{
+    int newLines = 0;
+    bool changed = false;
+    for (int i = 0; i < group.size(); ++i) {
+        const ChangeKind kind = changes.lineChange(group.lineNumber(i));
+        newLines += kind == ChangeKind::New;
+        changed = changed || kind != ChangeKind::Unchanged;
+    }
+    if (newLines == group.size()) {
+        return ChangeKind::New;
+    }
+    return changed ? ChangeKind::Modified : ChangeKind::Unchanged;
+}
+
+} // namespace
+
+int CommentTreeModel::appendFile(const FileComments &file, const FileChanges *changes)
+{
+    const int row = files_.size();
+    beginInsertRows(QModelIndex(), row, row);
+    FileEntry entry;
+    entry.path = file.filePath;
+    entry.contentHash = file.contentHash;
+    entry.comments = file.comments;
+    entry.rowHeights.fill(-1, file.groupCount());
+    if (changes) {
+        entry.groupChanges.reserve(file.groupCount());
+        for (int groupRow = 0; groupRow < file.groupCount(); ++groupRow) {
+            entry.groupChanges.append(groupChangeOf(file.group(groupRow), *changes));
+        }
+    }
+    files_.append(entry);
+    rowByPath_.insert(file.filePath, row);
+    addResident(row, ++useCounter_);
+    endInsertRows(); // Indexed by indexPending()
+    evictToBudget();
+    return row;
+}
+
+void CommentTreeModel::replaceFile(int fileRow, const FileComments &file)
+{
+    const QModelIndex parentIndex = index(fileRow, 0);
+    FileEntry &entry = files_[fileRow];
+
+    // Only this file's children change; other files keep their rows and edits
+    if (!entry.evicted) {
+        removeResident(fileRow);
+    }
+    if (entry.comments.groupCount() > 0) {
+        beginRemoveRows(parentIndex, 0, entry.comments.groupCount() - 1);
+        entry.comments = CommentArena();
+        entry.rowHeights.clear();
+        endRemoveRows();
+    }
+    entry.editedText.clear();
+    entry.groupChanges.clear(); // Line numbers no longer match the diff
+    entry.contentHash = file.contentHash;
+    entry.changedOnDisk = false;
+    entry.evicted = false;
+    entry.reloadQueued = false;
+    if (file.groupCount() > 0) {
+        beginInsertRows(parentIndex, 0, file.groupCount() - 1);
+        entry.comments = file.comments;
+        entry.rowHeights.fill(-1, file.groupCount());
+        endInsertRows();
+    }
+    addResident(fileRow, ++useCounter_);
+    index_.setFile(fileRow, entry.comments);
+    emit dataChanged(parentIndex, parentIndex);
+    evictToBudget();
+}
+
+CommentGroup CommentTreeModel::group(int fileRow, int groupRow) const
+{
+    loadResident(fileRow);
+    return CommentGroup(files_[fileRow].comments, groupRow);
+}
+
+void CommentTreeModel::setMemoryBudget(qsizetype bytes)
+{
+    memoryBudget_ = bytes;
+    evictToBudget();
+}
+
+// Makes a file's comments available and marks it as just shown. Views call this
+// while painting, so an evicted file is loaded on the pool and shown once it arrives
+// (handleFileLoaded); until then this returns false and the rows are placeholders.
+bool CommentTreeModel::ensureResident(int fileRow) const
+{
+    const FileEntry &entry = files_[fileRow];
+    if (!entry.evicted) {
+        if (entry.lruKey != lru_.lastKey()) {
+            lru_.remove(entry.lruKey);
+            entry.lruKey = ShownKey | ++useCounter_;
+            lru_.insert(entry.lruKey, fileRow);
+        }
+        return true;
+    }
+    if (!loader_ || entry.reloadQueued) {
+        return false;
+    }
+
+    entry.reloadQueued = true;
+    CommentTreeModel *model = const_cast<CommentTreeModel *>(this);
+    const FileLoader loader = loader_;
+    const QString path = entry.path;
+    loadPool_.start([model, loader, path]() {
+        const FileComments file = loader(path);
+        QMetaObject::invokeMethod(model, [model, file]() { model->handleFileLoaded(file); }, Qt::QueuedConnection);
+    });
+    return false;
+}
+
+// The same for callers outside painting (editing, saving, replacing), which need the
+// text now: an evicted file is loaded on the calling thread
+bool CommentTreeModel::loadResident(int fileRow) const
+{
+    const FileEntry &entry = files_[fileRow];
+    if (!entry.evicted) {
+        return ensureResident(fileRow);
+    }
+    if (!loader_) {
+        return false;
+    }
+
+    FileComments file = loader_(entry.path);
+    if (file.contentHash != entry.contentHash || file.groupCount() != entry.comments.groupCount()) {
+        // Changed on disk while evicted; the rows are swapped once the caller is done
+        // with the model, as a reload would for any clean file
+        entry.reloadQueued = true;
+        QMetaObject::invokeMethod(const_cast<CommentTreeModel *>(this), [this, file]() {
+            const int row = rowForPath(file.filePath);
+            if (row >= 0 && files_[row].evicted) {
+                const_cast<CommentTreeModel *>(this)->replaceFile(row, file);
+            }
+        }, Qt::QueuedConnection);
+        return false;
+    }
+    entry.comments = file.comments;
+    entry.evicted = false;
+    entry.reloadQueued = false; // A background load still running is ignored when it arrives
+    addResident(fileRow, ShownKey | ++useCounter_);
+    index_.setFile(fileRow, entry.comments);
+    evictToBudget();
+    return true;
+}
+
+void CommentTreeModel::handleFileLoaded(const FileComments &file)
+{
+    const int fileRow = rowForPath(file.filePath);
+    if (fileRow < 0 || !files_[fileRow].evicted || !files_[fileRow].reloadQueued) {
+        return; // Cleared, replaced or loaded in the meantime
+    }
+    FileEntry &entry = files_[fileRow];
+    if (file.contentHash != entry.contentHash || file.groupCount() != entry.comments.groupCount()) {
+        replaceFile(fileRow, file); // Changed on disk while evicted
+        return;
+    }
+    makeResident(fileRow, file.comments);
+    evictToBudget();
+}
+
+// Puts an evicted file's comments, loaded unchanged, back in place
+void CommentTreeModel::makeResident(int fileRow, const CommentArena &comments)
+{
+    FileEntry &entry = files_[fileRow];
+    entry.comments = comments;
+    entry.evicted = false;
+    entry.reloadQueued = false; // A background load still running is ignored when it arrives
+    entry.rowHeights.fill(-1);  // Placeholders were measured as one line
+    addResident(fileRow, ShownKey | ++useCounter_);
+    index_.setFile(fileRow, entry.comments);
+    const QModelIndex parentIndex = index(fileRow, 0);
+    if (entry.comments.groupCount() > 0) {
+        emit dataChanged(index(0, 0, parentIndex), index(entry.comments.groupCount() - 1, ColumnCount - 1, parentIndex));
+    }
+}
+
+void CommentTreeModel::addResident(int fileRow, quint64 key) const
+{
+    const FileEntry &entry = files_[fileRow];
+    lru_.remove(entry.lruKey); // In case a view touched the file while it was being replaced
+    entry.lruKey = key;
+    lru_.insert(key, fileRow);
+    residentBytes_ += entry.comments.memoryBytes();
+}
+
+void CommentTreeModel::removeResident(int fileRow) const
+{
+    const FileEntry &entry = files_[fileRow];
+    lru_.remove(entry.lruKey);
+    residentBytes_ -= entry.comments.memoryBytes();
+}
+
+// Evicts clean files, oldest first, until the budget holds. The file used last is
+// kept, since a view is reading it.
+void CommentTreeModel::evictToBudget() const
+{
+    if (memoryBudget_ <= 0 || !loader_) {
+        return;
+    }
+    auto it = lru_.begin();
+    while (residentBytes_ > memoryBudget_ && it != lru_.end() && it.key() != lru_.lastKey()) {
+        const FileEntry &entry = files_[it.value()];
+        if (!entry.editedText.isEmpty() || it.value() >= indexedRows_) {
+            ++it; // Unsaved edits are never evicted, nor files the index has yet to read
+            continue;
+        }
+        residentBytes_ -= entry.comments.memoryBytes();
+        index_.removeFile(it.value()); // The index shares the arena; searches read the file back
+        CommentArena offsets;
+        offsets.groupStarts = entry.comments.groupStarts;
+        entry.comments = offsets;
+        entry.evicted = true;
+        it = lru_.erase(it);
+    }
+}
+
+bool CommentTreeModel::indexPending(QDeadlineTimer deadline)
+{
+    // Rows are appended in order, so the files still to index are the last ones
+    while (indexedRows_ < files_.size()) {
+        const FileEntry &entry = files_[indexedRows_];
+        if (!indexStarted_) {
+            index_.beginFile(indexedRows_, entry.comments);
+            indexStarted_ = true;
+        }
+        if (!index_.indexMore(indexedRows_, entry.editedText, deadline)) {
+            return false;
+        }
+        ++indexedRows_;
+        indexStarted_ = false;
+    }
+    evictToBudget();
+    return true;
+}
+
+CommentMatches CommentTreeModel::search(const CommentQuery &query)
+{
+    const int generation = ++searchGeneration_;
+    CommentMatches matches = index_.search(query);
+
+    // Files the index does not hold yet (still being indexed, or evicted) are scanned on
+    // a worker, so typing never waits for them. Evicted files are read back through the
+    // loader, a comment cache lookup for an unchanged file; one that changed while
+    // evicted is left out, and the model replaces it when it is shown.
+    QList<PendingScan> scans;
+    for (int fileRow = 0; fileRow < files_.size(); ++fileRow) {
+        const FileEntry &entry = files_[fileRow];
+        if (entry.evicted || fileRow >= indexedRows_) {
+            scans.append({fileRow, entry.path, entry.contentHash, entry.comments, entry.editedText, entry.evicted, {}});
+        }
+    }
+    searchPendingFiles_ = scans.size();
+    if (scans.isEmpty()) {
+        return matches;
+    }
+    const FileLoader loader = loader_;
+    loadPool_.start([this, generation, query, matches, scans, loader]() mutable {
+        QThreadPool pool;
+        pool.setMaxThreadCount(QThread::idealThreadCount());
+        for (PendingScan &scan : scans) {
+            pool.start([this, generation, &query, &loader, &scan]() {
+                if (generation != searchGeneration_) {
+                    return; // A newer search replaced this one
+                }
+                CommentArena comments = scan.comments;
+                if (scan.evicted) {
+                    const FileComments loaded = loader ? loader(scan.path) : FileComments();
+                    if (loaded.contentHash != scan.contentHash || loaded.groupCount() != comments.groupCount()) {
+                        return;
+                    }
+                    comments = loaded.comments;
+                }
+                scan.groups = CommentIndex::scanFile(query, comments, scan.editedText);
+            });
+        }
+        pool.waitForDone();
+        QMetaObject::invokeMethod(this, [this, generation, matches, scans]() {
+            finishSearch(generation, matches, scans);
+        }, Qt::QueuedConnection);
+    });
+    return matches;
+}
+
+void CommentTreeModel::cancelSearch()
+{
+    ++searchGeneration_;
+    searchPendingFiles_ = 0;
+}
+
+// Adds the scanned files to what the index answered and publishes the full result
+void CommentTreeModel::finishSearch(int generation, CommentMatches matches, const QList<PendingScan> &scans)
+{
+    if (generation != searchGeneration_) {
+        return;
+    }
+    searchPendingFiles_ = 0;
+    matches.groups.resize(files_.size());
+    for (const PendingScan &scan : scans) {
+        if (scan.fileRow >= files_.size()) {
+            continue;
+        }
+        // A file partly indexed when the search began was also partly answered by the index
+        QBitArray &groups = matches.groups[scan.fileRow];
+        if (!groups.isEmpty()) {
+            matches.groupCount -= groups.count(true);
+            --matches.fileCount;
+        }
+        groups = scan.groups;
+        if (!groups.isEmpty()) {
+            matches.groupCount += groups.count(true);
+            ++matches.fileCount;
+        }
+    }
+    emit searchCompleted(matches);
+}
+
+QList<int> CommentTreeModel::dirtyGroups(int fileRow) const
+{
+    QList<int> groupRows = files_[fileRow].editedText.keys();
+    std::sort(groupRows.begin(), groupRows.end());
+    return groupRows;
+}
+
+QList<int> CommentTreeModel::dirtyFiles() const
+{
+    QList<int> fileRows;
+    for (int row = 0; row < files_.size(); ++row) {
+        if (!files_[row].editedText.isEmpty()) {
+            fileRows.append(row);
+        }
+    }
+    return fileRows;
+}
+
+void CommentTreeModel::clearEdits(int fileRow)
+{
+    FileEntry &entry = files_[fileRow];
+    if (entry.editedText.isEmpty()) {
+        return;
+    }
+    entry.editedText.clear();
+    entry.rowHeights.fill(-1);
+    index_.setFile(fileRow, entry.comments); // Dirty files are never evicted
+    const QModelIndex parentIndex = index(fileRow, 0);
+    emit dataChanged(index(0, 0, parentIndex), index(entry.comments.groupCount() - 1, ColumnCount - 1, parentIndex));
+    emit dataChanged(parentIndex, parentIndex);
+}
+
+void CommentTreeModel::setChangedOnDisk(int fileRow, bool changed)
+{
+    files_[fileRow].changedOnDisk = changed;
+    const QModelIndex fileIndex = index(fileRow, 0);
+    emit dataChanged(fileIndex, fileIndex);
+}
+
+QString CommentTreeModel::groupText(int fileRow, int groupRow) const
+{
+    const FileEntry &file = files_[fileRow];
+    auto edited = file.editedText.constFind(groupRow);
+    if (edited != file.editedText.constEnd()) {
+        return edited.value();
+    }
+    if (!loadResident(fileRow)) {
+        return QString();
+    }
+    return CommentGroup(file.comments, groupRow).getCombinedComments();
+}
+
+ReplaceSnapshot CommentTreeModel::snapshotForReplace(const CommentReplacer &replacer) const
+{
+    ReplaceSnapshot snapshot;
+    snapshot.loader = loader_;
+
+    // Plain text narrows the work to the groups the index has as candidates. Its
+    // substring search ignores ASCII case only, so that holds unless the text has
+    // other letters that only match with case ignored.
+    CommentMatches candidates;
+    bool narrowed = replacer.syntax() == CommentReplacer::Syntax::Literal;
+    if (narrowed && replacer.caseSensitivity() == Qt::CaseInsensitive) {
+        for (QChar c : replacer.find()) {
+            narrowed = narrowed && (c.unicode() < 0x80 || c.toLower() == c.toUpper());
+        }
+    }
+    if (narrowed) {
+        CommentQuery query;
+        query.text = replacer.find();
+        candidates = index_.search(query);
+    }
+
+    // Each file's arena and edits are implicitly shared, so this copies no comment data.
+    // Evicted files and files still being indexed are read in full.
+    snapshot.files.resize(files_.size());
+    for (int fileRow = 0; fileRow < files_.size(); ++fileRow) {
+        const FileEntry &entry = files_[fileRow];
+        const bool indexed = narrowed && fileRow < indexedRows_ && !entry.evicted;
+        snapshot.files[fileRow] = {entry.path, entry.contentHash, entry.comments, entry.evicted, entry.editedText,
+                                   indexed ? candidates.groups.value(fileRow) : QBitArray(),
+                                   indexed && !candidates.fileMatches(fileRow)};
+    }
+    return snapshot;
+}
+
+ReplacePlan CommentTreeModel::planReplace(const ReplaceSnapshot &snapshot, const CommentReplacer &replacer)
+{
+    TraceSpan replaceSpan("planReplace");
+    const qsizetype fileCount = snapshot.files.size();
+    ReplacePlan plan;
+    plan.groupTexts.resize(fileCount);
+    plan.contentHashes.resize(fileCount);
+    plan.loadedComments.resize(fileCount);
+
+    QList<int> matchCounts(fileCount, 0);
+    QHash<int, QString> *results = plan.groupTexts.data();
+    CommentArena *loaded = plan.loadedComments.data();
+    int *counts = matchCounts.data();
+    QList<int> readOnlyCounts(fileCount, 0);
+    int *readOnly = readOnlyCounts.data();
+    QThreadPool pool;
+    pool.setMaxThreadCount(QThread::idealThreadCount());
+    for (qsizetype fileRow = 0; fileRow < fileCount; ++fileRow) {
+        plan.contentHashes[fileRow] = snapshot.files[fileRow].contentHash;
+        if (snapshot.files[fileRow].skip) {
+            continue;
+        }
+        pool.start([&, fileRow]() {
+            const ReplaceSnapshot::File &task = snapshot.files[fileRow];
+            CommentArena comments = task.comments;
+            if (task.evicted) {
+                // A file that changed while evicted is reloaded by the model; leave it out
+                const FileComments file = snapshot.loader ? snapshot.loader(task.path) : FileComments();
+                if (file.contentHash != task.contentHash || file.groupCount() != comments.groupCount()) {
+                    return;
+                }
+                comments = file.comments;
+            }
+            const Language language = LanguageRegistry::forFile(task.path);
+            for (int groupRow = 0; groupRow < comments.groupCount(); ++groupRow) {
+                if (!task.groups.isEmpty() && (groupRow >= task.groups.size() || !task.groups.testBit(groupRow))) {
+                    continue;
+                }
+                const CommentGroup group(comments, groupRow);
+                QString text = task.editedText.value(groupRow, group.getCombinedComments());
+                if (group.isReadOnly()) {
+                    readOnly[fileRow] += replacer.replaceInComment(text) > 0 ? 1 : 0; // Counted, left as is
+                    continue;
+                }
+                const int count = replacer.replaceInGroup(text, group, language);
+                if (count > 0) {
+                    results[fileRow].insert(groupRow, text);
+                    counts[fileRow] += count;
+                }
+            }
+            if (!results[fileRow].isEmpty()) {
+                loaded[fileRow] = comments; // Lets applying the plan skip reading an evicted file again
+            }
+        });
+    }
+    pool.waitForDone();
+
+    for (qsizetype fileRow = 0; fileRow < fileCount; ++fileRow) {
+        plan.readOnlyGroupCount += readOnlyCounts[fileRow];
+        if (!plan.groupTexts[fileRow].isEmpty()) {
+            plan.matchCount += matchCounts[fileRow];
+            plan.groupCount += plan.groupTexts[fileRow].size();
+            plan.fileCount++;
+        }
+    }
+    return plan;
+}
+
+int CommentTreeModel::applyReplace(const ReplacePlan &plan)
+{
+    int skipped = 0;
+    for (int fileRow = 0; fileRow < plan.groupTexts.size(); ++fileRow) {
+        const QHash<int, QString> &texts = plan.groupTexts[fileRow];
+        if (texts.isEmpty()) {
+            continue;
+        }
+        if (fileRow >= files_.size() || files_[fileRow].contentHash != plan.contentHashes[fileRow]) {
+            ++skipped; // Reloaded or gone since the plan was made
+            continue;
+        }
+        if (files_[fileRow].evicted && plan.loadedComments[fileRow].groupCount() > 0) {
+            makeResident(fileRow, plan.loadedComments[fileRow]);
+        }
+        const QModelIndex fileIndex = index(fileRow, 0);
+        for (auto it = texts.constBegin(); it != texts.constEnd(); ++it) {
+            setData(index(it.key(), CommentColumn, fileIndex), it.value(), Qt::EditRole);
+        }
+    }
+    return skipped;
+}
+
+QModelIndex CommentTreeModel::index(int row, int column, const QModelIndex &parent) const
+{
+    if (!hasIndex(row, column, parent)) {
+        return QModelIndex();
+    }
+    if (!parent.isValid()) {
+        return createIndex(row, column, quintptr(0));
+    }
+    return createIndex(row, column, quintptr(parent.row() + 1));
+}
+
+QModelIndex CommentTreeModel::parent(const QModelIndex &child) const
+{
+    if (!child.isValid() || isFileRow(child)) {
+        return QModelIndex();
+    }
+    return createIndex(fileRowOf(child), 0, quintptr(0));
+}
+
+int CommentTreeModel::rowCount(const QModelIndex &parent) const
+{
+    if (!parent.isValid()) {
+        return files_.size();
+    }
+    if (isFileRow(parent) && parent.column() == 0) {
+        return groupCount(parent.row());
+    }
+    return 0;
+}
+
+int CommentTreeModel::columnCount(const QModelIndex &parent) const
+{
+    Q_UNUSED(parent)
+    return ColumnCount;
+}
+
+QVariant CommentTreeModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid()) {
+        return QVariant();
+    }
+
+    if (isFileRow(index)) {
+        const FileEntry &file = files_[index.row()];
+        if (index.column() != LineColumn) {
+            return QVariant();
+        }
+        switch (role) {
+        case Qt::DisplayRole: {
+            // Dirty files are marked with " *", as in most editors
+            QString name = QFileInfo(file.path).fileName();
+            if (!file.editedText.isEmpty()) {
+                name += " *";
+            }
+            if (file.changedOnDisk) {
+                return tr("%1 (changed on disk, unsaved edits kept)").arg(name);
+            }
+            return name;
+        }
+        case Qt::ToolTipRole:
+            return file.path;
+        case Qt::FontRole: {
+            QFont font;
+            font.setBold(true);
+            return font;
+        }
+        default:
+            return QVariant();
+        }
+    }
+
+    const FileEntry &file = files_[fileRowOf(index)];
+    const int groupRow = index.row();
+    switch (role) {
+    case Qt::DisplayRole:
+    case Qt::EditRole:
+        if (!ensureResident(fileRowOf(index))) {
+            // Evicted and loading in the background; the rows update when it arrives
+            return role == Qt::DisplayRole && index.column() == CommentColumn ? tr("Loading...") : QVariant();
+        }
+        if (index.column() == LineColumn) {
+            return CommentGroup(file.comments, groupRow).getLineRange();
+        }
+        return groupText(fileRowOf(index), groupRow);
+    case Qt::TextAlignmentRole:
+        if (index.column() == LineColumn) {
+            return int(Qt::AlignRight | Qt::AlignVCenter);
+        }
+        return QVariant();
+    case Qt::BackgroundRole:
+        // Groups changed since the compared revision are tinted: green when new, amber when modified
+        switch (groupChange(fileRowOf(index), groupRow)) {
+        case ChangeKind::New:
+            return QColor(222, 245, 222);
+        case ChangeKind::Modified:
+            return QColor(252, 240, 200);
+        default:
+            return QVariant();
+        }
+    case Qt::ToolTipRole:
+        if (index.column() == CommentColumn && !file.evicted) {
+            const CommentGroup group(file.comments, groupRow);
+            const int line = group.lineWithMoreComments();
+            if (line >= 0) {
+                return tr("Line %1 holds more than one comment, and only its first could be saved; "
+                          "edit this group in the source file").arg(group.lineNumber(line));
+            }
+        }
+        switch (groupChange(fileRowOf(index), groupRow)) {
+        case ChangeKind::New:
+            return tr("New since the compared revision");
+        case ChangeKind::Modified:
+            return tr("Modified since the compared revision");
+        default:
+            return QVariant();
+        }
+    case Qt::SizeHintRole: {
+        // Height for multi-line comments: minimum 25px, 20px per line; computed once
+        if (!ensureResident(fileRowOf(index))) {
+            return QSize(0, 25);
+        }
+        int &height = file.rowHeights[groupRow];
+        if (height < 0) {
+            int lineCount = groupText(fileRowOf(index), groupRow).count('\n') + 1;
+            height = std::max(25, lineCount * 20);
+        }
+        return QSize(0, height);
+    }
+    default:
+        return QVariant();
+    }
+}
+
+bool CommentTreeModel::setData(const QModelIndex &index, const QVariant &value, int role)
+{
+    if (!index.isValid() || isFileRow(index) || index.column() != CommentColumn || role != Qt::EditRole) {
+        return false;
+    }
+
+    const int fileRow = fileRowOf(index);
+    if (!loadResident(fileRow)) {
+        return false;
+    }
+    if (CommentGroup(files_[fileRow].comments, index.row()).isReadOnly()) {
+        return false;
+    }
+    const QString text = value.toString();
+    if (text == groupText(fileRow, index.row())) {
+        return false; // Editor closed without a change; nothing becomes dirty
+    }
+    const CommentGroup group(files_[fileRow].comments, index.row());
+    const QString refused = refusedEditReason(group, text, LanguageRegistry::forFile(files_[fileRow].path));
+    if (!refused.isEmpty()) {
+        emit editRefused(refused);
+        return false;
+    }
+
+    // Editing a group back to its extracted text makes it clean again
+    FileEntry &file = files_[fileRow];
+    const bool wasDirty = !file.editedText.isEmpty();
+    if (text == CommentGroup(file.comments, index.row()).getCombinedComments()) {
+        file.editedText.remove(index.row());
+        index_.restoreGroup(fileRow, index.row());
+    } else {
+        file.editedText.insert(index.row(), text);
+        index_.setGroup(fileRow, index.row(), text);
+    }
+    file.rowHeights[index.row()] = -1;
+    emit dataChanged(index.siblingAtColumn(LineColumn), index, {Qt::DisplayRole, Qt::EditRole, Qt::SizeHintRole});
+    if (wasDirty != !file.editedText.isEmpty()) {
+        const QModelIndex fileIndex = this->index(fileRow, 0);
+        emit dataChanged(fileIndex, fileIndex, {Qt::DisplayRole});
+    }
+    return true;
+}
+
+Qt::ItemFlags CommentTreeModel::flags(const QModelIndex &index) const
+{
+    if (!index.isValid()) {
+        return Qt::NoItemFlags;
+    }
+    Qt::ItemFlags itemFlags = Qt::ItemIsEnabled | Qt::ItemIsSelectable;
+    // Placeholder rows of a file that is still loading are not edited, nor are groups
+    // with a line of several comments
+    const int fileRow = isFileRow(index) ? -1 : fileRowOf(index);
+    if (fileRow >= 0 && index.column() == CommentColumn && !files_[fileRow].evicted
+        && !CommentGroup(files_[fileRow].comments, index.row()).isReadOnly()) {
+        itemFlags |= Qt::ItemIsEditable;
+    }
+    return itemFlags;
+}
+
+QVariant CommentTreeModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if (orientation != Qt::Horizontal || role != Qt::DisplayRole) {
+        return QVariant();
+    }
+    return section == LineColumn ? QString("Line") : QString("Comment");
+}
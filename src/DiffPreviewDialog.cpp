@@ -0,0 +1,210 @@
+#include "DiffPreviewDialog.h"
+#include <QColor>
+#include <QDialogButtonBox>
+#include <QFileInfo>
+#include <QFontDatabase>
+#include <QHBoxLayout>
+#include <QLabel>
+#include <QPlainTextEdit>
+#include <QPushButton>
+#include <QSplitter>
+#include <QSyntaxHighlighter>
+#include <QTextBlock>
+#include <QTextCursor>
+#include <QTreeWidget>
+#include <QVBoxLayout>
+
+namespace {
+
+enum ItemRole { FileRole = Qt::UserRole, HunkRole };
+
+// Colours diff lines; the lines of a rejected hunk are greyed out
+class DiffHighlighter : public QSyntaxHighlighter
+{
+public:
+    using QSyntaxHighlighter::QSyntaxHighlighter;
+
+protected:
+    void highlightBlock(const QString &text) override
+    {
+        enum State { Accepted, Rejected };
+        int state = previousBlockState() == Rejected ? Rejected : Accepted;
+        if (text.startsWith("@@")) {
+            state = text.endsWith("(rejected)") ? Rejected : Accepted;
+            setFormat(0, text.size(), QColor(40, 90, 170));
+        } else if (state == Rejected) {
+            setFormat(0, text.size(), QColor(150, 150, 150));
+        } else if (text.startsWith('+')) {
+            setFormat(0, text.size(), QColor(20, 120, 20));
+        } else if (text.startsWith('-')) {
+            setFormat(0, text.size(), QColor(170, 30, 30));
+        }
+        setCurrentBlockState(state);
+    }
+};
+
+} // namespace
+
+DiffPreviewDialog::DiffPreviewDialog(const QList<FilePreview> &previews, QWidget *parent)
+    : QDialog(parent), previews_(previews)
+{
+    setWindowTitle(tr("Review Changes"));
+    resize(1000, 650);
+
+    // Files with their hunks on the left, the selected file's diff on the right
+    tree_ = new QTreeWidget();
+    tree_->setHeaderHidden(true);
+    diffView_ = new QPlainTextEdit();
+    diffView_->setReadOnly(true);
+    diffView_->setLineWrapMode(QPlainTextEdit::NoWrap);
+    diffView_->setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+    new DiffHighlighter(diffView_->document());
+    QSplitter *splitter = new QSplitter();
+    splitter->addWidget(tree_);
+    splitter->addWidget(diffView_);
+    splitter->setStretchFactor(1, 1);
+
+    for (int f = 0; f < previews_.size(); ++f) {
+        const FilePreview &preview = previews_[f];
+        QTreeWidgetItem *fileItem = new QTreeWidgetItem(tree_);
+        fileItem->setText(0, QFileInfo(preview.filePath).fileName());
+        fileItem->setToolTip(0, preview.filePath);
+        fileItem->setData(0, FileRole, f);
+        fileItem->setData(0, HunkRole, -1);
+        if (!preview.error.isEmpty()) {
+            // Not saved; its edits are kept
+            fileItem->setText(0, fileItem->text(0) + " - " + preview.error);
+            fileItem->setDisabled(true);
+            continue;
+        }
+        if (preview.hunks.isEmpty()) {
+            fileItem->setText(0, fileItem->text(0) + tr(" - no changes"));
+            continue;
+        }
+        fileItem->setFlags(fileItem->flags() | Qt::ItemIsUserCheckable | Qt::ItemIsAutoTristate);
+        for (int h = 0; h < preview.hunks.size(); ++h) {
+            const DiffHunk &hunk = preview.hunks[h];
+            QTreeWidgetItem *hunkItem = new QTreeWidgetItem(fileItem);
+            hunkItem->setText(0, tr("Lines %1-%2").arg(hunk.oldStart).arg(hunk.oldStart + std::max(hunk.oldCount, 1) - 1));
+            hunkItem->setData(0, FileRole, f);
+            hunkItem->setData(0, HunkRole, h);
+            hunkItem->setFlags(hunkItem->flags() | Qt::ItemIsUserCheckable);
+            hunkItem->setCheckState(0, hunk.accepted ? Qt::Checked : Qt::Unchecked);
+        }
+    }
+    connect(tree_, &QTreeWidget::itemChanged, this, &DiffPreviewDialog::handleItemChanged);
+    connect(tree_, &QTreeWidget::currentItemChanged, this, &DiffPreviewDialog::showCurrentFile);
+
+    QPushButton *acceptAllButton = new QPushButton(tr("Accept All"));
+    QPushButton *rejectAllButton = new QPushButton(tr("Reject All"));
+    connect(acceptAllButton, &QPushButton::clicked, this, [this]() { setAllAccepted(true); });
+    connect(rejectAllButton, &QPushButton::clicked, this, [this]() { setAllAccepted(false); });
+    summaryLabel_ = new QLabel();
+    QDialogButtonBox *buttons = new QDialogButtonBox(QDialogButtonBox::Save | QDialogButtonBox::Cancel);
+    saveButton_ = buttons->button(QDialogButtonBox::Save);
+    saveButton_->setText(tr("Save Accepted"));
+    connect(buttons, &QDialogButtonBox::accepted, this, &QDialog::accept);
+    connect(buttons, &QDialogButtonBox::rejected, this, &QDialog::reject);
+
+    QHBoxLayout *bottom = new QHBoxLayout();
+    bottom->addWidget(acceptAllButton);
+    bottom->addWidget(rejectAllButton);
+    bottom->addWidget(summaryLabel_, 1);
+    bottom->addWidget(buttons);
+    QVBoxLayout *layout = new QVBoxLayout(this);
+    layout->addWidget(new QLabel(tr("Accepted changes are saved. Rejected changes are not written and stay as unsaved edits.")));
+    layout->addWidget(splitter, 1);
+    layout->addLayout(bottom);
+
+    updateSummary();
+    if (tree_->topLevelItemCount() > 0) {
+        tree_->setCurrentItem(tree_->topLevelItem(0));
+    }
+}
+
+void DiffPreviewDialog::handleItemChanged(QTreeWidgetItem *item)
+{
+    // File items follow their hunks through Qt::ItemIsAutoTristate
+    const int hunk = item->data(0, HunkRole).toInt();
+    if (hunk < 0) {
+        return;
+    }
+    const int file = item->data(0, FileRole).toInt();
+    const bool accepted = item->checkState(0) == Qt::Checked;
+    if (previews_[file].hunks[hunk].accepted == accepted) {
+        return;
+    }
+    previews_[file].hunks[hunk].accepted = accepted;
+    updateSummary();
+    QTreeWidgetItem *current = tree_->currentItem();
+    if (current && current->data(0, FileRole).toInt() == file) {
+        showCurrentFile();
+    }
+}
+
+void DiffPreviewDialog::showCurrentFile()
+{
+    QTreeWidgetItem *item = tree_->currentItem();
+    if (!item) {
+        diffView_->clear();
+        return;
+    }
+
+    // Every hunk is shown, rejected ones greyed out, so a rejection can be undone in place
+    const FilePreview &preview = previews_[item->data(0, FileRole).toInt()];
+    QStringList lines{QString("--- %1").arg(preview.filePath), QString("+++ %1").arg(preview.filePath)};
+    QList<int> hunkLines;
+    int offset = 0;
+    for (const DiffHunk &hunk : preview.hunks) {
+        hunkLines.append(lines.size());
+        lines.append(QString("@@ -%1,%2 +%3,%4 @@%5").arg(hunk.oldStart).arg(hunk.oldCount)
+                     .arg(hunk.oldStart + offset).arg(hunk.newCount)
+                     .arg(hunk.accepted ? QString() : QString(" (rejected)")));
+        lines.append(hunk.lines);
+        if (hunk.accepted) {
+            offset += hunk.newCount - hunk.oldCount;
+        }
+    }
+    if (!preview.error.isEmpty()) {
+        lines.append(preview.error);
+    }
+    diffView_->setPlainText(lines.join('\n'));
+
+    const int hunk = item->data(0, HunkRole).toInt();
+    if (hunk >= 0) {
+        QTextCursor cursor(diffView_->document()->findBlockByNumber(hunkLines[hunk]));
+        diffView_->setTextCursor(cursor);
+        diffView_->centerCursor();
+    }
+}
+
+void DiffPreviewDialog::setAllAccepted(bool accepted)
+{
+    const Qt::CheckState state = accepted ? Qt::Checked : Qt::Unchecked;
+    for (int i = 0; i < tree_->topLevelItemCount(); ++i) {
+        QTreeWidgetItem *fileItem = tree_->topLevelItem(i);
+        for (int h = 0; h < fileItem->childCount(); ++h) {
+            fileItem->child(h)->setCheckState(0, state);
+        }
+    }
+}
+
+void DiffPreviewDialog::updateSummary()
+{
+    int hunks = 0;
+    int accepted = 0;
+    int files = 0;
+    for (const FilePreview &preview : std::as_const(previews_)) {
+        bool fileAccepted = false;
+        for (const DiffHunk &hunk : preview.hunks) {
+            hunks++;
+            if (hunk.accepted) {
+                accepted++;
+                fileAccepted = true;
+            }
+        }
+        files += fileAccepted ? 1 : 0;
+    }
+    summaryLabel_->setText(tr("%1 of %2 changes accepted in %3 files").arg(accepted).arg(hunks).arg(files));
+    saveButton_->setEnabled(accepted > 0 || hunks == 0);
+}
@@ -0,0 +1,129 @@
+#include "DirectoryScanner.h"
+#include <QDir>
+#include <QDirIterator>
+#include <QFileInfo>
+#include <QThread>
+
+DirectoryScanner::DirectoryScanner(QObject *parent) : QObject(parent)
+{
+    pool_.setMaxThreadCount(QThread::idealThreadCount());
+}
+
+DirectoryScanner::~DirectoryScanner()
+{
+    if (run_) {
+        run_->cancelled = true;
+    }
+    pool_.clear();
+    pool_.waitForDone();
+}
+
+void DirectoryScanner::start(const QString &rootPath)
+{
+    cancel();
+
+    const QString root = QDir::cleanPath(QDir(rootPath).absolutePath());
+    QSharedPointer<Run> run(new Run);
+    run->rootPath = root.endsWith('/') ? root : root + '/';
+    for (const QString &filter : nameFilters_) {
+        if (filter.startsWith('!')) {
+            run->excludeFilters.append(filter.mid(1));
+        } else {
+            run->includeFilters.append(filter);
+        }
+    }
+    run_ = run;
+
+    run->outstanding = 1;
+    pool_.start([this, run, root]() {
+        scanDirectory(run, root, QSharedPointer<const IgnoreRules>());
+    });
+}
+
+void DirectoryScanner::cancel()
+{
+    if (!run_) {
+        return;
+    }
+    run_->cancelled = true;
+    run_.reset();
+    emit finished(true);
+}
+
+void DirectoryScanner::scanDirectory(const QSharedPointer<Run> &run, const QString &path,
+                                     const QSharedPointer<const IgnoreRules> &parentRules)
+{
+    if (run->cancelled) {
+        taskDone(run);
+        return;
+    }
+
+    QSharedPointer<const IgnoreRules> rules = IgnoreRules::forDirectory(path, parentRules);
+    QStringList files;
+
+    QDirIterator it(path, QDir::Files | QDir::Dirs | QDir::Hidden | QDir::NoDotAndDotDot);
+    while (it.hasNext() && !run->cancelled) {
+        it.next();
+        const QFileInfo info = it.fileInfo();
+        const QString filePath = info.filePath();
+
+        if (info.isDir()) {
+            // Symlinked directories are skipped so cycles cannot occur
+            if (info.isSymLink() || info.fileName() == ".git" || (rules && rules->isIgnored(filePath, true))) {
+                continue;
+            }
+            ++run->outstanding;
+            pool_.start([this, run, filePath, rules]() {
+                scanDirectory(run, filePath, rules);
+            });
+        } else if (matchesFilters(*run, filePath, info.fileName()) && !(rules && rules->isIgnored(filePath, false))) {
+            files.append(filePath);
+        }
+    }
+
+    if (!files.isEmpty()) {
+        // Stable order within a directory; directories themselves finish in any order
+        files.sort();
+        QMetaObject::invokeMethod(this, [this, run, files]() {
+            if (run != run_) {
+                return;
+            }
+            for (const QString &filePath : files) {
+                emit fileFound(filePath);
+                if (run != run_) {
+                    return; // A slot cancelled the walk
+                }
+            }
+        }, Qt::QueuedConnection);
+    }
+
+    taskDone(run);
+}
+
+void DirectoryScanner::taskDone(const QSharedPointer<Run> &run)
+{
+    // The last task posts after every batch was posted, so finished() arrives last
+    if (--run->outstanding == 0) {
+        QMetaObject::invokeMethod(this, [this, run]() {
+            if (run != run_) {
+                return;
+            }
+            run_.reset();
+            emit finished(false);
+        }, Qt::QueuedConnection);
+    }
+}
+
+bool DirectoryScanner::matchesFilters(const Run &run, const QString &filePath, const QString &fileName)
+{
+    QStringView relativePath = QStringView(filePath).mid(run.rootPath.size());
+    auto matchesAny = [&](const QStringList &filters) {
+        for (const QString &filter : filters) {
+            if (globMatch(filter, filter.contains('/') ? relativePath : QStringView(fileName))) {
+                return true;
+            }
+        }
+        return false;
+    };
+    return matchesAny(run.includeFilters) && !matchesAny(run.excludeFilters);
+}
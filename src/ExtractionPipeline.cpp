@@ -0,0 +1,115 @@
+#include "ExtractionPipeline.h"
+
+ExtractionPipeline::ExtractionPipeline(QObject *parent) : QObject(parent)
+{
+    pool_.setMaxThreadCount(QThread::idealThreadCount());
+}
+
+ExtractionPipeline::~ExtractionPipeline()
+{
+    cancelled_ = true;
+    pool_.clear();
+    pool_.waitForDone();
+}
+
+void ExtractionPipeline::start(const QStringList &filePaths)
+{
+    begin();
+    for (const QString &filePath : filePaths) {
+        enqueue(filePath);
+    }
+    finishInput();
+}
+
+void ExtractionPipeline::begin()
+{
+    if (running_) {
+        cancel();
+    }
+
+    // Workers still finishing a cancelled run deliver under an old generation and are ignored
+    ++generation_;
+    cancelled_ = false;
+    running_ = true;
+    inputFinished_ = false;
+    queued_ = 0;
+    completed_ = 0;
+    nextToDeliver_ = 0;
+    outOfOrder_.clear();
+}
+
+void ExtractionPipeline::enqueue(const QString &filePath)
+{
+    if (!running_ || inputFinished_) {
+        return;
+    }
+
+    const int index = queued_++;
+    const quint64 generation = generation_;
+    pool_.start([this, generation, index, filePath]() {
+        if (cancelled_) {
+            return;
+        }
+        FileComments result = extractor_.extractFile(filePath);
+        if (computeMetrics_) {
+            result.metrics = CommentMetrics::forFile(result);
+        }
+        QMetaObject::invokeMethod(this, [this, generation, index, result]() {
+            deliver(generation, index, result);
+        }, Qt::QueuedConnection);
+    });
+    emit progressChanged(completed_, queued_);
+}
+
+void ExtractionPipeline::finishInput()
+{
+    if (!running_) {
+        return;
+    }
+    inputFinished_ = true;
+    finishIfDone();
+}
+
+void ExtractionPipeline::cancel()
+{
+    if (!running_) {
+        return;
+    }
+    cancelled_ = true;
+    pool_.clear(); // Drop files that have not started yet
+    ++generation_;
+    running_ = false;
+    outOfOrder_.clear();
+    emit finished(true);
+}
+
+void ExtractionPipeline::deliver(quint64 generation, int index, const FileComments &result)
+{
+    if (generation != generation_ || !running_) {
+        return;
+    }
+
+    ++completed_;
+    outOfOrder_.insert(index, result);
+
+    // Release every result that is now contiguous with what was already delivered
+    while (!outOfOrder_.isEmpty() && outOfOrder_.firstKey() == nextToDeliver_) {
+        FileComments next = outOfOrder_.take(nextToDeliver_);
+        emit fileExtracted(nextToDeliver_, next);
+        ++nextToDeliver_;
+        if (generation != generation_) {
+            return; // A slot cancelled or restarted the run
+        }
+    }
+
+    emit progressChanged(completed_, queued_);
+    finishIfDone();
+}
+
+void ExtractionPipeline::finishIfDone()
+{
+    if (running_ && inputFinished_ && nextToDeliver_ == queued_) {
+        running_ = false;
+        emit finished(false);
+    }
+}
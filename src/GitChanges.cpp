@@ -0,0 +1,192 @@
+#include "GitChanges.h"
+#include "Logging.h"
+#include <QDir>
+#include <QFileInfo>
+#include <QProcess>
+
+namespace {
+
+bool inRanges(const QList<QPair<int, int>> &ranges, int line)
+{
+    for (const QPair<int, int> &range : ranges) {
+        if (line >= range.first && line <= range.second) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Paths with unusual characters are C-quoted by git: "dir/a\"b.cpp", octal escapes for bytes
+QByteArray unquotePath(const QByteArray &path)
+{
+    if (!path.startsWith('"') || !path.endsWith('"') || path.size() < 2) {
+        return path;
+    }
+    QByteArray result;
+    for (qsizetype i = 1; i < path.size() - 1; ++i) {
+        if (path[i] != '\\' || i + 1 >= path.size() - 1) {
+            result.append(path[i]);
+            continue;
+        }
+        const char escaped = path[++i];
+        if (escaped >= '0' && escaped <= '7' && i + 2 < path.size() - 1) {
+            result.append(char(path.mid(i, 3).toInt(nullptr, 8)));
+            i += 2;
+        } else if (escaped == 'n') {
+            result.append('\n');
+        } else if (escaped == 't') {
+            result.append('\t');
+        } else {
+            result.append(escaped);
+        }
+    }
+    return result;
+}
+
+// "-12,3" or "+40" -> start and line count
+QPair<int, int> parseRange(const QByteArray &range)
+{
+    const qsizetype comma = range.indexOf(',');
+    if (comma < 0) {
+        return {range.mid(1).toInt(), 1};
+    }
+    return {range.mid(1, comma - 1).toInt(), range.mid(comma + 1).toInt()};
+}
+
+} // namespace
+
+ChangeKind FileChanges::lineChange(int line) const
+{
+    if (newFile || inRanges(added, line)) {
+        return ChangeKind::New;
+    }
+    return inRanges(modified, line) ? ChangeKind::Modified : ChangeKind::Unchanged;
+}
+
+bool GitChanges::load(const QString &path, const QString &revision)
+{
+    files_.clear();
+    errorString_.clear();
+    const QFileInfo info(path);
+    const QString directory = info.isDir() ? info.absoluteFilePath() : info.absolutePath();
+
+    QByteArray output;
+    if (!runGit(directory, {"rev-parse", "--show-toplevel"}, output)) {
+        return false;
+    }
+    const QString root = QString::fromUtf8(output.trimmed());
+
+    // "main..." means since the current branch left main
+    revision_ = revision.isEmpty() ? QStringLiteral("HEAD") : revision;
+    QString base = revision_;
+    if (base.endsWith("...")) {
+        if (!runGit(root, {"merge-base", base.chopped(3), "HEAD"}, output)) {
+            return false;
+        }
+        base = QString::fromUtf8(output.trimmed());
+    }
+    if (!runGit(root, {"rev-parse", "--verify", "--quiet", base + "^{commit}"}, output)) {
+        errorString_ = QString("Unknown revision: %1").arg(revision_);
+        return false;
+    }
+    const QString commit = QString::fromUtf8(output.trimmed());
+
+    // Changed lines of every tracked file, against the working tree
+    // git reports resolved paths, so symlinks in `path` must not hide it from the pathspec.
+    // The prefixes are fixed, since diff.mnemonicPrefix or diff.noprefix in the user's
+    // config would change the "+++ b/<path>" headers the parser strips.
+    const QString pathspec = info.canonicalFilePath();
+    if (!runGit(root, {"-c", "core.quotePath=false", "diff", "-U0", "--no-color", "--no-ext-diff", "--no-renames",
+                       "--src-prefix=a/", "--dst-prefix=b/", commit, "--", pathspec}, output)) {
+        return false;
+    }
+    parseDiff(root, output);
+
+    // Untracked files are new in their entirety; ignored files stay out
+    if (!runGit(root, {"ls-files", "--others", "--exclude-standard", "-z", "--", pathspec}, output)) {
+        return false;
+    }
+    for (const QByteArray &file : output.split('\0')) {
+        if (!file.isEmpty()) {
+            files_[QDir(root).filePath(QString::fromUtf8(file))].newFile = true;
+        }
+    }
+    return true;
+}
+
+const FileChanges *GitChanges::changesFor(const QString &filePath) const
+{
+    auto it = files_.constFind(QFileInfo(filePath).absoluteFilePath());
+    return it != files_.constEnd() ? &it.value() : nullptr;
+}
+
+bool GitChanges::runGit(const QString &workingDirectory, const QStringList &arguments, QByteArray &output)
+{
+    QProcess git;
+    git.setWorkingDirectory(workingDirectory);
+    git.start("git", arguments);
+    if (!git.waitForStarted()) {
+        errorString_ = QString("Could not run git: %1").arg(git.errorString());
+        qCWarning(lcExtract) << errorString_;
+        return false;
+    }
+    git.closeWriteChannel();
+    git.waitForFinished(-1);
+    output = git.readAllStandardOutput();
+    if (git.exitStatus() != QProcess::NormalExit || git.exitCode() != 0) {
+        errorString_ = QString::fromLocal8Bit(git.readAllStandardError()).trimmed();
+        if (errorString_.isEmpty()) {
+            errorString_ = QString("git %1 failed").arg(arguments.first());
+        }
+        return false;
+    }
+    return true;
+}
+
+// Reads `git diff -U0`: a "+++ b/<path>" header per file, then one "@@ -a,b +c,d @@"
+// line per hunk. Hunks that remove nothing only add lines; deleted files are skipped.
+void GitChanges::parseDiff(const QString &root, const QByteArray &diff)
+{
+    FileChanges *current = nullptr;
+    bool inHeader = false; // Hunk lines such as "--- x" (a removed "-- x") are not headers
+    bool fromNothing = false;
+    for (const QByteArray &line : diff.split('\n')) {
+        if (line.startsWith("diff --git ")) {
+            current = nullptr;
+            inHeader = true;
+            fromNothing = false;
+        } else if (inHeader && line.startsWith("--- ")) {
+            fromNothing = line == "--- /dev/null";
+        } else if (inHeader && line.startsWith("+++ ")) {
+            QByteArray path = unquotePath(line.mid(4));
+            if (path == "/dev/null") {
+                continue; // Deleted; nothing left to scan
+            }
+            if (path.startsWith("b/")) {
+                path = path.mid(2);
+            }
+            current = &files_[QDir(root).filePath(QString::fromUtf8(path))];
+            current->newFile = fromNothing;
+        } else if (line.startsWith("@@ ")) {
+            inHeader = false;
+            if (!current) {
+                continue;
+            }
+            const QList<QByteArray> fields = line.split(' ');
+            if (fields.size() < 3) {
+                continue;
+            }
+            const QPair<int, int> removed = parseRange(fields[1]);
+            const QPair<int, int> inserted = parseRange(fields[2]);
+            if (inserted.second == 0) {
+                continue; // Only removed lines; nothing in the current file to mark
+            }
+            const QPair<int, int> lines(inserted.first, inserted.first + inserted.second - 1);
+            if (removed.second == 0) {
+                current->added.append(lines);
+            } else {
+                current->modified.append(lines);
+            }
+        }
+    }
+}
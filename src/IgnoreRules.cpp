@@ -0,0 +1,198 @@
+#include "IgnoreRules.h"
+#include <QFile>
+#include <QDir>
+
+namespace {
+
+// Matches one character against the class starting at pattern[p] == '['.
+// Returns the index after ']' or -1 if the class is malformed (then '[' is literal).
+qsizetype matchClass(QStringView pattern, qsizetype p, QChar c, bool &matched)
+{
+    qsizetype i = p + 1;
+    bool negate = false;
+    if (i < pattern.size() && (pattern[i] == '!' || pattern[i] == '^')) {
+        negate = true;
+        ++i;
+    }
+
+    bool found = false;
+    bool first = true;
+    while (i < pattern.size() && (first || pattern[i] != ']')) {
+        QChar low = pattern[i];
+        if (i + 2 < pattern.size() && pattern[i + 1] == '-' && pattern[i + 2] != ']') {
+            if (c >= low && c <= pattern[i + 2]) {
+                found = true;
+            }
+            i += 3;
+        } else {
+            if (c == low) {
+                found = true;
+            }
+            ++i;
+        }
+        first = false;
+    }
+    if (i >= pattern.size()) {
+        return -1;
+    }
+    matched = found != negate && c != '/';
+    return i + 1;
+}
+
+} // namespace
+
+bool globMatch(QStringView pattern, QStringView text)
+{
+    qsizetype p = 0;
+    qsizetype t = 0;
+    while (p < pattern.size()) {
+        QChar c = pattern[p];
+
+        if (c == '*') {
+            if (p + 1 < pattern.size() && pattern[p + 1] == '*') {
+                // "**/" matches zero or more directories, a trailing "**" matches everything
+                qsizetype rest = p + 2;
+                if (rest < pattern.size() && pattern[rest] == '/') {
+                    ++rest;
+                }
+                if (rest >= pattern.size()) {
+                    return true;
+                }
+                for (qsizetype i = t; i <= text.size(); ++i) {
+                    if ((i == t || text[i - 1] == '/') && globMatch(pattern.mid(rest), text.mid(i))) {
+                        return true;
+                    }
+                }
+                return false;
+            }
+
+            // '*' matches any run of characters within one path component
+            QStringView rest = pattern.mid(p + 1);
+            for (qsizetype i = t; i <= text.size(); ++i) {
+                if (globMatch(rest, text.mid(i))) {
+                    return true;
+                }
+                if (i < text.size() && text[i] == '/') {
+                    break;
+                }
+            }
+            return false;
+        }
+
+        if (t >= text.size()) {
+            return false;
+        }
+
+        if (c == '?') {
+            if (text[t] == '/') {
+                return false;
+            }
+        } else if (c == '[') {
+            bool matched = false;
+            qsizetype next = matchClass(pattern, p, text[t], matched);
+            if (next >= 0) {
+                if (!matched) {
+                    return false;
+                }
+                p = next;
+                ++t;
+                continue;
+            }
+            if (text[t] != c) {
+                return false;
+            }
+        } else {
+            if (c == '\\' && p + 1 < pattern.size()) {
+                c = pattern[++p];
+            }
+            if (text[t] != c) {
+                return false;
+            }
+        }
+        ++p;
+        ++t;
+    }
+    return t == text.size();
+}
+
+QSharedPointer<const IgnoreRules> IgnoreRules::forDirectory(const QString &directory,
+                                                            const QSharedPointer<const IgnoreRules> &parent)
+{
+    QFile file(QDir(directory).filePath(".gitignore"));
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        return parent; // Nothing new here, share the parent's rules
+    }
+
+    QSharedPointer<IgnoreRules> rules(new IgnoreRules);
+    rules->parent_ = parent;
+    rules->directory_ = QDir::cleanPath(directory) + '/';
+
+    while (!file.atEnd()) {
+        QString line = QString::fromUtf8(file.readLine());
+        while (line.endsWith('\n') || line.endsWith('\r')) {
+            line.chop(1);
+        }
+        // Trailing spaces are ignored unless escaped
+        while (line.endsWith(' ') && !line.endsWith("\\ ")) {
+            line.chop(1);
+        }
+        if (line.isEmpty() || line.startsWith('#')) {
+            continue;
+        }
+
+        Rule rule;
+        if (line.startsWith('!')) {
+            rule.negated = true;
+            line.remove(0, 1);
+        } else if (line.startsWith("\\!") || line.startsWith("\\#")) {
+            line.remove(0, 1);
+        }
+        if (line.endsWith('/')) {
+            rule.directoryOnly = true;
+            line.chop(1);
+        }
+        // A slash at the start or in the middle anchors the pattern to this directory
+        if (line.startsWith('/')) {
+            rule.anchored = true;
+            line.remove(0, 1);
+        } else if (line.contains('/')) {
+            rule.anchored = true;
+        }
+        if (line.isEmpty()) {
+            continue;
+        }
+
+        rule.pattern = line;
+        rules->rules_.append(rule);
+    }
+
+    if (rules->rules_.isEmpty()) {
+        return parent;
+    }
+    return rules;
+}
+
+bool IgnoreRules::isIgnored(const QString &absolutePath, bool isDirectory) const
+{
+    return match(absolutePath, isDirectory) == 1;
+}
+
+int IgnoreRules::match(const QString &absolutePath, bool isDirectory) const
+{
+    if (absolutePath.startsWith(directory_)) {
+        QStringView relativePath = QStringView(absolutePath).mid(directory_.size());
+        QStringView fileName = relativePath.mid(relativePath.lastIndexOf('/') + 1);
+
+        // Later rules override earlier ones, and this directory overrides its parents
+        for (qsizetype i = rules_.size() - 1; i >= 0; --i) {
+            const Rule &rule = rules_[i];
+            if (rule.directoryOnly && !isDirectory) {
+                continue;
+            }
+            if (globMatch(rule.pattern, rule.anchored ? relativePath : fileName)) {
+                return rule.negated ? 0 : 1;
+            }
+        }
+    }
+    return parent_ ? parent_->match(absolutePath, isDirectory) : -1;
+}
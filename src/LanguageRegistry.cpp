@@ -0,0 +1,65 @@
+#include "LanguageRegistry.h"
+#include <QFileInfo>
+#include <QHash>
+
+namespace {
+
+const LanguageSyntax *const AllLanguages[] = {
+    &CppSyntax, &PythonSyntax, &TypeScriptSyntax, &JavaScriptSyntax, &RustSyntax,
+    &GoSyntax, &JavaSyntax, &CSharpSyntax, &ShellSyntax, &CMakeSyntax,
+};
+
+struct Lookup {
+    QHash<QString, Language> byFileName;
+    QHash<QString, Language> byExtension;
+    QStringList nameFilters;
+
+    Lookup()
+    {
+        for (const LanguageSyntax *syntax : AllLanguages) {
+            for (const QString &name : QString::fromLatin1(syntax->fileNames).split(' ', Qt::SkipEmptyParts)) {
+                byFileName.insert(name, syntax->language);
+                nameFilters.append(name);
+            }
+            for (const QString &extension : QString::fromLatin1(syntax->extensions).split(' ', Qt::SkipEmptyParts)) {
+                byExtension.insert(extension, syntax->language);
+                nameFilters.append("*." + extension);
+            }
+        }
+    }
+};
+
+// Built once, on first use from any thread
+const Lookup &lookup()
+{
+    static const Lookup instance;
+    return instance;
+}
+
+} // namespace
+
+Language LanguageRegistry::forFile(const QString &filePath)
+{
+    const QFileInfo info(filePath);
+    const Lookup &tables = lookup();
+    auto byName = tables.byFileName.constFind(info.fileName());
+    if (byName != tables.byFileName.constEnd()) {
+        return byName.value();
+    }
+    return tables.byExtension.value(info.suffix().toLower(), Language::Python);
+}
+
+const LanguageSyntax &LanguageRegistry::syntax(Language language)
+{
+    for (const LanguageSyntax *syntax : AllLanguages) {
+        if (syntax->language == language) {
+            return *syntax;
+        }
+    }
+    return PythonSyntax;
+}
+
+QStringList LanguageRegistry::nameFilters()
+{
+    return lookup().nameFilters;
+}
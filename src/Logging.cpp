@@ -0,0 +1,7 @@
+#include "Logging.h"
+
+Q_LOGGING_CATEGORY(lcCache, "ccp.cache", QtWarningMsg)
+Q_LOGGING_CATEGORY(lcExtract, "ccp.extract", QtWarningMsg)
+Q_LOGGING_CATEGORY(lcSave, "ccp.save", QtWarningMsg)
+Q_LOGGING_CATEGORY(lcSource, "ccp.source", QtWarningMsg)
+Q_LOGGING_CATEGORY(lcUi, "ccp.ui", QtWarningMsg)
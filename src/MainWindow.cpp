@@ -3,15 +3,29 @@
 #include "CommentExtractor.h"
 #include "CommentSaver.h"
 #include <QFileDialog>
-#include <QTableWidgetItem>
-#include <QDebug>
 #include <QMessageBox>
-#include <QScrollArea>
-#include <QVBoxLayout>
-#include <QLabel>
-#include <QFrame>
-#include <QFileInfo>
+#include <QHeaderView>
+#include <QTreeView>
 #include <QTextEdit>
+#include <QDeadlineTimer>
+#include <QElapsedTimer>
+#include <QStatusBar>
+#include <QProgressBar>
+#include <QInputDialog>
+#include <QFileInfo>
+#include <QFileSystemWatcher>
+#include <QTimer>
+#include <QLineEdit>
+#include <QCheckBox>
+#include <QComboBox>
+#include <QDir>
+#include <QDialogButtonBox>
+#include <QFormLayout>
+#include "DiffPreviewDialog.h"
+#include "MetricsDialog.h"
+#include "Logging.h"
+#include "ResourceUsage.h"
+#include "Trace.h"
 
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent)
@@ -19,397 +33,849 @@ MainWindow::MainWindow(QWidget *parent)
 {
     ui->setupUi(this);
 
-    QScrollArea *scrollArea = new QScrollArea();
-    QWidget *scrollWidget = new QWidget();
-    QVBoxLayout *scrollLayout = new QVBoxLayout(scrollWidget);
-    
-    scrollWidget->setLayout(scrollLayout);
-    scrollArea->setWidget(scrollWidget);
-    scrollArea->setWidgetResizable(true);
-    scrollArea->setSizePolicy(QSizePolicy::Expanding, QSizePolicy::Preferred);
-    
-    QVBoxLayout *mainLayout = qobject_cast<QVBoxLayout*>(ui->centralwidget->layout());
-    if (mainLayout) {
-        // Remove the old table
-        mainLayout->removeWidget(ui->commentsTable);
-        delete ui->commentsTable;
-        
-        // Add the scroll area with dynamic sizing
-        mainLayout->addWidget(scrollArea, 1); // Give it stretch factor 1
-        // Let scroll area take available space
-        
-        // Store references
-        scrollArea_ = scrollArea;
-        scrollWidget_ = scrollWidget;
-        scrollLayout_ = scrollLayout;
+    // One virtualized tree for all files: file rows with their comment groups as children
+    commentModel_ = new CommentTreeModel(this);
+    filterModel_ = new CommentFilterModel(this);
+    filterModel_->setSourceModel(commentModel_);
+    QTreeView *view = ui->commentsView;
+    view->setModel(filterModel_);
+    view->setItemDelegateForColumn(CommentTreeModel::CommentColumn, new MultiLineTextDelegate(view));
+    view->setEditTriggers(QAbstractItemView::DoubleClicked | QAbstractItemView::AnyKeyPressed);
+    view->setWordWrap(true);
+    view->setUniformRowHeights(false); // Heights come from the model's cached size hints
+    view->header()->setSectionResizeMode(CommentTreeModel::LineColumn, QHeaderView::Interactive);
+    view->header()->setStretchLastSection(true);
+    view->setColumnWidth(CommentTreeModel::LineColumn, 90);
+    
+    // Extraction progress lives in the status bar and is only shown while loading
+    progressBar_ = new QProgressBar();
+    progressBar_->setMaximumWidth(200);
+    progressBar_->hide();
+    cancelButton_ = new QPushButton(tr("Cancel"));
+    cancelButton_->hide();
+    statusBar()->addPermanentWidget(progressBar_);
+    statusBar()->addPermanentWidget(cancelButton_);
+    
+    extractionPipeline_ = new ExtractionPipeline(this);
+    connect(extractionPipeline_, &ExtractionPipeline::fileExtracted, this, &MainWindow::handleFileExtracted);
+    connect(extractionPipeline_, &ExtractionPipeline::progressChanged, this, [this](int completed, int total) {
+        progressBar_->setRange(0, total);
+        progressBar_->setValue(completed);
+    });
+    connect(extractionPipeline_, &ExtractionPipeline::finished, this, &MainWindow::handleExtractionFinished);
+    
+    // Saves run as one background transaction; progress counts each file written, then committed
+    savePipeline_ = new SavePipeline(this);
+    connect(savePipeline_, &SavePipeline::progressChanged, this, [this](int completed, int total, const QString &filePath) {
+        progressBar_->setRange(0, total);
+        progressBar_->setValue(std::max(progressBar_->value(), completed)); // Workers report out of order
+        statusBar()->showMessage(QString("Saving %1").arg(QFileInfo(filePath).fileName()));
+    });
+    connect(savePipeline_, &SavePipeline::finished, this, &MainWindow::handleSaveFinished);
+    connect(savePipeline_, &SavePipeline::previewReady, this, &MainWindow::handlePreviewReady);
+    populateTimer_ = new QTimer(this);
+    populateTimer_->setInterval(0); // One batch per event loop pass
+    connect(populateTimer_, &QTimer::timeout, this, &MainWindow::populatePendingFiles);
+    
+    directoryScanner_ = new DirectoryScanner(this);
+    connect(directoryScanner_, &DirectoryScanner::fileFound, extractionPipeline_, &ExtractionPipeline::enqueue);
+    connect(directoryScanner_, &DirectoryScanner::finished, this, [this](bool cancelled) {
+        if (!cancelled) {
+            extractionPipeline_->finishInput();
+        }
+    });
+    
+    // Loaded files are watched; only files whose content hash changed are re-extracted
+    fileWatcher_ = new QFileSystemWatcher(this);
+    reloadTimer_ = new QTimer(this);
+    reloadTimer_->setSingleShot(true);
+    reloadTimer_->setInterval(300);
+    reloadPipeline_ = new ExtractionPipeline(this);
+    connect(fileWatcher_, &QFileSystemWatcher::fileChanged, this, &MainWindow::handleFileChanged);
+    connect(reloadTimer_, &QTimer::timeout, this, &MainWindow::reloadChangedFiles);
+    connect(reloadPipeline_, &ExtractionPipeline::fileExtracted, this, &MainWindow::handleFileReloaded);
+    
+    // Unchanged files are served from the on-disk cache of the previous session
+    commentCache_.load();
+    extractionPipeline_->setCache(&commentCache_);
+    reloadPipeline_->setCache(&commentCache_);
+    
+    // Metrics are computed next to extraction and kept current as files are reloaded
+    extractionPipeline_->setComputeMetrics(true);
+    reloadPipeline_->setComputeMetrics(true);
+    
+    // Past the memory budget, clean files the view is not showing are evicted and
+    // loaded again through the cache when scrolled to; CCP_MEMORY_BUDGET_MB=0 keeps all
+    fileLoader_.setCache(&commentCache_);
+    commentModel_->setFileLoader([this](const QString &filePath) { return fileLoader_.extractFile(filePath); });
+    bool budgetSet = false;
+    const int budgetMb = qEnvironmentVariableIntValue("CCP_MEMORY_BUDGET_MB", &budgetSet);
+    if (budgetSet) {
+        commentModel_->setMemoryBudget(qsizetype(budgetMb) * 1024 * 1024);
     }
+    
+    connect(cancelButton_, &QPushButton::clicked, this, [this]() {
+        directoryScanner_->cancel();
+        extractionPipeline_->cancel();
+    });
+    
+    // Filtering searches the model's comment index; typing is debounced
+    ui->tagFilterCombo->addItem(tr("All comments"));
+    ui->tagFilterCombo->addItem(tr("Any tag"));
+    ui->tagFilterCombo->addItems(CommentIndex::knownTags());
+    filterTimer_ = new QTimer(this);
+    filterTimer_->setSingleShot(true);
+    filterTimer_->setInterval(150);
+    connect(filterTimer_, &QTimer::timeout, this, &MainWindow::applyFilter);
+    connect(ui->filterEdit, &QLineEdit::textChanged, filterTimer_, qOverload<>(&QTimer::start));
+    connect(ui->regexCheckBox, &QCheckBox::toggled, this, &MainWindow::applyFilter);
+    connect(ui->tagFilterCombo, &QComboBox::currentIndexChanged, this, &MainWindow::applyFilter);
+    connect(commentModel_, &CommentTreeModel::searchCompleted, this, &MainWindow::handleSearchCompleted);
+    connect(commentModel_, &CommentTreeModel::editRefused, this, [this](const QString &reason) {
+        statusBar()->showMessage(reason);
+    });
+    
+    // Files loaded or reloaded while a filter is active are searched again. Edits are
+    // not: a group edited so it no longer matches stays put until the next search
+    connect(commentModel_, &QAbstractItemModel::rowsInserted, this, [this]() {
+        if (filterModel_->isFiltering()) {
+            filterTimer_->start();
+        }
+    });
 }
 
 MainWindow::~MainWindow()
 {
+    // Workers use the cache, so stop them before it is saved and destroyed; a
+    // running save is finished first
+    gitPool_.waitForDone();
+    replacePool_.waitForDone();
+    delete savePipeline_;
+    delete extractionPipeline_;
+    delete reloadPipeline_;
+    commentCache_.save();
     delete ui;
 }
 
 void MainWindow::on_openFileButton_clicked()
 {
-    static int callCount = 0;
-    qDebug() << "on_openFileButton_clicked called - ENTRY #" << ++callCount;
     QStringList fileNames = QFileDialog::getOpenFileNames(this,
                                                           tr("Open Code File(s)"),
                                                           QString(),
-                                                          tr("Code Files (*.cpp *.h *.py *.ts)"));
+                                                          tr("Code Files (%1)").arg(CommentExtractor::supportedNameFilters().join(' ')));
 
     if (!fileNames.isEmpty()) {
-        // Clear existing data
-        loadedFilePaths.clear();
-        fileCommentGroups.clear();
-        
-        // Clear the scroll area
-        QLayoutItem *child;
-        while ((child = scrollLayout_->takeAt(0)) != nullptr) {
-            delete child->widget();
-            delete child;
-        }
-        
-        CommentExtractor extractor;
-        
-        // Process each selected file
-        for (int i = 0; i < fileNames.size(); ++i) {
-            const QString &filePath = fileNames[i];
-            loadedFilePaths.append(filePath);
-            QList<CommentGroup> commentGroups = extractor.extractGroupedComments(filePath);
-            fileCommentGroups.append(commentGroups);
-            
-            // Create file section
-            createFileSection(filePath, commentGroups, i < fileNames.size() - 1);
-        }
+        qCDebug(lcUi) << "Opening" << fileNames.size() << "files";
+        beginLoading();
         
-        // Decide between natural Qt sizing vs constrained sizing based on content
-        adjustScrollAreaSizeIntelligently();
+        // Extract on the worker pool; file rows are added as results arrive in file order
+        extractionPipeline_->start(fileNames);
     }
 }
 
-void MainWindow::on_saveFileButton_clicked()
+void MainWindow::on_openFolderButton_clicked()
 {
-    static int saveCallCount = 0;
-    qDebug() << "on_saveFileButton_clicked called - ENTRY #" << ++saveCallCount;
-    if (loadedFilePaths.isEmpty()) {
-        QMessageBox::warning(this, "No Files Selected", "Please open files first before saving.");
+    QString folder = QFileDialog::getExistingDirectory(this, tr("Open Folder"));
+    if (folder.isEmpty()) {
+        return;
+    }
+    
+    bool ok = false;
+    QString extraPatterns = QInputDialog::getText(this, tr("Open Folder"),
+                                                  tr("Additional file patterns, space separated (prefix with ! to exclude):"),
+                                                  QLineEdit::Normal, QString(), &ok);
+    if (!ok) {
         return;
     }
+    
+    qCDebug(lcUi) << "Opening folder" << folder;
+    beginLoading();
+    
+    // The walk streams files into the pipeline as it finds them
+    extractionPipeline_->begin();
+    directoryScanner_->setNameFilters(CommentExtractor::supportedNameFilters() + extraPatterns.split(' ', Qt::SkipEmptyParts));
+    directoryScanner_->start(folder);
+}
 
-    CommentSaver saver;
-    int successCount = 0;
+void MainWindow::on_openChangedButton_clicked()
+{
+    QString folder = QFileDialog::getExistingDirectory(this, tr("Open Changed Files in Repository"));
+    if (folder.isEmpty()) {
+        return;
+    }
     
-    // Save all files
-    for (int fileIndex = 0; fileIndex < loadedFilePaths.size(); ++fileIndex) {
-        QList<QPair<int, QString>> modifiedComments = getModifiedCommentsForFile(fileIndex);
-        
-        qDebug() << "File" << fileIndex << ":" << loadedFilePaths[fileIndex];
-        qDebug() << "Modified comments count:" << modifiedComments.size();
-        for (const auto &comment : modifiedComments) {
-            qDebug() << "Line" << comment.first << ":" << comment.second;
-        }
-        
-        if (saver.saveCommentsWithMultiLine(loadedFilePaths[fileIndex], modifiedComments)) {
-            successCount++;
-        } else {
-            qWarning() << "Failed to save:" << loadedFilePaths[fileIndex];
-        }
+    bool ok = false;
+    QString revision = QInputDialog::getText(this, tr("Open Changed Files"),
+                                             tr("Compare the working tree with revision (HEAD for uncommitted changes, main... for the current branch):"),
+                                             QLineEdit::Normal, "HEAD", &ok).trimmed();
+    if (!ok) {
+        return;
     }
     
-    if (successCount == loadedFilePaths.size()) {
-        QMessageBox::information(this, "Save Successful", 
-            QString("All %1 files saved successfully!").arg(successCount));
-    } else {
-        QMessageBox::warning(this, "Partial Save", 
-            QString("Saved %1 out of %2 files. Check logs for details.")
-            .arg(successCount).arg(loadedFilePaths.size()));
+    // git runs off the GUI thread; only the changed files are extracted afterwards
+    ui->openChangedButton->setEnabled(false);
+    statusBar()->showMessage(QString("Reading changes since %1...").arg(revision));
+    gitPool_.start([this, folder, revision]() {
+        QSharedPointer<GitChanges> changes(new GitChanges);
+        const bool loaded = changes->load(folder, revision);
+        QMetaObject::invokeMethod(this, [this, changes, loaded]() {
+            if (saving_) {
+                return; // A save started meanwhile; it re-enables the buttons when done
+            }
+            ui->openChangedButton->setEnabled(true);
+            if (!loaded) {
+                QMessageBox::warning(this, "Open Changed Files", changes->errorString());
+                statusBar()->clearMessage();
+                return;
+            }
+            
+            QStringList files;
+            const QStringList nameFilters = CommentExtractor::supportedNameFilters();
+            for (const QString &filePath : changes->files()) {
+                if (QDir::match(nameFilters, QFileInfo(filePath).fileName())) {
+                    files.append(filePath);
+                }
+            }
+            files.sort();
+            qCDebug(lcUi) << "Opening" << files.size() << "files changed since" << changes->revision();
+            beginLoading();
+            gitChanges_ = changes;
+            extractionPipeline_->start(files);
+        }, Qt::QueuedConnection);
+    });
+}
+
+void MainWindow::beginLoading()
+{
+    // Stop a load that is still running before its results are discarded
+    directoryScanner_->cancel();
+    extractionPipeline_->cancel();
+    
+    // Clear existing data
+    reloadTimer_->stop();
+    reloadPipeline_->cancel();
+    changedPaths_.clear();
+    savedPaths_.clear();
+    keptEdits_.clear();
+    if (!fileWatcher_->files().isEmpty()) {
+        fileWatcher_->removePaths(fileWatcher_->files());
     }
+    unwatchedFileCount_ = 0;
+    populateTimer_->stop();
+    pendingFiles_.clear();
+    pendingHead_ = 0;
+    extractionDone_ = false;
+    gitChanges_.reset();
+    commentModel_->clear();
+    metrics_.clear();
+    if (metricsDialog_) {
+        metricsDialog_->reset();
+    }
+    
+    loadTimer_.start();
+    loadTraceStart_ = Trace::now();
+    loadedGroupCount_ = 0;
+    ui->saveFileButton->setEnabled(false);
+    progressBar_->setRange(0, 0);
+    progressBar_->setValue(0);
+    progressBar_->show();
+    cancelButton_->show();
 }
 
-void MainWindow::createFileSection(const QString &filePath, const QList<CommentGroup> &commentGroups, bool addSeparator)
+void MainWindow::handleFileExtracted(int index, const FileComments &file)
 {
-    // File name label
-    QFileInfo fileInfo(filePath);
-    QLabel *fileLabel = new QLabel(fileInfo.fileName());
-    fileLabel->setStyleSheet("font-weight: bold; font-size: 14px; margin: 10px 0px 5px 0px;");
-    scrollLayout_->addWidget(fileLabel);
-    
-    // Comments table for this file
-    QTableWidget *table = new QTableWidget();
-    table->setColumnCount(2);
-    table->setHorizontalHeaderLabels({"Line", "Comment"});
-    
-    // Set column sizing - Line column fits content, Comment column takes remaining space
-    table->horizontalHeader()->setSectionResizeMode(0, QHeaderView::ResizeToContents);
-    table->horizontalHeader()->setSectionResizeMode(1, QHeaderView::Stretch);
-    table->setEditTriggers(QAbstractItemView::DoubleClicked | QAbstractItemView::AnyKeyPressed);
-    
-    // Hide row numbers/indexes
-    table->verticalHeader()->setVisible(false);
-    
-    // Enable word wrap for better multi-line display
-    table->setWordWrap(true);
-    
-    // Set custom delegate for multi-line editing in the comment column
-    MultiLineTextDelegate *delegate = new MultiLineTextDelegate(table);
-    table->setItemDelegateForColumn(1, delegate);
-    
-    // Set table properties
-    table->setProperty("fileIndex", loadedFilePaths.size() - 1);
-    
-    // Populate table with grouped comments
-    for (const auto &group : commentGroups) {
-        int row = table->rowCount();
-        table->insertRow(row);
-        
-        // Set line range in first column - Right Aligned
-        QTableWidgetItem *lineItem = new QTableWidgetItem(group.getLineRange());
-        lineItem->setTextAlignment(Qt::AlignRight | Qt::AlignVCenter);
-        lineItem->setFlags(lineItem->flags() & ~Qt::ItemIsEditable);
-        table->setItem(row, 0, lineItem);
+    Q_UNUSED(index)
+    // Results can arrive far faster than rows can be built; queue them for the next batch
+    pendingFiles_.append(file);
+    if (!populateTimer_->isActive()) {
+        populateTimer_->start();
+    }
+}
+
+void MainWindow::populatePendingFiles()
+{
+    TraceSpan span("populate");
+    const QDeadlineTimer frame(PopulateBudgetMs);
+    
+    // Add file rows until the batch has used its share of the frame; the rest wait
+    // for the next pass, after pending paints, scrolling and edits have run
+    QStringList watchPaths;
+    int taken = 0;
+    while (pendingHead_ < pendingFiles_.size() && (taken == 0 || !frame.hasExpired())) {
+        const FileComments &file = pendingFiles_.at(pendingHead_++);
+        ++taken;
+        loadedGroupCount_ += file.groupCount();
         
-        // Set combined comments in second column
-        table->setItem(row, 1, new QTableWidgetItem(group.getCombinedComments()));
+        // The view only builds the rows it shows
+        int fileRow = commentModel_->appendFile(file, gitChanges_ ? gitChanges_->changesFor(file.filePath) : nullptr);
+        const QModelIndex fileIndex = filterModel_->mapFromSource(commentModel_->index(fileRow, 0));
+        if (fileIndex.isValid()) {
+            ui->commentsView->setFirstColumnSpanned(fileIndex.row(), QModelIndex(), true);
+            ui->commentsView->expand(fileIndex);
+        }
+        metrics_.setFile(file.filePath, file.metrics);
+        watchPaths.append(file.filePath);
+    }
+    // Added files are indexed in what is left of the frame; a large one takes several
+    const bool indexed = commentModel_->indexPending(frame);
+    
+    // Consumed files are dropped in one go once they are half the queue, so each
+    // file is moved at most once more however the results arrive
+    if (pendingHead_ == pendingFiles_.size()) {
+        pendingFiles_.clear();
+        pendingHead_ = 0;
+    } else if (pendingHead_ > pendingFiles_.size() / 2) {
+        pendingFiles_.remove(0, pendingHead_);
+        pendingHead_ = 0;
     }
     
-    // Set table height to exactly fit content (accounting for multi-line comments)
-    int headerHeight = table->horizontalHeader()->height();
-    int totalHeight = headerHeight + 2; // Start with header + borders
+    // Files the watcher rejects usually hit the inotify watch limit
+    unwatchedFileCount_ += fileWatcher_->addPaths(watchPaths).size();
     
-    for (int row = 0; row < table->rowCount(); ++row) {
-        // Calculate height needed for multi-line comments
-        QString commentText = table->item(row, 1)->text();
-        int lineCount = commentText.split('\n').size();
-        int rowHeight = std::max(25, lineCount * 20); // Minimum 25px, 20px per line
-        table->setRowHeight(row, rowHeight);
-        totalHeight += rowHeight;
+    if (pendingFiles_.isEmpty() && indexed) {
+        populateTimer_->stop();
+        if (extractionDone_) {
+            finishLoading();
+        }
+    }
+}
+
+void MainWindow::handleFileChanged(const QString &filePath)
+{
+    // Editors often write several times in a row; collect and reload once things settle
+    changedPaths_.insert(filePath);
+    reloadTimer_->start();
+}
+
+void MainWindow::reloadChangedFiles()
+{
+    if (reloadPipeline_->isRunning()) {
+        reloadTimer_->start(); // Try again after the current reload
+        return;
     }
     
-    int tableHeight = totalHeight;
+    QStringList paths;
+    for (const QString &filePath : std::as_const(changedPaths_)) {
+        // Files replaced by rename drop out of the watcher, so watch the new file
+        if (QFileInfo::exists(filePath) && commentModel_->rowForPath(filePath) >= 0) {
+            fileWatcher_->addPath(filePath);
+            paths.append(filePath);
+        }
+    }
+    changedPaths_.clear();
     
-    table->setFixedHeight(tableHeight);
-    table->setSizePolicy(QSizePolicy::Expanding, QSizePolicy::Fixed);
+    if (!paths.isEmpty()) {
+        reloadPipeline_->start(paths);
+    }
+}
+
+void MainWindow::handleFileReloaded(int index, const FileComments &file)
+{
+    Q_UNUSED(index)
+    int fileRow = commentModel_->rowForPath(file.filePath);
+    bool justSaved = savedPaths_.remove(file.filePath);
+    if (fileRow < 0 || file.contentHash == commentModel_->contentHash(fileRow)) {
+        return; // Touched but not changed
+    }
     
-    scrollLayout_->addWidget(table);
+    // Never overwrite edits the user has not saved; edits in other files are never touched
+    if (commentModel_->isDirty(fileRow) && !justSaved) {
+        commentModel_->setChangedOnDisk(fileRow, true);
+        statusBar()->showMessage(QString("%1 changed on disk; unsaved edits kept").arg(QFileInfo(file.filePath).fileName()));
+        return;
+    }
     
-    // Add separator line if needed
-    if (addSeparator) {
-        QFrame *separator = new QFrame();
-        separator->setFrameShape(QFrame::HLine);
-        separator->setFrameShadow(QFrame::Sunken);
-        separator->setStyleSheet("margin: 15px 0px 10px 0px;");
-        scrollLayout_->addWidget(separator);
+    commentModel_->replaceFile(fileRow, file);
+    metrics_.updateFile(file.filePath, file.metrics);
+    if (metricsDialog_) {
+        metricsDialog_->updateFile(file.filePath);
     }
+    const QList<KeptEdit> kept = justSaved ? keptEdits_.take(file.filePath) : QList<KeptEdit>();
+    if (!kept.isEmpty()) {
+        const int restored = restoreKeptEdits(fileRow, kept);
+        QString message = QString("Saved %1; %2 rejected edits kept unsaved").arg(QFileInfo(file.filePath).fileName()).arg(restored);
+        if (restored < kept.size()) {
+            message += QString(", %1 no longer found").arg(kept.size() - restored);
+        }
+        statusBar()->showMessage(message);
+        return;
+    }
+    statusBar()->showMessage(QString("Reloaded %1").arg(QFileInfo(file.filePath).fileName()));
 }
 
-QList<QPair<int, QString>> MainWindow::getModifiedCommentsForFile(int fileIndex)
+// Edits a just saved file's groups again with the text of its rejected hunks. Those
+// lines were not written, so each group is found by its text, the nearest one to where
+// it was, since the accepted edits above it may have moved it. Returns the number placed.
+int MainWindow::restoreKeptEdits(int fileRow, const QList<KeptEdit> &kept)
 {
-    QList<QPair<int, QString>> modifiedComments;
-    
-    qDebug() << "Getting modified comments for file index:" << fileIndex;
-    qDebug() << "Total layout items:" << scrollLayout_->count();
-    
-    // Find the table widget for this file
-    // Pattern: label, table, separator (except for last file)
-    // File 0: positions 0,1,2  File 1: positions 3,4,5  etc.
-    // But last file doesn't have separator, so we need to count actual widgets
-    int tableIndex = -1;
-    int currentFile = 0;
-    
-    for (int i = 0; i < scrollLayout_->count(); ++i) {
-        QLayoutItem *item = scrollLayout_->itemAt(i);
-        if (item && item->widget()) {
-            QString widgetType = item->widget()->metaObject()->className();
-            qDebug() << "Layout item" << i << ":" << widgetType;
-            
-            QTableWidget *table = qobject_cast<QTableWidget*>(item->widget());
-            if (table) {
-                qDebug() << "Found table at index" << i << "for file" << currentFile;
-                if (currentFile == fileIndex) {
-                    tableIndex = i;
-                    break;
-                }
-                currentFile++;
+    const QModelIndex fileIndex = commentModel_->index(fileRow, 0);
+    QSet<int> used;
+    int restored = 0;
+    for (const KeptEdit &edit : kept) {
+        int best = -1;
+        for (int groupRow = 0; groupRow < commentModel_->groupCount(fileRow); ++groupRow) {
+            const CommentGroup group = commentModel_->group(fileRow, groupRow);
+            if (used.contains(groupRow) || group.getCombinedComments() != edit.originalText) {
+                continue;
             }
-        }
-    }
-    
-    qDebug() << "Selected table index:" << tableIndex;
-    
-    if (tableIndex < scrollLayout_->count()) {
-        QLayoutItem *item = scrollLayout_->itemAt(tableIndex);
-        if (item && item->widget()) {
-            QTableWidget *table = qobject_cast<QTableWidget*>(item->widget());
-            if (table && fileIndex < fileCommentGroups.size()) {
-                const QList<CommentGroup> &originalGroups = fileCommentGroups[fileIndex];
-                
-                for (int row = 0; row < table->rowCount(); ++row) {
-                    if (row < originalGroups.size()) {
-                        const CommentGroup &originalGroup = originalGroups[row];
-                        QString modifiedText = table->item(row, 1)->text();
-                        qDebug() << "Row" << row << "original lines:" << originalGroup.lineNumbers;
-                        qDebug() << "Row" << row << "modified text:" << modifiedText;
-                        QStringList modifiedLines = modifiedText.split('\n');
-                        qDebug() << "Row" << row << "split into" << modifiedLines.size() << "lines:" << modifiedLines;
-                        
-                        // Map each modified comment line back to its original line number
-                        // Handle both existing lines and new lines that were added
-                        for (int i = 0; i < modifiedLines.size(); ++i) {
-                            QString commentToSave;
-                            int lineNumber;
-                            
-                            if (i < originalGroup.lineNumbers.size()) {
-                                // This is an existing line being modified
-                                lineNumber = originalGroup.lineNumbers[i];
-                                
-                                // Check if this was an inline comment
-                                if (i < originalGroup.isInline.size() && originalGroup.isInline[i]) {
-                                    // For inline comments, extract just the comment part from the full line
-                                    QString modifiedFullLine = modifiedLines[i];
-                                    commentToSave = extractCommentFromFullLine(modifiedFullLine);
-                                } else {
-                                    // For standalone comments, use the text as-is
-                                    commentToSave = modifiedLines[i];
-                                }
-                            } else {
-                                // This is a new line being added after the original group
-                                // Insert immediately after the last line of the current group
-                                int lastOriginalLine = originalGroup.lineNumbers.last();
-                                
-                                // Use special notation: encode as decimal: -(lastLine * 1000 + offset)
-                                int offset = i - originalGroup.lineNumbers.size(); // 0, 1, 2, etc.
-                                lineNumber = -(lastOriginalLine * 1000 + offset + 1);
-                                commentToSave = modifiedLines[i];
-                                
-                                qDebug() << "Adding new comment line after line" << lastOriginalLine << "with offset" << offset << ":" << commentToSave;
-                                qDebug() << "Using special line number" << lineNumber;
-                            }
-                            
-                            modifiedComments.append(qMakePair(lineNumber, commentToSave));
-                        }
-                    }
-                }
+            const int distance = qAbs(group.lineNumber(0) - edit.firstLine);
+            if (best < 0 || distance < qAbs(commentModel_->group(fileRow, best).lineNumber(0) - edit.firstLine)) {
+                best = groupRow;
             }
         }
+        if (best >= 0) {
+            used.insert(best);
+            commentModel_->setData(commentModel_->index(best, CommentTreeModel::CommentColumn, fileIndex),
+                                   edit.editedText, Qt::EditRole);
+            ++restored;
+        }
     }
-    
-    return modifiedComments;
+    return restored;
 }
 
-QString MainWindow::extractCommentFromFullLine(const QString &fullLine)
+void MainWindow::handleExtractionFinished(bool cancelled)
 {
-    // Extract just the comment part from a full line of code
-    
-    // Check for Python style comments (#)
-    int pythonCommentPos = fullLine.indexOf("#");
-    if (pythonCommentPos >= 0) {
-        return fullLine.mid(pythonCommentPos + 1).trimmed();
+    extractionDone_ = true;
+    extractionCancelled_ = cancelled;
+    if (cancelled) {
+        populateTimer_->stop();
+        pendingFiles_.clear();
+        pendingHead_ = 0;
     }
-    
-    // Check for C++ style comments (//)
-    int cppCommentPos = fullLine.indexOf("//");
-    if (cppCommentPos >= 0) {
-        return fullLine.mid(cppCommentPos + 2).trimmed();
+    // Loading ends once the last queued batch is in the model and indexed; a search
+    // before that indexes the rest first
+    if (cancelled || (pendingFiles_.isEmpty() && !commentModel_->hasPendingIndex())) {
+        finishLoading();
     }
-    
-    // Check for C-style comments (/* */)
-    int cStyleStart = fullLine.indexOf("/*");
-    int cStyleEnd = fullLine.indexOf("*/");
-    if (cStyleStart >= 0 && cStyleEnd > cStyleStart) {
-        return fullLine.mid(cStyleStart + 2, cStyleEnd - cStyleStart - 2).trimmed();
+}
+
+void MainWindow::finishLoading()
+{
+    const bool cancelled = extractionCancelled_;
+    extractionDone_ = false;
+    Trace::record("open", loadTraceStart_, Trace::now());
+    progressBar_->hide();
+    cancelButton_->hide();
+    ui->saveFileButton->setEnabled(true);
+    if (!cancelled) {
+        commentCache_.save();
+    }
+    metrics_.rebuild();
+    if (metricsDialog_) {
+        metricsDialog_->reset();
     }
     
-    // If no comment markers found, return the full line (shouldn't happen for inline comments)
-    return fullLine.trimmed();
+    // Report load time and peak memory so large-file regressions are visible
+    QString message = QString("%1 %2 files, %3 comment groups in %4 ms (peak RSS %5 MiB, comments in memory %6 MiB)")
+                      .arg(cancelled ? "Cancelled after" : "Loaded")
+                      .arg(commentModel_->fileCount())
+                      .arg(loadedGroupCount_)
+                      .arg(loadTimer_.elapsed())
+                      .arg(peakResidentSetBytes() / (1024 * 1024))
+                      .arg(commentModel_->residentBytes() / (1024 * 1024));
+    if (unwatchedFileCount_ > 0) {
+        message += QString(" - %1 files not watched for changes").arg(unwatchedFileCount_);
+    }
+    statusBar()->showMessage(message);
 }
 
-void MainWindow::adjustScrollAreaSizeIntelligently()
+void MainWindow::applyFilter()
 {
-    if (!scrollArea_ || !scrollWidget_) return;
-    
-    // Force layout update to get accurate measurements
-    scrollWidget_->updateGeometry();
-    scrollLayout_->activate();
-    
-    // Calculate actual content height
-    int totalContentHeight = 0;
-    for (int i = 0; i < scrollLayout_->count(); ++i) {
-        QLayoutItem *item = scrollLayout_->itemAt(i);
-        if (item && item->widget()) {
-            QWidget *widget = item->widget();
-            widget->adjustSize();
-            totalContentHeight += widget->height();
+    filterTimer_->stop();
+    
+    CommentQuery query;
+    const QString text = ui->filterEdit->text();
+    if (ui->regexCheckBox->isChecked()) {
+        query.regex = QRegularExpression(text, QRegularExpression::CaseInsensitiveOption);
+        if (!query.regex.isValid()) {
+            statusBar()->showMessage(QString("Invalid regular expression: %1").arg(query.regex.errorString()));
+            return;
         }
+    } else {
+        query.text = text;
+    }
+    const int tagIndex = ui->tagFilterCombo->currentIndex();
+    if (tagIndex == 1) {
+        query.tags = CommentIndex::knownTags();
+    } else if (tagIndex > 1) {
+        query.tags = QStringList{ui->tagFilterCombo->currentText()};
     }
     
-    // Add layout margins and padding
-    totalContentHeight += scrollLayout_->contentsMargins().top() + scrollLayout_->contentsMargins().bottom();
-    totalContentHeight += scrollLayout_->spacing() * (scrollLayout_->count() - 1);
-    totalContentHeight += 40; // Extra padding
-    
-    // Calculate available space
-    int windowHeight = this->height();
-    int buttonAreaHeight = 80;
-    int availableHeight = windowHeight - buttonAreaHeight - 20; // 20px bottom margin
-    
-    // Get the main layout
-    QVBoxLayout *mainLayout = qobject_cast<QVBoxLayout*>(ui->centralwidget->layout());
-    if (!mainLayout) return;
+    if (query.isEmpty()) {
+        commentModel_->cancelSearch();
+        filterModel_->clearMatches();
+        showFileRows();
+        return;
+    }
     
-    // Decision: if content needs more than 60% of available space, let Qt expand naturally
-    // Otherwise, constrain size and add spacer
-    if (totalContentHeight > availableHeight * 0.6) {
-        // Sufficient content - using natural Qt expansion
-        
-        // Remove any existing spacer
-        for (int i = mainLayout->count() - 1; i >= 0; --i) {
-            QLayoutItem *item = mainLayout->itemAt(i);
-            if (item && !item->widget() && item->spacerItem()) {
-                mainLayout->removeItem(item);
-                delete item;
+    // Timed from the query to the filtered view, which is what the user waits for
+    searchTimer_.start();
+    const CommentMatches matches = commentModel_->search(query);
+    const qint64 searchMs = searchTimer_.elapsed();
+    filterModel_->setMatches(matches);
+    showFileRows();
+    const qint64 totalMs = searchTimer_.elapsed();
+    qCDebug(lcUi) << "Filter:" << totalMs << "ms, of which index search" << searchMs << "ms";
+    QString message = QString("%1 matching groups in %2 files (%3 ms, search %4 ms)")
+                      .arg(matches.groupCount).arg(matches.fileCount).arg(totalMs).arg(searchMs);
+    if (commentModel_->searchPendingFiles() > 0) {
+        message += QString("; searching %1 more files...").arg(commentModel_->searchPendingFiles());
+    }
+    statusBar()->showMessage(message);
+}
+
+// The files the index did not hold have been scanned; the view shows every match now
+void MainWindow::handleSearchCompleted(const CommentMatches &matches)
+{
+    filterModel_->setMatches(matches);
+    showFileRows();
+    const qint64 totalMs = searchTimer_.elapsed();
+    qCDebug(lcUi) << "Filter completed in" << totalMs << "ms";
+    statusBar()->showMessage(QString("%1 matching groups in %2 files (%3 ms)")
+                             .arg(matches.groupCount).arg(matches.fileCount).arg(totalMs));
+}
+
+void MainWindow::on_replaceButton_clicked()
+{
+    if (commentModel_->fileCount() == 0 || saving_) {
+        return;
+    }
+
+    QDialog dialog(this);
+    dialog.setWindowTitle(tr("Replace in Comments"));
+    QLineEdit *findEdit = new QLineEdit(ui->filterEdit->text());
+    QLineEdit *replaceEdit = new QLineEdit();
+    QCheckBox *regexBox = new QCheckBox(tr("Regular expression (\\1 inserts a capture)"));
+    regexBox->setChecked(ui->regexCheckBox->isChecked());
+    QCheckBox *caseBox = new QCheckBox(tr("Match case"));
+    caseBox->setChecked(true);
+    QDialogButtonBox *buttons = new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel);
+    connect(buttons, &QDialogButtonBox::accepted, &dialog, &QDialog::accept);
+    connect(buttons, &QDialogButtonBox::rejected, &dialog, &QDialog::reject);
+    QFormLayout *form = new QFormLayout(&dialog);
+    form->addRow(tr("Find:"), findEdit);
+    form->addRow(tr("Replace with:"), replaceEdit);
+    form->addRow(regexBox);
+    form->addRow(caseBox);
+    form->addRow(buttons);
+    if (dialog.exec() != QDialog::Accepted || findEdit->text().isEmpty()) {
+        return;
+    }
+
+    const CommentReplacer replacer(findEdit->text(), replaceEdit->text(),
+                                   regexBox->isChecked() ? CommentReplacer::Syntax::Regex : CommentReplacer::Syntax::Literal,
+                                   caseBox->isChecked() ? Qt::CaseSensitive : Qt::CaseInsensitive);
+    if (!replacer.isValid()) {
+        QMessageBox::warning(this, "Replace in Comments", "Invalid regular expression: " + replacer.errorString());
+        return;
+    }
+
+    // Counted over every loaded file first, off the GUI thread since evicted files are
+    // read again; edits are blocked meanwhile and nothing changes until it is confirmed
+    setSaving(true);
+    statusBar()->showMessage("Planning replacement...");
+    const ReplaceSnapshot snapshot = commentModel_->snapshotForReplace(replacer);
+    replacePool_.start([this, snapshot, replacer]() {
+        QElapsedTimer replaceTimer;
+        replaceTimer.start();
+        const ReplacePlan plan = CommentTreeModel::planReplace(snapshot, replacer);
+        const qint64 elapsedMs = replaceTimer.elapsed();
+        QMetaObject::invokeMethod(this, [this, plan, elapsedMs]() {
+            handleReplacePlanned(plan, elapsedMs);
+        }, Qt::QueuedConnection);
+    });
+}
+
+void MainWindow::handleReplacePlanned(const ReplacePlan &plan, qint64 elapsedMs)
+{
+    setSaving(false);
+    qCDebug(lcUi) << "Planned" << plan.matchCount << "replacements in" << elapsedMs << "ms";
+    const QString readOnlyNote = plan.readOnlyGroupCount == 0 ? QString()
+        : QString("%1 matching groups have a line with several comments and are left out; edit them in the source files.")
+          .arg(plan.readOnlyGroupCount);
+    if (plan.matchCount == 0) {
+        statusBar()->showMessage(readOnlyNote.isEmpty() ? QString("No matches in comments") : readOnlyNote);
+        return;
+    }
+    QString question = QString("Replace %1 matches in %2 comment groups across %3 files?\n\n"
+                               "The changes become unsaved edits; review them and use Save Changes to write them.")
+                       .arg(plan.matchCount).arg(plan.groupCount).arg(plan.fileCount);
+    if (!readOnlyNote.isEmpty()) {
+        question += "\n\n" + readOnlyNote;
+    }
+    if (QMessageBox::question(this, "Replace in Comments", question) != QMessageBox::Yes) {
+        statusBar()->clearMessage();
+        return;
+    }
+
+    // The replacements become ordinary edits and are saved with the others
+    const int skipped = commentModel_->applyReplace(plan);
+    QString message = QString("Replaced %1 matches in %2 files; not saved yet")
+                      .arg(plan.matchCount).arg(plan.fileCount - skipped);
+    if (skipped > 0) {
+        message += QString(" (%1 files changed on disk were left out)").arg(skipped);
+    }
+    statusBar()->showMessage(message);
+}
+
+void MainWindow::on_metricsButton_clicked()
+{
+    // Non-modal, so it can stay open next to the comments while files are edited and reloaded
+    if (!metricsDialog_) {
+        metricsDialog_ = new MetricsDialog(&metrics_, this);
+    }
+    metricsDialog_->show();
+    metricsDialog_->raise();
+    metricsDialog_->activateWindow();
+}
+
+void MainWindow::showFileRows()
+{
+    // Refiltering rebuilds the proxy rows, so file rows need their span and expansion again
+    for (int row = 0; row < filterModel_->rowCount(); ++row) {
+        ui->commentsView->setFirstColumnSpanned(row, QModelIndex(), true);
+        ui->commentsView->expand(filterModel_->index(row, 0));
+    }
+}
+
+void MainWindow::on_saveFileButton_clicked()
+{
+    if (commentModel_->fileCount() == 0) {
+        QMessageBox::warning(this, "No Files Selected", "Please open files first before saving.");
+        return;
+    }
+
+    if (saving_) {
+        return;
+    }
+
+    // Only files with committed edits are written; untouched files keep their mtime.
+    // Edits are anchored to line numbers, so each job carries the hash of the content
+    // they were made against and the saver refuses a file that has changed since.
+    QList<FileSaveJob> jobs;
+    QList<int> changedRows;
+    editGroups_.clear();
+    for (int fileRow : commentModel_->dirtyFiles()) {
+        if (commentModel_->isChangedOnDisk(fileRow)) {
+            changedRows.append(fileRow);
+            continue;
+        }
+        FileSaveJob job;
+        job.filePath = commentModel_->filePath(fileRow);
+        QList<int> groupRows;
+        job.edits = getModifiedCommentsForFile(fileRow, &groupRows);
+        editGroups_.insert(job.filePath, groupRows);
+        job.contentHash = commentModel_->contentHash(fileRow);
+        jobs.append(job);
+    }
+    if (!changedRows.isEmpty() && !resolveChangedOnDisk(changedRows, jobs.size())) {
+        return;
+    }
+    if (jobs.isEmpty()) {
+        statusBar()->showMessage("No unsaved changes");
+        return;
+    }
+
+    // Preview and save run in the background; editing and loading wait until both are
+    // done, so the edits in the model stay the ones being previewed and written
+    setSaving(true);
+    statusBar()->showMessage(QString("Preparing the changes of %1 files...").arg(jobs.size()));
+    savePipeline_->preview(jobs);
+}
+
+// Files that changed on disk while they had edits are never saved. Their edits can be
+// dropped for the new content, or kept (and left unsaved) to be copied over by hand.
+// Returns false if the save should not go ahead.
+bool MainWindow::resolveChangedOnDisk(const QList<int> &fileRows, int otherFiles)
+{
+    QStringList names;
+    for (int fileRow : fileRows) {
+        names.append(QDir::toNativeSeparators(commentModel_->filePath(fileRow)));
+    }
+    QMessageBox box(this);
+    box.setIcon(QMessageBox::Warning);
+    box.setWindowTitle("Files Changed on Disk");
+    box.setText(QString("%1 files with unsaved edits changed on disk since they were loaded. Their edits refer to "
+                        "lines that may have moved, so they cannot be saved.").arg(fileRows.size()));
+    box.setInformativeText(otherFiles > 0 ? QString("The other %1 modified files can still be saved.").arg(otherFiles)
+                                          : QString());
+    box.setDetailedText(names.join('\n'));
+    QPushButton *reloadButton = box.addButton("Discard Their Edits and Reload", QMessageBox::DestructiveRole);
+    QPushButton *keepButton = box.addButton(otherFiles > 0 ? "Keep Edits, Save the Others" : "Keep Edits",
+                                            QMessageBox::AcceptRole);
+    box.addButton(QMessageBox::Cancel);
+    box.setDefaultButton(keepButton);
+    box.exec();
+
+    if (box.clickedButton() == reloadButton) {
+        for (int fileRow : fileRows) {
+            const QString filePath = commentModel_->filePath(fileRow);
+            commentModel_->clearEdits(fileRow);
+            commentModel_->setChangedOnDisk(fileRow, false);
+            changedPaths_.insert(filePath);
+        }
+        reloadChangedFiles();
+        return true;
+    }
+    return box.clickedButton() == keepButton;
+}
+
+void MainWindow::handlePreviewReady(const QList<FileSaveJob> &jobs, const QList<FilePreview> &previews)
+{
+    DiffPreviewDialog dialog(previews, this);
+    if (dialog.exec() != QDialog::Accepted) {
+        setSaving(false);
+        statusBar()->showMessage("Save cancelled; edits kept");
+        return;
+    }
+
+    // Only accepted hunks are written; rejected edits stay as unsaved edits. A file
+    // whose hunks were all rejected is not saved and keeps its edits, as do files that
+    // could not be previewed or would not change. A partly accepted file is reloaded
+    // after the save, and the groups of its rejected hunks are edited again then.
+    const QList<FilePreview> reviewed = dialog.previews();
+    QList<FileSaveJob> accepted;
+    int rejectedFiles = 0;
+    keptEdits_.clear();
+    for (qsizetype i = 0; i < jobs.size(); ++i) {
+        if (!reviewed[i].error.isEmpty() || reviewed[i].hunks.isEmpty()) {
+            continue;
+        }
+        FileSaveJob job = jobs[i];
+        job.edits = reviewed[i].acceptedEdits(job.edits);
+        if (job.edits.isEmpty()) {
+            ++rejectedFiles;
+            continue;
+        }
+        accepted.append(job);
+
+        const int fileRow = commentModel_->rowForPath(job.filePath);
+        const QList<int> groupRows = editGroups_.value(job.filePath);
+        QSet<int> rejectedGroups;
+        for (const DiffHunk &hunk : reviewed[i].hunks) {
+            for (int edit : hunk.edits) {
+                if (!hunk.accepted && edit < groupRows.size()) {
+                    rejectedGroups.insert(groupRows[edit]);
+                }
             }
         }
-        
-        // Clear size constraints and let Qt handle sizing
-        scrollArea_->setMinimumHeight(0);
-        scrollArea_->setMaximumHeight(QWIDGETSIZE_MAX);
-        
-        // Set stretch factor for expansion
-        mainLayout->setStretchFactor(scrollArea_, 1);
-        
+        for (int groupRow : std::as_const(rejectedGroups)) {
+            const CommentGroup group = commentModel_->group(fileRow, groupRow);
+            keptEdits_[job.filePath].append({group.getCombinedComments(), group.lineNumber(0),
+                                             commentModel_->groupText(fileRow, groupRow)});
+        }
+    }
+    editGroups_.clear();
+    if (accepted.isEmpty()) {
+        setSaving(false);
+        statusBar()->showMessage(rejectedFiles > 0 ? "Nothing saved; rejected edits kept" : "Nothing to save");
+        return;
+    }
+
+    saveTraceStart_ = Trace::now();
+    saveTimer_.start();
+    progressBar_->setRange(0, accepted.size() * 2);
+    progressBar_->setValue(0);
+    progressBar_->show();
+    savePipeline_->start(accepted);
+}
+
+void MainWindow::setSaving(bool saving)
+{
+    saving_ = saving;
+    ui->saveFileButton->setEnabled(!saving);
+    ui->openFileButton->setEnabled(!saving);
+    ui->openFolderButton->setEnabled(!saving);
+    ui->openChangedButton->setEnabled(!saving);
+    ui->replaceButton->setEnabled(!saving);
+    ui->commentsView->setEditTriggers(saving ? QAbstractItemView::NoEditTriggers
+                                             : QAbstractItemView::DoubleClicked | QAbstractItemView::AnyKeyPressed);
+}
+
+void MainWindow::handleSaveFinished(const QList<FileSaveJob> &jobs, bool committed)
+{
+    Trace::record("saveChanges", saveTraceStart_, Trace::now());
+    qCDebug(lcUi) << (committed ? "Saved" : "Rolled back") << jobs.size() << "files in" << saveTimer_.elapsed() << "ms";
+    progressBar_->hide();
+    setSaving(false);
+
+    QStringList details;
+    for (const FileSaveJob &job : jobs) {
+        if (job.saved) {
+            details.append(QString("Saved %1 (%2 edits)").arg(job.filePath).arg(job.edits.size()));
+            // Re-extract so line numbers match the file again; the edits are now on disk
+            savedPaths_.insert(job.filePath);
+            handleFileChanged(job.filePath);
+        } else {
+            details.append(QString("FAILED %1: %2").arg(job.filePath, job.error));
+            keptEdits_.remove(job.filePath); // Nothing was written; the model still holds every edit
+        }
+    }
+
+    QMessageBox summary(this);
+    summary.setDetailedText(details.join('\n'));
+    if (committed) {
+        summary.setIcon(QMessageBox::Information);
+        summary.setWindowTitle("Save Successful");
+        summary.setText(QString("Saved %1 modified files in %2 ms.").arg(jobs.size()).arg(saveTimer_.elapsed()));
     } else {
-        // Insufficient content - constraining size and adding spacer
-        
-        // Constrain scroll area to content size
-        int constrainedHeight = std::min(totalContentHeight, availableHeight);
-        constrainedHeight = std::max(200, constrainedHeight); // Minimum usable height
-        
-        scrollArea_->setMinimumHeight(constrainedHeight);
-        scrollArea_->setMaximumHeight(constrainedHeight);
-        
-        // Remove stretch factor
-        mainLayout->setStretchFactor(scrollArea_, 0);
+        summary.setIcon(QMessageBox::Warning);
+        summary.setWindowTitle("Save Failed");
+        summary.setText(QString("No file was changed; all %1 modified files keep their unsaved edits.").arg(jobs.size()));
+    }
+    summary.exec();
+}
+
+QList<CommentEdit> MainWindow::getModifiedCommentsForFile(int fileIndex, QList<int> *groupRows)
+{
+    QList<CommentEdit> edits;
+    
+    const Language language = LanguageRegistry::forFile(commentModel_->filePath(fileIndex));
+    for (int row : commentModel_->dirtyGroups(fileIndex)) {
+        const CommentGroup originalGroup = commentModel_->group(fileIndex, row);
+        const QString modifiedText = commentModel_->groupText(fileIndex, row);
+        // Clearing a group in the editor deletes all of its lines
+        const QStringList modifiedLines = modifiedText.isEmpty() ? QStringList() : modifiedText.split('\n');
         
-        // Add spacer if it doesn't exist
-        bool hasSpacerAfterScrollArea = false;
-        for (int i = 0; i < mainLayout->count(); ++i) {
-            if (mainLayout->itemAt(i)->widget() == scrollArea_) {
-                if (i + 1 < mainLayout->count()) {
-                    QLayoutItem *nextItem = mainLayout->itemAt(i + 1);
-                    if (nextItem && nextItem->spacerItem()) {
-                        hasSpacerAfterScrollArea = true;
-                    }
-                }
-                break;
+        // Edited lines replace the original lines in order; extra lines are inserted
+        // after the group and missing lines are deleted
+        for (int i = 0; i < modifiedLines.size(); ++i) {
+            if (i >= originalGroup.size()) {
+                edits.append(CommentEdit::insertAfter(originalGroup.lastLineNumber(), i - originalGroup.size(), modifiedLines[i]));
+                continue;
+            }
+            
+            // For inline comments, extract just the comment part from the full line; the
+            // model only keeps edits of such lines that still have their comment
+            QString commentToSave = modifiedLines[i];
+            if (originalGroup.showsFullLine(i) && !extractCommentFromFullLine(modifiedLines[i], language, commentToSave)) {
+                continue;
+            }
+            if (commentToSave != originalGroup.comment(i)) {
+                edits.append(CommentEdit::replace(originalGroup.lineNumber(i), commentToSave));
             }
         }
-        
-        if (!hasSpacerAfterScrollArea) {
-            mainLayout->addStretch(1);
+        for (int i = modifiedLines.size(); i < originalGroup.size(); ++i) {
+            edits.append(CommentEdit::remove(originalGroup.lineNumber(i)));
         }
+        if (groupRows) {
+            groupRows->resize(edits.size(), row);
+        }
+    }
+    
+    return edits;
+}
+
+bool MainWindow::extractCommentFromFullLine(const QString &fullLine, Language language, QString &comment)
+{
+    // Lex the edited line with the file's own syntax, so only that language's markers count
+    const QByteArray line = fullLine.toUtf8();
+    const QList<CommentSpan> spans = CommentLexer(language).scan(line);
+    if (spans.isEmpty()) {
+        return false;
     }
+    comment = QString::fromUtf8(line.mid(spans.first().textStart, spans.first().textEnd - spans.first().textStart));
+    return true;
 }
 
 // MultiLineTextDelegate implementation
@@ -437,8 +903,11 @@ void MultiLineTextDelegate::setModelData(QWidget *editor, QAbstractItemModel *mo
 {
     QTextEdit *textEdit = qobject_cast<QTextEdit*>(editor);
     if (textEdit) {
+        // Only a real change is committed, so merely opening an editor never dirties a file
         QString value = textEdit->toPlainText();
-        model->setData(index, value, Qt::EditRole);
+        if (value != index.data(Qt::EditRole).toString()) {
+            model->setData(index, value, Qt::EditRole);
+        }
     }
 }
 
@@ -460,10 +929,5 @@ void MultiLineTextDelegate::updateEditorGeometry(QWidget *editor, const QStyleOp
         
         rect.setHeight(editorHeight);
         textEdit->setGeometry(rect);
-        
-        // Ensure the row height matches the editor height
-        if (QTableWidget *table = qobject_cast<QTableWidget*>(textEdit->parent()->parent())) {
-            table->setRowHeight(index.row(), editorHeight);
-        }
     }
 }
\ No newline at end of file
@@ -0,0 +1,161 @@
+#include "MetricsDialog.h"
+#include <QDir>
+#include <QFileInfo>
+#include <QHeaderView>
+#include <QLabel>
+#include <QTreeWidget>
+#include <QVBoxLayout>
+
+namespace {
+
+enum Column { NameColumn, FilesColumn, LinesColumn, CommentLinesColumn, DensityColumn, InlineColumn,
+              TodoColumn, FixmeColumn, UncommentedColumn, ColumnCount };
+
+enum ItemRole { PathRole = Qt::UserRole, DirectoryRole, PopulatedRole };
+
+QString percent(double ratio)
+{
+    return QString::number(ratio * 100.0, 'f', 1) + " %";
+}
+
+} // namespace
+
+MetricsDialog::MetricsDialog(const CommentMetricsReport *report, QWidget *parent)
+    : QDialog(parent), report_(report)
+{
+    setWindowTitle(tr("Comment Metrics"));
+    resize(1000, 600);
+
+    tree_ = new QTreeWidget();
+    tree_->setColumnCount(ColumnCount);
+    tree_->setHeaderLabels({tr("Path"), tr("Files"), tr("Lines"), tr("Comment Lines"), tr("Density"),
+                            tr("Inline"), tr("TODO"), tr("FIXME"), tr("Longest Uncommented")});
+    tree_->header()->setSectionResizeMode(NameColumn, QHeaderView::Stretch);
+    tree_->header()->setStretchLastSection(false);
+    tree_->setUniformRowHeights(true);
+    connect(tree_, &QTreeWidget::itemExpanded, this, &MetricsDialog::populate);
+
+    summaryLabel_ = new QLabel();
+    summaryLabel_->setTextInteractionFlags(Qt::TextSelectableByMouse);
+    QVBoxLayout *layout = new QVBoxLayout(this);
+    layout->addWidget(summaryLabel_);
+    layout->addWidget(tree_, 1);
+
+    reset();
+}
+
+void MetricsDialog::reset()
+{
+    tree_->clear();
+    items_.clear();
+    const QString root = report_->root();
+    const QStringList tops = root.isEmpty() ? report_->subdirectories(QString()) : QStringList{root};
+    for (const QString &directory : tops) {
+        QTreeWidgetItem *item = addItem(nullptr, directory, true);
+        populate(item);
+        item->setExpanded(true);
+    }
+    updateSummary();
+}
+
+void MetricsDialog::updateFile(const QString &filePath)
+{
+    // Rows only exist for directories that have been expanded; the rest are built from
+    // the report when they are
+    const QString path = QDir::cleanPath(QFileInfo(filePath).absoluteFilePath());
+    if (QTreeWidgetItem *item = items_.value(path)) {
+        fillRow(item, report_->file(path));
+    } else {
+        // A new file; its directory lists it once it is reopened
+        for (QString directory = QFileInfo(path).path(); ; directory = QFileInfo(directory).path()) {
+            QTreeWidgetItem *parent = items_.value(directory);
+            if (parent && parent->data(0, PopulatedRole).toBool()) {
+                parent->setData(0, PopulatedRole, false);
+                qDeleteAll(parent->takeChildren());
+                if (parent->isExpanded()) {
+                    populate(parent);
+                }
+                break;
+            }
+            if (parent || QFileInfo(directory).isRoot()) {
+                break;
+            }
+        }
+    }
+    for (QString directory = QFileInfo(path).path(); ; directory = QFileInfo(directory).path()) {
+        if (QTreeWidgetItem *item = items_.value(directory)) {
+            fillRow(item, report_->directory(directory));
+        }
+        if (QFileInfo(directory).isRoot()) {
+            break;
+        }
+    }
+    updateSummary();
+}
+
+void MetricsDialog::populate(QTreeWidgetItem *item)
+{
+    if (!item->data(0, DirectoryRole).toBool() || item->data(0, PopulatedRole).toBool()) {
+        return;
+    }
+    item->setData(0, PopulatedRole, true);
+    const QString directory = item->data(0, PathRole).toString();
+    for (const QString &subdirectory : report_->subdirectories(directory)) {
+        addItem(item, subdirectory, true);
+    }
+    for (const QString &file : report_->files(directory)) {
+        addItem(item, file, false);
+    }
+}
+
+QTreeWidgetItem *MetricsDialog::addItem(QTreeWidgetItem *parent, const QString &path, bool isDirectory)
+{
+    QTreeWidgetItem *item = parent ? new QTreeWidgetItem(parent) : new QTreeWidgetItem(tree_);
+    item->setText(NameColumn, parent ? QFileInfo(path).fileName() : QDir::toNativeSeparators(path));
+    item->setToolTip(NameColumn, QDir::toNativeSeparators(path));
+    item->setData(0, PathRole, path);
+    item->setData(0, DirectoryRole, isDirectory);
+    if (isDirectory) {
+        item->setChildIndicatorPolicy(QTreeWidgetItem::ShowIndicator);
+    }
+    for (int column = FilesColumn; column < ColumnCount; ++column) {
+        item->setTextAlignment(column, Qt::AlignRight | Qt::AlignVCenter);
+    }
+    fillRow(item, isDirectory ? report_->directory(path) : report_->file(path));
+    items_.insert(path, item);
+    return item;
+}
+
+void MetricsDialog::fillRow(QTreeWidgetItem *item, const CommentMetrics &metrics)
+{
+    item->setText(FilesColumn, QString::number(metrics.files));
+    item->setText(LinesColumn, QString::number(metrics.lines));
+    item->setText(CommentLinesColumn, QString::number(metrics.commentLines));
+    item->setText(DensityColumn, percent(metrics.density()));
+    item->setText(InlineColumn, percent(metrics.inlineRatio()));
+    item->setText(TodoColumn, QString::number(metrics.todoCount));
+    item->setText(FixmeColumn, QString::number(metrics.fixmeCount));
+    item->setText(UncommentedColumn, QString::number(metrics.longestUncommented));
+    // Where the longest run is, for directories that is in one of their files
+    if (metrics.longestUncommented > 0) {
+        item->setToolTip(UncommentedColumn, QString("%1, lines %2-%3")
+                         .arg(QDir::toNativeSeparators(metrics.longestUncommentedFile))
+                         .arg(metrics.longestUncommentedStart)
+                         .arg(metrics.longestUncommentedStart + metrics.longestUncommented - 1));
+    } else {
+        item->setToolTip(UncommentedColumn, QString());
+    }
+}
+
+void MetricsDialog::updateSummary()
+{
+    CommentMetrics total;
+    const QString root = report_->root();
+    for (const QString &directory : root.isEmpty() ? report_->subdirectories(QString()) : QStringList{root}) {
+        total.add(report_->directory(directory));
+    }
+    summaryLabel_->setText(tr("%1 files, %2 of %3 lines are comments (%4, %5 inline), %6 TODO, %7 FIXME")
+                           .arg(total.files).arg(total.commentLines).arg(total.lines)
+                           .arg(percent(total.density()), percent(total.inlineRatio()))
+                           .arg(total.todoCount).arg(total.fixmeCount));
+}
@@ -0,0 +1,43 @@
+#include "SavePipeline.h"
+
+SavePipeline::SavePipeline(QObject *parent) : QObject(parent)
+{
+    // saveAll() has its own worker pool; this thread only drives the transaction
+    pool_.setMaxThreadCount(1);
+}
+
+SavePipeline::~SavePipeline()
+{
+    // A transaction is never abandoned halfway; wait for it to commit or roll back
+    pool_.waitForDone();
+}
+
+void SavePipeline::start(const QList<FileSaveJob> &jobs)
+{
+    if (running_) {
+        return;
+    }
+    running_ = true;
+    pool_.start([this, jobs]() mutable {
+        const bool committed = CommentSaver::saveAll(jobs, [this](int completed, int total, const QString &filePath) {
+            QMetaObject::invokeMethod(this, [this, completed, total, filePath]() {
+                emit progressChanged(completed, total, filePath);
+            }, Qt::QueuedConnection);
+        });
+        QMetaObject::invokeMethod(this, [this, jobs, committed]() {
+            running_ = false;
+            emit finished(jobs, committed);
+        }, Qt::QueuedConnection);
+    });
+}
+
+void SavePipeline::preview(const QList<FileSaveJob> &jobs)
+{
+    // Queued behind a running save, so the preview reads the files it left behind
+    pool_.start([this, jobs]() {
+        const QList<FilePreview> previews = CommentSaver::previewAll(jobs);
+        QMetaObject::invokeMethod(this, [this, jobs, previews]() {
+            emit previewReady(jobs, previews);
+        }, Qt::QueuedConnection);
+    });
+}
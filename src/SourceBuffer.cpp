@@ -0,0 +1,54 @@
+#include "SourceBuffer.h"
+#include "Logging.h"
+
+QSharedPointer<const SourceBuffer> SourceBuffer::open(const QString &filePath, ReadMode mode)
+{
+    QSharedPointer<SourceBuffer> buffer(new SourceBuffer);
+    buffer->file_.setFileName(filePath);
+    if (!buffer->file_.open(QIODevice::ReadOnly)) {
+        qCWarning(lcSource) << "Could not open file:" << filePath;
+        return {};
+    }
+
+    const qint64 fileSize = buffer->file_.size();
+    const bool map = mode == ReadMode::Map || (mode == ReadMode::Auto && fileSize >= AutoMapThreshold);
+
+    if (map && fileSize > 0) {
+        // The mapping stays valid after close() until the QFile is destroyed
+        if (uchar *mapped = buffer->file_.map(0, fileSize)) {
+            buffer->data_ = reinterpret_cast<const char *>(mapped);
+            buffer->size_ = fileSize;
+            buffer->mapped_ = true;
+            buffer->file_.close();
+            return buffer;
+        }
+        qCWarning(lcSource) << "Could not map file, reading instead:" << filePath;
+    }
+
+    buffer->bytes_ = buffer->file_.readAll();
+    buffer->file_.close();
+    buffer->data_ = buffer->bytes_.constData();
+    buffer->size_ = buffer->bytes_.size();
+    return buffer;
+}
+
+QSharedPointer<const SourceBuffer> SourceBuffer::slice(const QSharedPointer<const SourceBuffer> &parent,
+                                                       qsizetype offset, qsizetype size)
+{
+    Q_ASSERT(parent && offset >= 0 && size >= 0 && offset + size <= parent->size());
+    QSharedPointer<SourceBuffer> buffer(new SourceBuffer);
+    buffer->parent_ = parent;
+    buffer->data_ = parent->data() + offset;
+    buffer->size_ = size;
+    buffer->mapped_ = parent->isMapped();
+    return buffer;
+}
+
+QSharedPointer<const SourceBuffer> SourceBuffer::fromBytes(const QByteArray &bytes)
+{
+    QSharedPointer<SourceBuffer> buffer(new SourceBuffer);
+    buffer->bytes_ = bytes;
+    buffer->data_ = buffer->bytes_.constData();
+    buffer->size_ = buffer->bytes_.size();
+    return buffer;
+}
@@ -0,0 +1,125 @@
+#include "Trace.h"
+#include "Logging.h"
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QList>
+#include <QMutex>
+#include <QTextStream>
+#include <QThread>
+
+std::atomic<bool> Trace::enabled_{false};
+
+namespace {
+
+struct TraceEvent {
+    const char *name;
+    qint64 startNs;
+    qint64 endNs;
+    quintptr threadId;
+    QString detail;
+};
+
+struct TraceState {
+    QElapsedTimer clock;
+    QMutex mutex;
+    QList<TraceEvent> events;
+    QString environmentOutput; // Written at exit when tracing came from CCP_TRACE
+
+    TraceState() { clock.start(); }
+};
+
+TraceState &state()
+{
+    static TraceState instance;
+    return instance;
+}
+
+void writeEnvironmentTrace()
+{
+    Trace::stop();
+    const QString output = state().environmentOutput;
+    if (Trace::writeChromeTrace(output)) {
+        // Asked for through CCP_TRACE, so reported regardless of the logging thresholds
+        QTextStream(stderr) << "Trace written to " << output << Qt::endl;
+    }
+}
+
+} // namespace
+
+void Trace::start()
+{
+    TraceState &trace = state();
+    {
+        QMutexLocker locker(&trace.mutex);
+        trace.events.clear();
+    }
+    enabled_.store(true, std::memory_order_relaxed);
+}
+
+void Trace::stop()
+{
+    enabled_.store(false, std::memory_order_relaxed);
+}
+
+void Trace::startFromEnvironment()
+{
+    const QString output = qEnvironmentVariable("CCP_TRACE");
+    if (output.isEmpty()) {
+        return;
+    }
+    state().environmentOutput = output;
+    start();
+    // Runs while QCoreApplication is still alive, unlike a static destructor
+    qAddPostRoutine(writeEnvironmentTrace);
+}
+
+qint64 Trace::now()
+{
+    return state().clock.nsecsElapsed();
+}
+
+void Trace::record(const char *name, qint64 startNs, qint64 endNs, const QString &detail)
+{
+    if (!isEnabled()) {
+        return;
+    }
+    TraceState &trace = state();
+    TraceEvent event{name, startNs, endNs, quintptr(QThread::currentThreadId()), detail};
+    QMutexLocker locker(&trace.mutex);
+    trace.events.append(std::move(event));
+}
+
+bool Trace::writeChromeTrace(const QString &filePath)
+{
+    TraceState &trace = state();
+    QJsonArray events;
+    {
+        QMutexLocker locker(&trace.mutex);
+        for (const TraceEvent &event : std::as_const(trace.events)) {
+            // Complete events ("X"); Chrome trace timestamps are microseconds
+            QJsonObject json{{"name", QString::fromLatin1(event.name)},
+                             {"cat", "ccp"},
+                             {"ph", "X"},
+                             {"ts", double(event.startNs) / 1000.0},
+                             {"dur", double(event.endNs - event.startNs) / 1000.0},
+                             {"pid", qint64(QCoreApplication::applicationPid())},
+                             {"tid", qint64(event.threadId)}};
+            if (!event.detail.isEmpty()) {
+                json.insert("args", QJsonObject{{"file", event.detail}});
+            }
+            events.append(json);
+        }
+    }
+
+    QFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qCWarning(lcUi) << "Could not write trace:" << filePath << file.errorString();
+        return false;
+    }
+    file.write(QJsonDocument(QJsonObject{{"traceEvents", events}, {"displayTimeUnit", "ms"}}).toJson(QJsonDocument::Compact));
+    return true;
+}
@@ -1,9 +1,11 @@
 #include <QApplication>
 #include "MainWindow.h"
+#include "Trace.h"
 
 int main(int argc, char *argv[])
 {
     QApplication app(argc, argv);
+    Trace::startFromEnvironment();
 
     MainWindow window;
     window.show();
@@ -0,0 +1,122 @@
+#include <QtTest>
+#include "ByteScan.h"
+#include "CommentLexer.h"
+#include <iterator>
+
+// Differential check of the vector kernels against the scalar table: the same
+// random buffers must give the same hits, and the lexer the same spans, with
+// every kernel this CPU supports
+class ByteScanTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void cleanup();
+    void findMatchesScalar();
+    void lexerMatchesScalar();
+
+private:
+    static constexpr int BufferCount = 200000;
+
+    quint32 next() { return state_ = state_ * 1103515245u + 12345u; } // Deterministic across runs
+    // Up to maxLength bytes drawn from alphabet
+    QByteArray randomBuffer(const QByteArray &alphabet, int maxLength);
+    static QList<ByteFinder::Kernel> vectorKernels();
+
+    quint32 state_ = 12345;
+};
+
+void ByteScanTest::cleanup()
+{
+    ByteFinder::setSelectedKernel(ByteFinder::activeKernel());
+}
+
+QByteArray ByteScanTest::randomBuffer(const QByteArray &alphabet, int maxLength)
+{
+    QByteArray buffer(int((next() >> 8) % quint32(maxLength + 1)), Qt::Uninitialized);
+    for (char &c : buffer) {
+        c = alphabet[int((next() >> 16) % quint32(alphabet.size()))];
+    }
+    return buffer;
+}
+
+QList<ByteFinder::Kernel> ByteScanTest::vectorKernels()
+{
+    QList<ByteFinder::Kernel> kernels;
+    for (ByteFinder::Kernel kernel : {ByteFinder::Kernel::Sse2, ByteFinder::Kernel::Avx2}) {
+        if (ByteFinder::isSupported(kernel)) {
+            kernels.append(kernel);
+        }
+    }
+    return kernels;
+}
+
+void ByteScanTest::findMatchesScalar()
+{
+    const QList<ByteFinder::Kernel> kernels = vectorKernels();
+    if (kernels.isEmpty()) {
+        QSKIP("No vector kernel on this CPU");
+    }
+    const ByteFinder finder{'\n', '"', '/', '#', '\'', '\0', '\xff'};
+    const QByteArray dense("abcdefgh \t\n\"/#'\0\xff\x80", 18);
+    const QByteArray sparse = "abcdefghijklmnopqrstuvwxyz012345/";
+    for (int n = 0; n < BufferCount; ++n) {
+        // Sparse hits as well as dense ones, and lengths around the 16 and 32 byte blocks
+        const QByteArray buffer = randomBuffer(n % 2 ? dense : sparse, 96);
+        const char *end = buffer.constEnd();
+        for (const char *p = buffer.constBegin(); ; ++p) {
+            const char *expected = finder.find(p, end, ByteFinder::Kernel::Scalar);
+            for (ByteFinder::Kernel kernel : kernels) {
+                const char *found = finder.find(p, end, kernel);
+                if (found != expected) {
+                    QFAIL(qPrintable(QString("%1 kernel found offset %2 instead of %3 from offset %4 in buffer %5")
+                                     .arg(ByteFinder::kernelName(kernel)).arg(found - buffer.constBegin())
+                                     .arg(expected - buffer.constBegin()).arg(p - buffer.constBegin()).arg(n)));
+                }
+            }
+            if (p == end) {
+                break;
+            }
+        }
+    }
+}
+
+void ByteScanTest::lexerMatchesScalar()
+{
+    const QList<ByteFinder::Kernel> kernels = vectorKernels();
+    if (kernels.isEmpty()) {
+        QSKIP("No vector kernel on this CPU");
+    }
+    // Mostly bytes the lexer stops at, so literals, comments and lines nest densely
+    const QByteArray alphabet = "ab R r@ \t\n\r\\/*/*\"\"''#`[[=]]()";
+    const Language languages[] = {Language::Cpp, Language::Python, Language::TypeScript, Language::JavaScript,
+                                  Language::Rust, Language::Go, Language::Java, Language::CSharp,
+                                  Language::Shell, Language::CMake};
+    for (int n = 0; n < BufferCount; ++n) {
+        const QByteArray buffer = randomBuffer(alphabet, 160);
+        const CommentLexer lexer(languages[n % std::size(languages)]);
+        ByteFinder::setSelectedKernel(ByteFinder::Kernel::Scalar);
+        const QList<CommentSpan> expected = lexer.scan(buffer);
+        for (ByteFinder::Kernel kernel : kernels) {
+            ByteFinder::setSelectedKernel(kernel);
+            const QList<CommentSpan> spans = lexer.scan(buffer);
+            bool same = spans.size() == expected.size();
+            for (qsizetype i = 0; same && i < spans.size(); ++i) {
+                const CommentSpan &a = spans[i];
+                const CommentSpan &b = expected[i];
+                same = a.lineNumber == b.lineNumber && a.lineStart == b.lineStart && a.lineEnd == b.lineEnd
+                    && a.textStart == b.textStart && a.textEnd == b.textEnd && a.commentStart == b.commentStart
+                    && a.commentEnd == b.commentEnd && a.isInline == b.isInline
+                    && a.isBlockFragment == b.isBlockFragment && a.hasMoreComments == b.hasMoreComments;
+            }
+            if (!same) {
+                QFAIL(qPrintable(QString("%1 kernel gave different spans for buffer %2: %3")
+                                 .arg(ByteFinder::kernelName(kernel)).arg(n)
+                                 .arg(QString::fromLatin1(buffer.toPercentEncoding()))));
+            }
+        }
+    }
+}
+
+QTEST_APPLESS_MAIN(ByteScanTest)
+#include "ByteScanTest.moc"
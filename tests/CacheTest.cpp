@@ -0,0 +1,169 @@
+#include <QtTest>
+#include <QTemporaryDir>
+#include "CommentCache.h"
+#include "CommentExtractor.h"
+
+// Cache records written and read back, and damaged cache files rejected rather
+// than served
+class CacheTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void init();
+    void roundTrip();
+    void staleEntries();
+    void corruptRecordIsNotServed();
+    void corruptHeaderIgnoresCache();
+    void truncatedCacheIsIgnored();
+    void extractorServesCachedFiles();
+
+private:
+    // Extracts a small source file and saves it as the only cache entry
+    FileComments storeSource();
+    void damageCache(qsizetype offset);
+    static void compareFiles(const FileComments &actual, const FileComments &expected);
+
+    QScopedPointer<QTemporaryDir> dir_;
+    QString sourcePath_;
+    QString cachePath_;
+};
+
+void CacheTest::init()
+{
+    dir_.reset(new QTemporaryDir());
+    QVERIFY(dir_->isValid());
+    sourcePath_ = dir_->filePath("source.cpp");
+    cachePath_ = dir_->filePath("cache.bin");
+}
+
+FileComments CacheTest::storeSource()
+{
+    QFile source(sourcePath_);
+    if (!source.open(QIODevice::WriteOnly)) {
+        qFatal("Could not write %s", qPrintable(sourcePath_));
+    }
+    source.write("// Header\n// continues\nint a; // inline\n\n/* block\n * lines */\nint b;\n");
+    source.close();
+
+    const FileComments file = CommentExtractor().extractFile(sourcePath_);
+    CommentCache cache(cachePath_);
+    cache.store(file);
+    if (!cache.save()) {
+        qFatal("Could not save %s", qPrintable(cachePath_));
+    }
+    return file;
+}
+
+// Flips one byte of the saved cache file in place
+void CacheTest::damageCache(qsizetype offset)
+{
+    QFile cache(cachePath_);
+    QVERIFY(cache.open(QIODevice::ReadWrite));
+    QVERIFY(cache.seek(offset));
+    char byte = 0;
+    QVERIFY(cache.getChar(&byte));
+    QVERIFY(cache.seek(offset));
+    QVERIFY(cache.putChar(char(byte ^ 0x5a)));
+}
+
+void CacheTest::compareFiles(const FileComments &actual, const FileComments &expected)
+{
+    QCOMPARE(actual.contentHash, expected.contentHash);
+    QCOMPARE(actual.lineCount, expected.lineCount);
+    QCOMPARE(actual.comments.lineNumbers, expected.comments.lineNumbers);
+    QCOMPARE(actual.comments.flags, expected.comments.flags);
+    QCOMPARE(actual.comments.groupStarts, expected.comments.groupStarts);
+    for (int i = 0; i < expected.comments.commentCount(); ++i) {
+        QCOMPARE(actual.comments.comment(i), expected.comments.comment(i));
+        QCOMPARE(actual.comments.fullLine(i), expected.comments.fullLine(i));
+    }
+}
+
+void CacheTest::roundTrip()
+{
+    const FileComments stored = storeSource();
+    QCOMPARE(stored.comments.commentCount(), 5);
+    QCOMPARE(stored.groupCount(), 2);
+
+    CommentCache cache(cachePath_);
+    QVERIFY(cache.load());
+    FileComments loaded;
+    loaded.filePath = sourcePath_;
+    QVERIFY(cache.lookup(sourcePath_, stored.size, stored.lastModified, loaded));
+    compareFiles(loaded, stored);
+    QCOMPARE(loaded.group(0).getCombinedComments(), QString("Header\ncontinues\nint a; // inline"));
+}
+
+void CacheTest::staleEntries()
+{
+    const FileComments stored = storeSource();
+    CommentCache cache(cachePath_);
+    QVERIFY(cache.load());
+
+    FileComments loaded;
+    loaded.filePath = sourcePath_;
+    QVERIFY(!cache.lookup(sourcePath_, stored.size + 1, stored.lastModified, loaded));
+    QVERIFY(!cache.lookup(sourcePath_, stored.size, stored.lastModified + 1, loaded));
+    QVERIFY(!cache.lookup(dir_->filePath("other.cpp"), stored.size, stored.lastModified, loaded));
+    // A touched file with the same content is still served by its hash
+    QVERIFY(!cache.lookupByHash(sourcePath_, stored.contentHash + 1, loaded));
+    QVERIFY(cache.lookupByHash(sourcePath_, stored.contentHash, loaded));
+    compareFiles(loaded, stored);
+}
+
+void CacheTest::corruptRecordIsNotServed()
+{
+    const FileComments stored = storeSource();
+    // The last byte belongs to the only record, inside its checksummed part
+    damageCache(QFileInfo(cachePath_).size() - 1);
+
+    CommentCache cache(cachePath_);
+    QVERIFY(cache.load());
+    FileComments loaded;
+    loaded.filePath = sourcePath_;
+    QVERIFY(!cache.lookup(sourcePath_, stored.size, stored.lastModified, loaded));
+    QVERIFY(!cache.lookupByHash(sourcePath_, stored.contentHash, loaded));
+    QCOMPARE(loaded.comments.commentCount(), 0);
+}
+
+void CacheTest::corruptHeaderIgnoresCache()
+{
+    const FileComments stored = storeSource();
+    damageCache(12); // Record count
+
+    CommentCache cache(cachePath_);
+    QVERIFY(!cache.load());
+    FileComments loaded;
+    loaded.filePath = sourcePath_;
+    QVERIFY(!cache.lookup(sourcePath_, stored.size, stored.lastModified, loaded));
+}
+
+void CacheTest::truncatedCacheIsIgnored()
+{
+    const FileComments stored = storeSource();
+    QVERIFY(QFile::resize(cachePath_, QFileInfo(cachePath_).size() - 8));
+
+    CommentCache cache(cachePath_);
+    QVERIFY(!cache.load());
+    FileComments loaded;
+    loaded.filePath = sourcePath_;
+    QVERIFY(!cache.lookup(sourcePath_, stored.size, stored.lastModified, loaded));
+}
+
+void CacheTest::extractorServesCachedFiles()
+{
+    const FileComments stored = storeSource();
+    CommentCache cache(cachePath_);
+    QVERIFY(cache.load());
+    CommentExtractor extractor;
+    extractor.setCache(&cache);
+
+    // Served from the mapped cache file rather than from a new arena
+    const FileComments cached = extractor.extractFile(sourcePath_);
+    compareFiles(cached, stored);
+    QVERIFY(cached.comments.text != stored.comments.text);
+}
+
+QTEST_GUILESS_MAIN(CacheTest)
+#include "CacheTest.moc"
@@ -0,0 +1,133 @@
+#include <QtTest>
+#include "GitChanges.h"
+
+// `git diff -U0` output read into changed line ranges per file
+class GitChangesTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void init();
+    void hunks();
+    void hunkLinesAreNotHeaders();
+    void newAndDeletedFiles();
+    void quotedPaths();
+
+private:
+    QString path(const QString &relativePath) const { return QDir(root_).filePath(relativePath); }
+
+    QString root_;
+    GitChanges changes_;
+};
+
+void GitChangesTest::init()
+{
+    root_ = QDir::cleanPath(QDir::tempPath() + "/repo");
+    changes_ = GitChanges();
+}
+
+void GitChangesTest::hunks()
+{
+    changes_.parseDiff(root_, "diff --git a/src/a.cpp b/src/a.cpp\n"
+                              "index 1111111..2222222 100644\n"
+                              "--- a/src/a.cpp\n"
+                              "+++ b/src/a.cpp\n"
+                              "@@ -3,0 +4,2 @@ int f()\n"
+                              "+added\n"
+                              "+added\n"
+                              "@@ -10,2 +12,3 @@\n"
+                              "-old\n"
+                              "-old\n"
+                              "+new\n"
+                              "+new\n"
+                              "+new\n"
+                              "@@ -20 +22 @@\n"
+                              "-one\n"
+                              "+one\n"
+                              "@@ -30,2 +33,0 @@\n"
+                              "-gone\n"
+                              "-gone\n");
+    QCOMPARE(changes_.files(), QStringList{path("src/a.cpp")});
+    const FileChanges *file = changes_.changesFor(path("src/a.cpp"));
+    QVERIFY(file);
+    QVERIFY(!file->newFile);
+    QCOMPARE(file->added, (QList<QPair<int, int>>{{4, 5}}));
+    QCOMPARE(file->modified, (QList<QPair<int, int>>{{12, 14}, {22, 22}}));
+
+    QVERIFY(file->lineChange(3) == ChangeKind::Unchanged);
+    QVERIFY(file->lineChange(4) == ChangeKind::New);
+    QVERIFY(file->lineChange(5) == ChangeKind::New);
+    QVERIFY(file->lineChange(12) == ChangeKind::Modified);
+    QVERIFY(file->lineChange(14) == ChangeKind::Modified);
+    QVERIFY(file->lineChange(15) == ChangeKind::Unchanged);
+    // Only removed lines leave nothing to mark
+    QVERIFY(file->lineChange(33) == ChangeKind::Unchanged);
+    QVERIFY(!changes_.changesFor(path("src/b.cpp")));
+}
+
+void GitChangesTest::hunkLinesAreNotHeaders()
+{
+    // A removed "-- x" and an added "++ y" look like file headers
+    changes_.parseDiff(root_, "diff --git a/a.sql b/a.sql\n"
+                              "--- a/a.sql\n"
+                              "+++ b/a.sql\n"
+                              "@@ -2 +2,2 @@\n"
+                              "--- x\n"
+                              "+++ y\n"
+                              "+++ b/other.sql\n");
+    QCOMPARE(changes_.files(), QStringList{path("a.sql")});
+    QCOMPARE(changes_.changesFor(path("a.sql"))->modified, (QList<QPair<int, int>>{{2, 3}}));
+}
+
+void GitChangesTest::newAndDeletedFiles()
+{
+    changes_.parseDiff(root_, "diff --git a/gone.cpp b/gone.cpp\n"
+                              "deleted file mode 100644\n"
+                              "index 1111111..0000000\n"
+                              "--- a/gone.cpp\n"
+                              "+++ /dev/null\n"
+                              "@@ -1,2 +0,0 @@\n"
+                              "-a\n"
+                              "-b\n"
+                              "diff --git a/new.cpp b/new.cpp\n"
+                              "new file mode 100644\n"
+                              "index 0000000..1111111\n"
+                              "--- /dev/null\n"
+                              "+++ b/new.cpp\n"
+                              "@@ -0,0 +1,3 @@\n"
+                              "+a\n"
+                              "+b\n"
+                              "+c\n");
+    QCOMPARE(changes_.files(), QStringList{path("new.cpp")});
+    QVERIFY(!changes_.changesFor(path("gone.cpp")));
+    const FileChanges *file = changes_.changesFor(path("new.cpp"));
+    QVERIFY(file);
+    QVERIFY(file->newFile);
+    // A new file is new throughout, whatever its hunks say
+    QVERIFY(file->lineChange(1) == ChangeKind::New);
+    QVERIFY(file->lineChange(100) == ChangeKind::New);
+}
+
+void GitChangesTest::quotedPaths()
+{
+    changes_.parseDiff(root_, "diff --git \"a/dir/q\\\"uote.cpp\" \"b/dir/q\\\"uote.cpp\"\n"
+                              "--- \"a/dir/q\\\"uote.cpp\"\n"
+                              "+++ \"b/dir/q\\\"uote.cpp\"\n"
+                              "@@ -5 +5 @@\n"
+                              "-a\n"
+                              "+b\n"
+                              "diff --git \"a/caf\\303\\251.cpp\" \"b/caf\\303\\251.cpp\"\n"
+                              "--- \"a/caf\\303\\251.cpp\"\n"
+                              "+++ \"b/caf\\303\\251.cpp\"\n"
+                              "@@ -0,0 +1 @@\n"
+                              "+a\n");
+    const FileChanges *quote = changes_.changesFor(path("dir/q\"uote.cpp"));
+    QVERIFY(quote);
+    QCOMPARE(quote->modified, (QList<QPair<int, int>>{{5, 5}}));
+    const FileChanges *accented = changes_.changesFor(path(QString::fromUtf8("caf\xc3\xa9.cpp")));
+    QVERIFY(accented);
+    QCOMPARE(accented->added, (QList<QPair<int, int>>{{1, 1}}));
+}
+
+QTEST_APPLESS_MAIN(GitChangesTest)
+#include "GitChangesTest.moc"
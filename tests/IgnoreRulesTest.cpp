@@ -0,0 +1,129 @@
+#include <QtTest>
+#include <QTemporaryDir>
+#include "IgnoreRules.h"
+
+// .gitignore globs, and rules read from .gitignore files chained down a directory tree
+class IgnoreRulesTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void init();
+    void globMatch_data();
+    void globMatch();
+    void rulesOfOneDirectory();
+    void childOverridesParent();
+    void directoryWithoutRulesSharesParent();
+
+private:
+    void writeIgnore(const QString &directory, const QByteArray &content);
+    QString path(const QString &relativePath) const { return dir_->filePath(relativePath); }
+
+    QScopedPointer<QTemporaryDir> dir_;
+};
+
+void IgnoreRulesTest::init()
+{
+    dir_.reset(new QTemporaryDir());
+    QVERIFY(dir_->isValid());
+}
+
+void IgnoreRulesTest::writeIgnore(const QString &directory, const QByteArray &content)
+{
+    QVERIFY(QDir().mkpath(directory));
+    QFile file(QDir(directory).filePath(".gitignore"));
+    QVERIFY(file.open(QIODevice::WriteOnly));
+    QCOMPARE(file.write(content), content.size());
+}
+
+void IgnoreRulesTest::globMatch_data()
+{
+    QTest::addColumn<QString>("pattern");
+    QTest::addColumn<QString>("text");
+    QTest::addColumn<bool>("matches");
+
+    QTest::newRow("star") << "*.o" << "main.o" << true;
+    QTest::newRow("star stops at slash") << "*.o" << "dir/main.o" << false;
+    QTest::newRow("question mark") << "?.cpp" << "a.cpp" << true;
+    QTest::newRow("question mark is one character") << "?.cpp" << "ab.cpp" << false;
+    QTest::newRow("question mark is not a slash") << "a?b" << "a/b" << false;
+    QTest::newRow("leading ** at the top") << "**/build" << "build" << true;
+    QTest::newRow("leading ** deeper") << "**/build" << "a/b/build" << true;
+    QTest::newRow("trailing **") << "src/**" << "src/a/b.cpp" << true;
+    QTest::newRow("middle ** spans nothing") << "a/**/b" << "a/b" << true;
+    QTest::newRow("middle ** spans directories") << "a/**/b" << "a/x/y/b" << true;
+    QTest::newRow("middle ** needs whole names") << "a/**/b" << "a/xb" << false;
+    QTest::newRow("class") << "[a-c].txt" << "b.txt" << true;
+    QTest::newRow("class misses") << "[a-c].txt" << "d.txt" << false;
+    QTest::newRow("negated class") << "[!a-c].txt" << "d.txt" << true;
+    QTest::newRow("negated class misses") << "[!a-c].txt" << "b.txt" << false;
+    QTest::newRow("malformed class is literal") << "[abc" << "[abc" << true;
+    QTest::newRow("escaped star") << "\\*.txt" << "*.txt" << true;
+    QTest::newRow("escaped star is literal") << "\\*.txt" << "a.txt" << false;
+    QTest::newRow("whole text") << "main" << "main.cpp" << false;
+}
+
+void IgnoreRulesTest::globMatch()
+{
+    QFETCH(QString, pattern);
+    QFETCH(QString, text);
+    QFETCH(bool, matches);
+    QCOMPARE(::globMatch(pattern, text), matches);
+}
+
+void IgnoreRulesTest::rulesOfOneDirectory()
+{
+    writeIgnore(dir_->path(), "# comment\n*.log\n!keep.log\nbuild/\n/top.txt\ndocs/*.md\ntrailing.txt   \n");
+    const QSharedPointer<const IgnoreRules> rules = IgnoreRules::forDirectory(dir_->path(), {});
+    QVERIFY(rules);
+
+    // Patterns without a slash match the name at any depth
+    QVERIFY(rules->isIgnored(path("a.log"), false));
+    QVERIFY(rules->isIgnored(path("sub/a.log"), false));
+    QVERIFY(!rules->isIgnored(path("keep.log"), false));
+    QVERIFY(!rules->isIgnored(path("# comment"), false));
+    QVERIFY(rules->isIgnored(path("trailing.txt"), false));
+
+    // A trailing slash only matches directories
+    QVERIFY(rules->isIgnored(path("build"), true));
+    QVERIFY(!rules->isIgnored(path("build"), false));
+
+    // A leading or middle slash anchors the pattern to the .gitignore's directory
+    QVERIFY(rules->isIgnored(path("top.txt"), false));
+    QVERIFY(!rules->isIgnored(path("sub/top.txt"), false));
+    QVERIFY(rules->isIgnored(path("docs/readme.md"), false));
+    QVERIFY(!rules->isIgnored(path("sub/docs/readme.md"), false));
+
+    // Paths outside the directory are not matched
+    QVERIFY(!rules->isIgnored(QDir::cleanPath(dir_->path() + "/../a.log"), false));
+}
+
+void IgnoreRulesTest::childOverridesParent()
+{
+    writeIgnore(dir_->path(), "*.log\n");
+    writeIgnore(path("sub"), "!a.log\n*.tmp\n");
+    const QSharedPointer<const IgnoreRules> parent = IgnoreRules::forDirectory(dir_->path(), {});
+    const QSharedPointer<const IgnoreRules> child = IgnoreRules::forDirectory(path("sub"), parent);
+
+    QVERIFY(!child->isIgnored(path("sub/a.log"), false));
+    QVERIFY(child->isIgnored(path("sub/b.log"), false));
+    QVERIFY(child->isIgnored(path("sub/x.tmp"), false));
+    // The child's rules stay inside the child
+    QVERIFY(parent->isIgnored(path("a.log"), false));
+    QVERIFY(!parent->isIgnored(path("x.tmp"), false));
+}
+
+void IgnoreRulesTest::directoryWithoutRulesSharesParent()
+{
+    writeIgnore(dir_->path(), "*.log\n");
+    writeIgnore(path("comments"), "# only a comment\n\n");
+    QVERIFY(QDir().mkpath(path("empty")));
+    const QSharedPointer<const IgnoreRules> parent = IgnoreRules::forDirectory(dir_->path(), {});
+
+    QVERIFY(IgnoreRules::forDirectory(path("empty"), parent) == parent);
+    QVERIFY(IgnoreRules::forDirectory(path("comments"), parent) == parent);
+    QVERIFY(IgnoreRules::forDirectory(path("empty"), {}).isNull());
+}
+
+QTEST_GUILESS_MAIN(IgnoreRulesTest)
+#include "IgnoreRulesTest.moc"
@@ -0,0 +1,199 @@
+#include <QtTest>
+#include "CommentIndex.h"
+
+// Searches of the comment index: trigram substrings, short and regex queries that
+// scan, tag posting lists, edits and removals, and compaction of removed documents
+class IndexTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void init();
+    void substring();
+    void shortAndRegexQueries();
+    void tags();
+    void editedGroups();
+    void removedFile();
+    void compactionKeepsResults();
+    void scanFileAgreesWithSearch();
+
+private:
+    // Rows of `matches` in file 0
+    static QList<int> groupsOf(const CommentMatches &matches, int fileRow = 0);
+    static CommentQuery textQuery(const QString &text);
+
+    CommentArena arena_;
+    CommentIndex index_;
+};
+
+// Group 0 "alpha TODO: tidy", 1 "int a; // beta gamma" (inline lines are searched
+// whole), 2 "FIXME(ana) delta", 3 "TODOS are not tags"
+static const QByteArray Source = "// alpha TODO: tidy\n"
+                                 "\n"
+                                 "int a; // beta gamma\n"
+                                 "\n"
+                                 "/* FIXME(ana) delta */\n"
+                                 "\n"
+                                 "// TODOS are not tags\n";
+
+void IndexTest::init()
+{
+    arena_ = CommentArena::build(Source.constData(), CommentLexer(Language::Cpp).scan(Source));
+    QCOMPARE(arena_.groupCount(), 4);
+    index_.clear();
+    index_.setFile(0, arena_);
+}
+
+QList<int> IndexTest::groupsOf(const CommentMatches &matches, int fileRow)
+{
+    QList<int> rows;
+    if (matches.fileMatches(fileRow)) {
+        for (int g = 0; g < matches.groups[fileRow].size(); ++g) {
+            if (matches.groups[fileRow].testBit(g)) {
+                rows.append(g);
+            }
+        }
+    }
+    return rows;
+}
+
+CommentQuery IndexTest::textQuery(const QString &text)
+{
+    CommentQuery query;
+    query.text = text;
+    return query;
+}
+
+void IndexTest::substring()
+{
+    // ASCII letters fold, so the trigrams of either case find the group
+    CommentMatches matches = index_.search(textQuery("ALPHA"));
+    QCOMPARE(groupsOf(matches), QList<int>({0}));
+    QCOMPARE(matches.groupCount, 1);
+    QCOMPARE(matches.fileCount, 1);
+
+    QCOMPARE(groupsOf(index_.search(textQuery("int a;"))), QList<int>({1}));
+    QCOMPARE(groupsOf(index_.search(textQuery("ta g"))), QList<int>({1}));
+    // Every trigram occurs, but not as one substring
+    QCOMPARE(groupsOf(index_.search(textQuery("alphadelta"))), QList<int>());
+    matches = index_.search(textQuery("zzz"));
+    QCOMPARE(matches.groupCount, 0);
+    QCOMPARE(matches.fileCount, 0);
+}
+
+void IndexTest::shortAndRegexQueries()
+{
+    // Shorter than a trigram: every document is verified
+    QCOMPARE(groupsOf(index_.search(textQuery("el"))), QList<int>({2}));
+    QCOMPARE(groupsOf(index_.search(textQuery("a"))), QList<int>({0, 1, 2, 3}));
+
+    CommentQuery query;
+    query.regex = QRegularExpression("^FIX");
+    QCOMPARE(groupsOf(index_.search(query)), QList<int>({2}));
+    query.regex = QRegularExpression("g[a-z]+a$");
+    QCOMPARE(groupsOf(index_.search(query)), QList<int>({1}));
+    // Both conditions must hold
+    query.text = "alpha";
+    QCOMPARE(groupsOf(index_.search(query)), QList<int>());
+}
+
+void IndexTest::tags()
+{
+    CommentQuery query;
+    query.tags = QStringList{"TODO"};
+    QCOMPARE(groupsOf(index_.search(query)), QList<int>({0})); // "TODOS" is not the word
+    query.tags = QStringList{"FIXME"};
+    QCOMPARE(groupsOf(index_.search(query)), QList<int>({2}));
+    query.tags = QStringList{"TODO", "FIXME"};
+    QCOMPARE(groupsOf(index_.search(query)), QList<int>({0, 2}));
+    query.text = "delta";
+    QCOMPARE(groupsOf(index_.search(query)), QList<int>({2}));
+    query.tags = QStringList{"HACK"};
+    QCOMPARE(groupsOf(index_.search(query)), QList<int>());
+}
+
+void IndexTest::editedGroups()
+{
+    index_.setGroup(0, 1, "now epsilon, HACK");
+    QCOMPARE(groupsOf(index_.search(textQuery("beta"))), QList<int>());
+    QCOMPARE(groupsOf(index_.search(textQuery("EPSILON"))), QList<int>({1}));
+    CommentQuery query;
+    query.tags = QStringList{"HACK"};
+    QCOMPARE(groupsOf(index_.search(query)), QList<int>({1}));
+
+    index_.restoreGroup(0, 1);
+    QCOMPARE(groupsOf(index_.search(textQuery("beta"))), QList<int>({1}));
+    QCOMPARE(groupsOf(index_.search(textQuery("epsilon"))), QList<int>());
+    QCOMPARE(groupsOf(index_.search(query)), QList<int>());
+
+    // Edited text given when the file is indexed again, e.g. after it was evicted
+    index_.setFile(0, arena_, {{2, "omega"}});
+    QCOMPARE(groupsOf(index_.search(textQuery("omega"))), QList<int>({2}));
+    QCOMPARE(groupsOf(index_.search(textQuery("delta"))), QList<int>());
+
+    // Rows out of range are ignored
+    index_.setGroup(0, 9, "ignored");
+    index_.setGroup(5, 0, "ignored");
+    QCOMPARE(index_.search(textQuery("ignored")).groupCount, 0);
+}
+
+void IndexTest::removedFile()
+{
+    index_.setFile(2, arena_);
+    CommentMatches matches = index_.search(textQuery("gamma"));
+    QCOMPARE(matches.fileCount, 2);
+    QCOMPARE(groupsOf(matches, 2), QList<int>({1}));
+    QVERIFY(!matches.fileMatches(1));
+
+    index_.removeFile(2);
+    matches = index_.search(textQuery("gamma"));
+    QCOMPARE(matches.fileCount, 1);
+    QVERIFY(!matches.fileMatches(2));
+    QCOMPARE(groupsOf(matches), QList<int>({1}));
+}
+
+void IndexTest::compactionKeepsResults()
+{
+    // Each edit leaves a removed document behind; enough of them rebuild the index
+    const int edits = 70 * 1024;
+    for (int i = 0; i < edits; ++i) {
+        index_.setGroup(0, 0, i % 2 ? "zeta odd" : "zeta even");
+    }
+    const QString last = (edits - 1) % 2 ? "odd" : "even";
+    QCOMPARE(groupsOf(index_.search(textQuery("zeta " + last))), QList<int>({0}));
+    QCOMPARE(index_.search(textQuery("zeta")).groupCount, 1);
+    QCOMPARE(groupsOf(index_.search(textQuery("alpha"))), QList<int>());
+    QCOMPARE(groupsOf(index_.search(textQuery("beta"))), QList<int>({1}));
+
+    CommentQuery query;
+    query.tags = QStringList{"FIXME"};
+    QCOMPARE(groupsOf(index_.search(query)), QList<int>({2}));
+
+    // Ids were renumbered; later edits still find their documents
+    index_.restoreGroup(0, 0);
+    QCOMPARE(groupsOf(index_.search(textQuery("alpha"))), QList<int>({0}));
+    QCOMPARE(index_.search(textQuery("zeta")).groupCount, 0);
+}
+
+void IndexTest::scanFileAgreesWithSearch()
+{
+    const QHash<int, QString> edited = {{3, "rho TODO"}};
+    index_.setFile(0, arena_, edited);
+
+    QList<CommentQuery> queries = {textQuery("alpha"), textQuery("a"), textQuery("rho"), textQuery("nothing")};
+    CommentQuery tagged;
+    tagged.tags = QStringList{"TODO"};
+    queries.append(tagged);
+    CommentQuery regex;
+    regex.regex = QRegularExpression("[bd]elta|beta");
+    queries.append(regex);
+
+    for (const CommentQuery &query : std::as_const(queries)) {
+        const CommentMatches matches = index_.search(query);
+        const QBitArray scanned = CommentIndex::scanFile(query, arena_, edited);
+        QCOMPARE(scanned, matches.fileMatches(0) ? matches.groups[0] : QBitArray());
+    }
+}
+
+QTEST_APPLESS_MAIN(IndexTest)
+#include "IndexTest.moc"
@@ -0,0 +1,148 @@
+#include <QtTest>
+#include "CommentLexer.h"
+
+// Comment spans the lexer reports, checked by their text and flags
+class LexerTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void lineComment();
+    void blockCommentAcrossLines();
+    void markersInsideStrings();
+    void rawStrings();
+    void digitSeparators();
+    void severalCommentsOnOneLine();
+    void crlfAndBom();
+    void hashComments();
+    void nestedBlockComments();
+    void unterminatedBlockComment();
+
+private:
+    static QByteArray text(const QByteArray &data, const CommentSpan &span)
+    {
+        return data.mid(span.textStart, span.textEnd - span.textStart);
+    }
+};
+
+void LexerTest::lineComment()
+{
+    const QByteArray data = "int a; // hello\n// own line\n";
+    const QList<CommentSpan> spans = CommentLexer(Language::Cpp).scan(data);
+    QCOMPARE(spans.size(), 2);
+    QCOMPARE(spans[0].lineNumber, 1);
+    QCOMPARE(text(data, spans[0]), QByteArray("hello"));
+    QVERIFY(spans[0].isInline);
+    QCOMPARE(data.mid(spans[0].commentStart, spans[0].commentEnd - spans[0].commentStart), QByteArray("// hello"));
+    QCOMPARE(spans[1].lineNumber, 2);
+    QCOMPARE(text(data, spans[1]), QByteArray("own line"));
+    QVERIFY(!spans[1].isInline);
+    QVERIFY(!spans[1].hasMoreComments);
+}
+
+void LexerTest::blockCommentAcrossLines()
+{
+    // The closing line holds no text, so it is not reported
+    const QByteArray data = "/* first\n * second\n */\nint a;\n";
+    const QList<CommentSpan> spans = CommentLexer(Language::Cpp).scan(data);
+    QCOMPARE(spans.size(), 2);
+    QCOMPARE(spans[0].lineNumber, 1);
+    QCOMPARE(text(data, spans[0]), QByteArray("first"));
+    QVERIFY(spans[0].isBlockFragment);
+    QCOMPARE(spans[1].lineNumber, 2);
+    QCOMPARE(text(data, spans[1]), QByteArray("second"));
+    QVERIFY(spans[1].isBlockFragment);
+}
+
+void LexerTest::markersInsideStrings()
+{
+    const QByteArray data = "const char *s = \"// not /* a comment\"; char c = '\"'; // real\n";
+    const QList<CommentSpan> spans = CommentLexer(Language::Cpp).scan(data);
+    QCOMPARE(spans.size(), 1);
+    QCOMPARE(text(data, spans[0]), QByteArray("real"));
+    QVERIFY(spans[0].isInline);
+}
+
+void LexerTest::rawStrings()
+{
+    const QByteArray data = "auto s = R\"x(// no \")\" /* no */)x\"; // yes\n";
+    const QList<CommentSpan> spans = CommentLexer(Language::Cpp).scan(data);
+    QCOMPARE(spans.size(), 1);
+    QCOMPARE(text(data, spans[0]), QByteArray("yes"));
+}
+
+void LexerTest::digitSeparators()
+{
+    // A separator after hex digits is no char literal, nor is one after a decimal digit
+    const QByteArray hex = "int m = 0xFF'FF; // mask\nlong n = 1'000'000; // count\n";
+    QList<CommentSpan> spans = CommentLexer(Language::Cpp).scan(hex);
+    QCOMPARE(spans.size(), 2);
+    QCOMPARE(text(hex, spans[0]), QByteArray("mask"));
+    QCOMPARE(text(hex, spans[1]), QByteArray("count"));
+
+    // A prefix ending in a digit starts a char literal, so its '"' opens no string
+    const QByteArray prefixed = "auto c = u8'\"'; // quote\n";
+    spans = CommentLexer(Language::Cpp).scan(prefixed);
+    QCOMPARE(spans.size(), 1);
+    QCOMPARE(text(prefixed, spans[0]), QByteArray("quote"));
+}
+
+void LexerTest::severalCommentsOnOneLine()
+{
+    // One comment per line: the first is kept and the line is flagged
+    const QByteArray data = "/* a */ x; // b\n";
+    const QList<CommentSpan> spans = CommentLexer(Language::Cpp).scan(data);
+    QCOMPARE(spans.size(), 1);
+    QCOMPARE(text(data, spans[0]), QByteArray("a"));
+    QVERIFY(!spans[0].isInline);
+    QVERIFY(spans[0].hasMoreComments);
+}
+
+void LexerTest::crlfAndBom()
+{
+    const QByteArray data = "\xEF\xBB\xBF// one\r\n// two\r\n";
+    const QList<CommentSpan> spans = CommentLexer(Language::Cpp).scan(data);
+    QCOMPARE(spans.size(), 2);
+    QCOMPARE(spans[0].lineStart, qsizetype(3));
+    QCOMPARE(spans[0].lineEnd, qsizetype(9));
+    QCOMPARE(text(data, spans[0]), QByteArray("one"));
+    QCOMPARE(spans[1].lineStart, qsizetype(11));
+    QCOMPARE(text(data, spans[1]), QByteArray("two"));
+}
+
+void LexerTest::hashComments()
+{
+    const QByteArray python = "x = '#'  # note\ns = \"\"\"\n# inside\n\"\"\"\n";
+    QList<CommentSpan> spans = CommentLexer(Language::Python).scan(python);
+    QCOMPARE(spans.size(), 1);
+    QCOMPARE(text(python, spans[0]), QByteArray("note"));
+
+    // "${#x}" is code, "# x" at the start of a word is a comment
+    const QByteArray shell = "echo ${#x} # length\n";
+    spans = CommentLexer(Language::Shell).scan(shell);
+    QCOMPARE(spans.size(), 1);
+    QCOMPARE(text(shell, spans[0]), QByteArray("length"));
+}
+
+void LexerTest::nestedBlockComments()
+{
+    const QByteArray data = "/* a /* b */ c */ fn f() {}\n";
+    const QList<CommentSpan> spans = CommentLexer(Language::Rust).scan(data);
+    QCOMPARE(spans.size(), 1);
+    QCOMPARE(text(data, spans[0]), QByteArray("a /* b */ c"));
+    QVERIFY(!spans[0].isBlockFragment);
+}
+
+void LexerTest::unterminatedBlockComment()
+{
+    // Runs to the end of the buffer without reading past it
+    const QByteArray data = "int a; /* open\nstill";
+    const QList<CommentSpan> spans = CommentLexer(Language::Cpp).scan(data);
+    QCOMPARE(spans.size(), 2);
+    QCOMPARE(text(data, spans[0]), QByteArray("open"));
+    QCOMPARE(text(data, spans[1]), QByteArray("still"));
+    QCOMPARE(spans[1].lineEnd, qsizetype(data.size()));
+}
+
+QTEST_APPLESS_MAIN(LexerTest)
+#include "LexerTest.moc"
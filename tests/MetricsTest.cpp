@@ -0,0 +1,193 @@
+#include <QtTest>
+#include "CommentExtractor.h"
+#include "CommentMetrics.h"
+
+// Comment metrics of single files, the reduce step and its ties, and the
+// per-directory rollups of the metrics report
+class MetricsTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void forFile();
+    void fileWithoutComments();
+    void tiesGoToTheFirstPath();
+    void rollups();
+    void updateFileMatchesRebuild();
+
+private:
+    static FileComments fileOf(const QString &filePath, const QByteArray &source);
+    static CommentMetrics uncommentedRun(const QString &filePath, int length, int start);
+    static void compareMetrics(const CommentMetrics &actual, const CommentMetrics &expected);
+    static void fillReport(CommentMetricsReport &report);
+};
+
+FileComments MetricsTest::fileOf(const QString &filePath, const QByteArray &source)
+{
+    FileComments file;
+    file.filePath = filePath;
+    file.lineCount = int(source.count('\n'));
+    file.comments = CommentArena::build(source.constData(), CommentLexer(Language::Cpp).scan(source));
+    return file;
+}
+
+CommentMetrics MetricsTest::uncommentedRun(const QString &filePath, int length, int start)
+{
+    CommentMetrics metrics;
+    metrics.files = 1;
+    metrics.lines = length;
+    metrics.longestUncommented = length;
+    metrics.longestUncommentedStart = start;
+    metrics.longestUncommentedFile = filePath;
+    return metrics;
+}
+
+void MetricsTest::compareMetrics(const CommentMetrics &actual, const CommentMetrics &expected)
+{
+    QCOMPARE(actual.files, expected.files);
+    QCOMPARE(actual.lines, expected.lines);
+    QCOMPARE(actual.commentLines, expected.commentLines);
+    QCOMPARE(actual.inlineLines, expected.inlineLines);
+    QCOMPARE(actual.blockLines, expected.blockLines);
+    QCOMPARE(actual.todoCount, expected.todoCount);
+    QCOMPARE(actual.fixmeCount, expected.fixmeCount);
+    QCOMPARE(actual.longestUncommented, expected.longestUncommented);
+    QCOMPARE(actual.longestUncommentedStart, expected.longestUncommentedStart);
+    QCOMPARE(actual.longestUncommentedFile, expected.longestUncommentedFile);
+}
+
+void MetricsTest::forFile()
+{
+    const CommentMetrics metrics = CommentMetrics::forFile(fileOf("/p/a.cpp", "// TODO: one TODO\n"
+                                                                              "int a; // FIXME later\n"
+                                                                              "int b;\n"
+                                                                              "int c;\n"
+                                                                              "int d;\n"
+                                                                              "// TODOS NOTTODO todo\n"
+                                                                              "int e;\n"));
+    QCOMPARE(metrics.files, 1);
+    QCOMPARE(metrics.lines, qint64(7));
+    QCOMPARE(metrics.commentLines, qint64(3));
+    QCOMPARE(metrics.inlineLines, qint64(1));
+    QCOMPARE(metrics.blockLines, qint64(2));
+    // Whole words in upper case only
+    QCOMPARE(metrics.todoCount, qint64(2));
+    QCOMPARE(metrics.fixmeCount, qint64(1));
+    QCOMPARE(metrics.longestUncommented, 3);
+    QCOMPARE(metrics.longestUncommentedStart, 3);
+    QCOMPARE(metrics.longestUncommentedFile, QString("/p/a.cpp"));
+    QCOMPARE(metrics.density(), 3.0 / 7.0);
+    QCOMPARE(metrics.inlineRatio(), 1.0 / 3.0);
+}
+
+void MetricsTest::fileWithoutComments()
+{
+    CommentMetrics metrics = CommentMetrics::forFile(fileOf("/p/b.cpp", "int a;\nint b;\nint c;\n"));
+    QCOMPARE(metrics.commentLines, qint64(0));
+    QCOMPARE(metrics.longestUncommented, 3);
+    QCOMPARE(metrics.longestUncommentedStart, 1);
+    QCOMPARE(metrics.inlineRatio(), 0.0);
+
+    metrics = CommentMetrics::forFile(fileOf("/p/empty.cpp", ""));
+    QCOMPARE(metrics.lines, qint64(0));
+    QCOMPARE(metrics.longestUncommented, 0);
+    QVERIFY(metrics.longestUncommentedFile.isEmpty());
+    QCOMPARE(metrics.density(), 0.0);
+}
+
+void MetricsTest::tiesGoToTheFirstPath()
+{
+    const CommentMetrics a = uncommentedRun("/p/a.cpp", 5, 10);
+    const CommentMetrics b = uncommentedRun("/p/b.cpp", 5, 20);
+    const CommentMetrics longer = uncommentedRun("/p/c.cpp", 6, 30);
+
+    CommentMetrics forward;
+    forward.add(a);
+    forward.add(b);
+    CommentMetrics backward;
+    backward.add(b);
+    backward.add(a);
+    compareMetrics(backward, forward);
+    QCOMPARE(forward.longestUncommentedFile, QString("/p/a.cpp"));
+    QCOMPARE(forward.longestUncommentedStart, 10);
+    QCOMPARE(forward.files, 2);
+
+    // A longer run wins whatever its path
+    backward.add(longer);
+    QCOMPARE(backward.longestUncommentedFile, QString("/p/c.cpp"));
+    QCOMPARE(backward.longestUncommented, 6);
+    // An empty run never takes over
+    backward.add(CommentMetrics());
+    QCOMPARE(backward.longestUncommentedFile, QString("/p/c.cpp"));
+}
+
+// /p/src/a.cpp, /p/src/sub/b.cpp and /p/docs/c.cpp, with ties between a and c
+void MetricsTest::fillReport(CommentMetricsReport &report)
+{
+    CommentMetrics a = uncommentedRun("/p/src/a.cpp", 8, 1);
+    a.commentLines = 2;
+    CommentMetrics b = uncommentedRun("/p/src/sub/b.cpp", 4, 1);
+    b.commentLines = 3;
+    b.todoCount = 1;
+    CommentMetrics c = uncommentedRun("/p/docs/c.cpp", 8, 2);
+    c.commentLines = 1;
+    report.setFile("/p/docs/c.cpp", c);
+    report.setFile("/p/src/sub/b.cpp", b);
+    report.setFile("/p/src/a.cpp", a);
+    report.rebuild();
+}
+
+void MetricsTest::rollups()
+{
+    CommentMetricsReport report;
+    fillReport(report);
+
+    QCOMPARE(report.fileCount(), 3);
+    QCOMPARE(report.root(), QString("/p"));
+    QCOMPARE(report.subdirectories("/p"), QStringList({"/p/docs", "/p/src"}));
+    QCOMPARE(report.files("/p/src"), QStringList({"/p/src/a.cpp"}));
+    QCOMPARE(report.files("/p"), QStringList());
+
+    const CommentMetrics total = report.directory("/p");
+    QCOMPARE(total.files, 3);
+    QCOMPARE(total.lines, qint64(20));
+    QCOMPARE(total.commentLines, qint64(6));
+    QCOMPARE(total.todoCount, qint64(1));
+    QCOMPARE(total.longestUncommentedFile, QString("/p/docs/c.cpp"));
+    QCOMPARE(total.longestUncommentedStart, 2);
+
+    const CommentMetrics src = report.directory("/p/src");
+    QCOMPARE(src.files, 2);
+    QCOMPARE(src.commentLines, qint64(5));
+    QCOMPARE(src.longestUncommentedFile, QString("/p/src/a.cpp"));
+    QCOMPARE(report.directory("/p/src/sub").files, 1);
+    QCOMPARE(report.directory("/").files, 3);
+    QCOMPARE(report.file("/p/src/sub/b.cpp").commentLines, qint64(3));
+}
+
+void MetricsTest::updateFileMatchesRebuild()
+{
+    CommentMetricsReport updated;
+    fillReport(updated);
+    CommentMetrics b = uncommentedRun("/p/src/sub/b.cpp", 12, 3);
+    b.commentLines = 1;
+    updated.updateFile("/p/src/sub/b.cpp", b);
+    CommentMetrics d = uncommentedRun("/p/docs/more/d.cpp", 2, 1);
+    updated.updateFile("/p/docs/more/d.cpp", d);
+
+    CommentMetricsReport rebuilt;
+    fillReport(rebuilt);
+    rebuilt.setFile("/p/src/sub/b.cpp", b);
+    rebuilt.setFile("/p/docs/more/d.cpp", d);
+    rebuilt.rebuild();
+
+    const QStringList directories = {"/", "/p", "/p/src", "/p/src/sub", "/p/docs", "/p/docs/more"};
+    for (const QString &directory : directories) {
+        compareMetrics(updated.directory(directory), rebuilt.directory(directory));
+    }
+    QCOMPARE(updated.directory("/p").longestUncommentedFile, QString("/p/src/sub/b.cpp"));
+    QCOMPARE(updated.directory("/p").files, 4);
+}
+
+QTEST_APPLESS_MAIN(MetricsTest)
+#include "MetricsTest.moc"
@@ -0,0 +1,141 @@
+#include <QtTest>
+#include "CommentArena.h"
+#include "CommentReplacer.h"
+
+// Find-and-replace in comment text: literal and regex syntax, captures, and code
+// on inline lines left untouched
+class ReplacerTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void replaceInComment_data();
+    void replaceInComment();
+    void invalidPattern();
+    void inlineLineKeepsCode();
+    void group();
+    void readOnlyGroup();
+
+private:
+    static CommentArena arenaOf(const QByteArray &source);
+};
+
+CommentArena ReplacerTest::arenaOf(const QByteArray &source)
+{
+    return CommentArena::build(source.constData(), CommentLexer(Language::Cpp).scan(source));
+}
+
+void ReplacerTest::replaceInComment_data()
+{
+    QTest::addColumn<QString>("find");
+    QTest::addColumn<QString>("replacement");
+    QTest::addColumn<bool>("regex");
+    QTest::addColumn<bool>("caseSensitive");
+    QTest::addColumn<QString>("comment");
+    QTest::addColumn<QString>("expected");
+    QTest::addColumn<int>("count");
+
+    QTest::newRow("literal") << "foo" << "bar" << false << true << "foo and Foo" << "bar and Foo" << 1;
+    QTest::newRow("literal ignoring case") << "foo" << "bar" << false << false << "foo and Foo" << "bar and bar" << 2;
+    QTest::newRow("literal is not a pattern") << "a.b" << "x" << false << true << "axb a.b" << "axb x" << 1;
+    QTest::newRow("literal replacement keeps backslashes") << "a" << "\\1" << false << true << "a" << "\\1" << 1;
+    QTest::newRow("no match") << "foo" << "bar" << false << true << "nothing" << "nothing" << 0;
+    QTest::newRow("captures") << "(\\w+)@(\\w+)" << "\\2 at \\1" << true << true << "ana@home" << "home at ana" << 1;
+    QTest::newRow("escaped backslash") << "/" << "\\\\" << true << true << "a/b" << "a\\b" << 1;
+    QTest::newRow("two digits only when the group exists") << "(a)" << "\\10" << true << true << "a" << "a0" << 1;
+    QTest::newRow("two digit group") << "(a)(b)(c)(d)(e)(f)(g)(h)(i)(j)" << "\\10" << true << true << "abcdefghij" << "j" << 1;
+    QTest::newRow("other escapes are kept") << "a" << "\\n" << true << true << "a" << "\\n" << 1;
+    QTest::newRow("zero-length matches are skipped") << "x*" << "-" << true << true << "abc" << "abc" << 0;
+    QTest::newRow("zero-length and longer matches") << "x*" << "-" << true << true << "axxb" << "a-b" << 1;
+}
+
+void ReplacerTest::replaceInComment()
+{
+    QFETCH(QString, find);
+    QFETCH(QString, replacement);
+    QFETCH(bool, regex);
+    QFETCH(bool, caseSensitive);
+    QFETCH(QString, comment);
+    QFETCH(QString, expected);
+    QFETCH(int, count);
+
+    const CommentReplacer replacer(find, replacement,
+                                   regex ? CommentReplacer::Syntax::Regex : CommentReplacer::Syntax::Literal,
+                                   caseSensitive ? Qt::CaseSensitive : Qt::CaseInsensitive);
+    QVERIFY(replacer.isValid());
+    QCOMPARE(replacer.replaceInComment(comment), count);
+    QCOMPARE(comment, expected);
+}
+
+void ReplacerTest::invalidPattern()
+{
+    const CommentReplacer replacer("(", "x", CommentReplacer::Syntax::Regex, Qt::CaseSensitive);
+    QVERIFY(!replacer.isValid());
+    QVERIFY(!replacer.errorString().isEmpty());
+    // The same text is a valid literal
+    QVERIFY(CommentReplacer("(", "x", CommentReplacer::Syntax::Literal, Qt::CaseSensitive).isValid());
+}
+
+void ReplacerTest::inlineLineKeepsCode()
+{
+    const CommentReplacer replacer("foo", "bar", CommentReplacer::Syntax::Literal, Qt::CaseSensitive);
+
+    QString line = "int foo; // foo here";
+    QCOMPARE(replacer.replaceInLine(line, true, Language::Cpp), 1);
+    QCOMPARE(line, QString("int foo; // bar here"));
+
+    // A comment marker inside a string is code
+    line = "auto s = \"// foo\"; // foo";
+    QCOMPARE(replacer.replaceInLine(line, true, Language::Cpp), 1);
+    QCOMPARE(line, QString("auto s = \"// foo\"; // bar"));
+
+    // Lexed with the file's syntax
+    line = "x = 'foo'  # foo";
+    QCOMPARE(replacer.replaceInLine(line, true, Language::Python), 1);
+    QCOMPARE(line, QString("x = 'foo'  # bar"));
+
+    // Only code left: nothing to replace in
+    line = "int foo;";
+    QCOMPARE(replacer.replaceInLine(line, true, Language::Cpp), 0);
+    QCOMPARE(line, QString("int foo;"));
+
+    // Lines of their own are comment text throughout
+    line = "foo foo";
+    QCOMPARE(replacer.replaceInLine(line, false, Language::Cpp), 2);
+    QCOMPARE(line, QString("bar bar"));
+}
+
+void ReplacerTest::group()
+{
+    const CommentArena arena = arenaOf("int foo; // foo\n// foo too\n");
+    QCOMPARE(arena.groupCount(), 1);
+    const CommentGroup group(arena, 0);
+    QVERIFY(!group.isReadOnly());
+
+    // The group's text as the tree shows it, plus a line added in the editor
+    QString text = "int foo; // foo\nfoo too\nfoo added";
+    const CommentReplacer replacer("foo", "bar", CommentReplacer::Syntax::Literal, Qt::CaseSensitive);
+    QCOMPARE(replacer.replaceInGroup(text, group, Language::Cpp), 3);
+    QCOMPARE(text, QString("int foo; // bar\nbar too\nbar added"));
+
+    QString unchanged = "int foo; // baz";
+    QCOMPARE(replacer.replaceInGroup(unchanged, group, Language::Cpp), 0);
+    QCOMPARE(unchanged, QString("int foo; // baz"));
+}
+
+void ReplacerTest::readOnlyGroup()
+{
+    // Only the first comment of the line would be saved, so the group is left alone
+    const CommentArena arena = arenaOf("/* foo */ x; // foo\n");
+    const CommentGroup group(arena, 0);
+    QVERIFY(group.isReadOnly());
+
+    QString text = group.getCombinedComments();
+    const QString shown = text;
+    const CommentReplacer replacer("foo", "bar", CommentReplacer::Syntax::Literal, Qt::CaseSensitive);
+    QCOMPARE(replacer.replaceInGroup(text, group, Language::Cpp), 0);
+    QCOMPARE(text, shown);
+}
+
+QTEST_APPLESS_MAIN(ReplacerTest)
+#include "ReplacerTest.moc"
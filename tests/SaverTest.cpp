@@ -0,0 +1,329 @@
+#include <QtTest>
+#include <QTemporaryDir>
+#include "CommentSaver.h"
+#include "ContentHash.h"
+#include <atomic>
+
+// Edits written back into files: line endings, byte order marks and deletions,
+// the batch transaction, and the hunks of the save preview
+class SaverTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void init();
+    void applyEdits_data();
+    void applyEdits();
+    void staleFileIsNotSaved();
+    void multiLineReplaceInBlockCommentFails();
+    void batchCommitsEveryFile();
+    void failedBatchChangesNothing();
+    void changeBeforeCommitRollsBack();
+    void previewSeparatesDistantChanges();
+    void previewMergesNearbyChanges();
+    void previewOfInsertion();
+    void rejectedHunksAreNotSaved();
+
+private:
+    QString writeFile(const QString &name, const QByteArray &content);
+    static QByteArray readFile(const QString &path);
+    static QByteArray numberedLines(int count);
+    QStringList leftovers() const;
+
+    QScopedPointer<QTemporaryDir> dir_;
+};
+
+void SaverTest::init()
+{
+    dir_.reset(new QTemporaryDir());
+    QVERIFY(dir_->isValid());
+}
+
+QString SaverTest::writeFile(const QString &name, const QByteArray &content)
+{
+    const QString path = dir_->filePath(name);
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly) || file.write(content) != content.size()) {
+        qFatal("Could not write %s", qPrintable(path));
+    }
+    return path;
+}
+
+QByteArray SaverTest::readFile(const QString &path)
+{
+    QFile file(path);
+    return file.open(QIODevice::ReadOnly) ? file.readAll() : QByteArray();
+}
+
+// "int v1;" ... with comments on lines 5, 10 and 15
+QByteArray SaverTest::numberedLines(int count)
+{
+    QByteArray content;
+    for (int line = 1; line <= count; ++line) {
+        content += line % 5 == 0 ? "// note " + QByteArray::number(line) + "\n" : "int v" + QByteArray::number(line) + ";\n";
+    }
+    return content;
+}
+
+// Temporary and backup files a save left behind
+QStringList SaverTest::leftovers() const
+{
+    return QDir(dir_->path()).entryList({"*.ccp-save*"}, QDir::Files | QDir::Hidden);
+}
+
+void SaverTest::applyEdits_data()
+{
+    QTest::addColumn<QByteArray>("original");
+    QTest::addColumn<QList<CommentEdit>>("edits");
+    QTest::addColumn<QByteArray>("expected");
+
+    QTest::newRow("replace keeps code and markers")
+        << QByteArray("int a; /* old */ int b;\n") << QList<CommentEdit>{CommentEdit::replace(1, "new")}
+        << QByteArray("int a; /* new */ int b;\n");
+    QTest::newRow("replace keeps CRLF")
+        << QByteArray("int a; // old\r\nint b;\r\n") << QList<CommentEdit>{CommentEdit::replace(1, "new")}
+        << QByteArray("int a; // new\r\nint b;\r\n");
+    QTest::newRow("insert uses the file's line ending")
+        << QByteArray("// a\r\nint b;\r\n") << QList<CommentEdit>{CommentEdit::insertAfter(1, 0, "b")}
+        << QByteArray("// a\r\n// b\r\nint b;\r\n");
+    QTest::newRow("replace keeps the BOM")
+        << QByteArray("\xEF\xBB\xBF// a\n") << QList<CommentEdit>{CommentEdit::replace(1, "b")}
+        << QByteArray("\xEF\xBB\xBF// b\n");
+    QTest::newRow("insert at the top goes after the BOM")
+        << QByteArray("\xEF\xBB\xBFint a;\n") << QList<CommentEdit>{CommentEdit::insertAfter(0, 0, "top")}
+        << QByteArray("\xEF\xBB\xBF// top\nint a;\n");
+    QTest::newRow("missing final newline stays missing")
+        << QByteArray("int a;\n// a") << QList<CommentEdit>{CommentEdit::replace(2, "b")}
+        << QByteArray("int a;\n// b");
+    QTest::newRow("delete removes a comment-only line")
+        << QByteArray("int a;\n// gone\nint b;\n") << QList<CommentEdit>{CommentEdit::remove(2)}
+        << QByteArray("int a;\nint b;\n");
+    QTest::newRow("delete of an inline comment keeps the code")
+        << QByteArray("int a; // gone\r\n") << QList<CommentEdit>{CommentEdit::remove(1)}
+        << QByteArray("int a;\r\n");
+    QTest::newRow("delete keeps code after a block comment")
+        << QByteArray("int a; /* gone */ int b;\n") << QList<CommentEdit>{CommentEdit::remove(1)}
+        << QByteArray("int a; int b;\n");
+    QTest::newRow("delete never removes a line without a comment")
+        << QByteArray("int a;\n") << QList<CommentEdit>{CommentEdit::remove(1)}
+        << QByteArray("int a;\n");
+    QTest::newRow("anchors refer to the original lines")
+        << QByteArray("// a\n// b\n// c\n")
+        << QList<CommentEdit>{CommentEdit::remove(1), CommentEdit::insertAfter(1, 0, "x"), CommentEdit::replace(3, "z")}
+        << QByteArray("// x\n// b\n// z\n");
+    QTest::newRow("multi-line replace keeps the code")
+        << QByteArray("int x = 1; // a\n") << QList<CommentEdit>{CommentEdit::replace(1, "a\nb")}
+        << QByteArray("int x = 1; // a\n// b\n");
+    QTest::newRow("multi-line insert marks every line")
+        << QByteArray("// a\nint b;\n") << QList<CommentEdit>{CommentEdit::insertAfter(1, 0, "x\ny")}
+        << QByteArray("// a\n// x\n// y\nint b;\n");
+    QTest::newRow("multi-line replace past the end marks every line")
+        << QByteArray("int a;\n") << QList<CommentEdit>{CommentEdit::replace(3, "x\ny")}
+        << QByteArray("int a;\n\n// x\n// y\n");
+}
+
+void SaverTest::applyEdits()
+{
+    QFETCH(QByteArray, original);
+    QFETCH(QList<CommentEdit>, edits);
+    QFETCH(QByteArray, expected);
+
+    const QString path = writeFile("file.cpp", original);
+    CommentSaver saver;
+    QVERIFY2(saver.applyEdits(path, edits, contentHash(original.constData(), original.size())),
+             qPrintable(saver.errorString()));
+    QCOMPARE(readFile(path), expected);
+}
+
+void SaverTest::staleFileIsNotSaved()
+{
+    const QByteArray loaded = "// a\nint b;\n";
+    const QByteArray onDisk = "int inserted;\n// a\nint b;\n";
+    const QString path = writeFile("file.cpp", onDisk);
+    const quint64 loadedHash = contentHash(loaded.constData(), loaded.size());
+
+    CommentSaver saver;
+    QVERIFY(!saver.applyEdits(path, {CommentEdit::replace(1, "b")}, loadedHash));
+    QVERIFY(!saver.errorString().isEmpty());
+    QCOMPARE(readFile(path), onDisk);
+
+    FilePreview preview;
+    QVERIFY(!saver.preview(path, {CommentEdit::replace(1, "b")}, preview, loadedHash));
+    QVERIFY(!preview.error.isEmpty());
+    QVERIFY(preview.hunks.isEmpty());
+}
+
+void SaverTest::multiLineReplaceInBlockCommentFails()
+{
+    const QByteArray original = "/* a\n   b */\nint c;\n";
+    const QString path = writeFile("file.cpp", original);
+    const quint64 hash = contentHash(original.constData(), original.size());
+
+    CommentSaver saver;
+    QVERIFY(!saver.applyEdits(path, {CommentEdit::replace(1, "a\nx")}, hash));
+    QVERIFY(!saver.errorString().isEmpty());
+    QCOMPARE(readFile(path), original);
+
+    FilePreview preview;
+    QVERIFY(!saver.preview(path, {CommentEdit::replace(1, "a\nx")}, preview, hash));
+    QVERIFY(!preview.error.isEmpty());
+}
+
+void SaverTest::batchCommitsEveryFile()
+{
+    QList<FileSaveJob> jobs(2);
+    jobs[0].filePath = writeFile("a.cpp", "// a\n");
+    jobs[0].edits = {CommentEdit::replace(1, "A")};
+    jobs[1].filePath = writeFile("b.py", "x = 1  # b\n");
+    jobs[1].edits = {CommentEdit::replace(1, "B")};
+
+    // Reported from the workers, so only counted there
+    std::atomic<int> reports{0};
+    std::atomic<int> lastCompleted{0};
+    QVERIFY(CommentSaver::saveAll(jobs, [&](int completed, int total, const QString &) {
+        ++reports;
+        if (total == 4) {
+            lastCompleted = std::max(lastCompleted.load(), completed);
+        }
+    }));
+    QCOMPARE(reports.load(), 4);
+    QCOMPARE(lastCompleted.load(), 4);
+    QVERIFY(jobs[0].saved && jobs[1].saved);
+    QCOMPARE(readFile(jobs[0].filePath), QByteArray("// A\n"));
+    QCOMPARE(readFile(jobs[1].filePath), QByteArray("x = 1  # B\n"));
+    QCOMPARE(leftovers(), QStringList());
+}
+
+void SaverTest::failedBatchChangesNothing()
+{
+    QList<FileSaveJob> jobs(3);
+    jobs[0].filePath = writeFile("a.cpp", "// a\n");
+    jobs[0].edits = {CommentEdit::replace(1, "A")};
+    jobs[1].filePath = writeFile("b.cpp", "// b\n");
+    jobs[1].edits = {CommentEdit::replace(1, "B")};
+    jobs[1].contentHash = 1; // Not the hash of what is on disk
+    jobs[2].filePath = writeFile("c.cpp", "// c\n");
+    jobs[2].edits = {CommentEdit::replace(1, "C")};
+
+    QVERIFY(!CommentSaver::saveAll(jobs));
+    for (const FileSaveJob &job : std::as_const(jobs)) {
+        QVERIFY(!job.saved);
+        QVERIFY(!job.error.isEmpty());
+    }
+    QCOMPARE(readFile(jobs[0].filePath), QByteArray("// a\n"));
+    QCOMPARE(readFile(jobs[1].filePath), QByteArray("// b\n"));
+    QCOMPARE(readFile(jobs[2].filePath), QByteArray("// c\n"));
+    QCOMPARE(leftovers(), QStringList());
+}
+
+void SaverTest::changeBeforeCommitRollsBack()
+{
+    const QByteArray a = "// a\n";
+    const QByteArray b = "// b\n";
+    QList<FileSaveJob> jobs(2);
+    jobs[0].filePath = writeFile("a.cpp", a);
+    jobs[0].edits = {CommentEdit::replace(1, "A")};
+    jobs[0].contentHash = contentHash(a.constData(), a.size());
+    jobs[1].filePath = writeFile("b.cpp", b);
+    jobs[1].edits = {CommentEdit::replace(1, "B")};
+    jobs[1].contentHash = contentHash(b.constData(), b.size());
+
+    // Once both files are staged, b changes on disk, as if while a preview was open
+    const QString changedPath = jobs[1].filePath;
+    QVERIFY(!CommentSaver::saveAll(jobs, [&](int completed, int, const QString &) {
+        if (completed == 2) {
+            QFile changed(changedPath);
+            if (changed.open(QIODevice::WriteOnly)) {
+                changed.write("int inserted;\n// b\n");
+            }
+        }
+    }));
+    QVERIFY(!jobs[0].saved && !jobs[1].saved);
+    QVERIFY(!jobs[1].error.isEmpty());
+    // a was already replaced when b was found changed, and is restored
+    QCOMPARE(readFile(jobs[0].filePath), a);
+    QCOMPARE(readFile(jobs[1].filePath), QByteArray("int inserted;\n// b\n"));
+    QCOMPARE(leftovers(), QStringList());
+}
+
+void SaverTest::previewSeparatesDistantChanges()
+{
+    const QString path = writeFile("file.cpp", numberedLines(20));
+    const QList<CommentEdit> edits{CommentEdit::replace(5, "five"), CommentEdit::replace(15, "fifteen")};
+    CommentSaver saver;
+    FilePreview preview;
+    QVERIFY(saver.preview(path, edits, preview));
+
+    QCOMPARE(preview.hunks.size(), 2);
+    const DiffHunk &first = preview.hunks[0];
+    QCOMPARE(first.oldStart, 2);
+    QCOMPARE(first.oldCount, 7);
+    QCOMPARE(first.newCount, 7);
+    QCOMPARE(first.lines, (QStringList{" int v2;", " int v3;", " int v4;", "-// note 5", "+// five",
+                                       " int v6;", " int v7;", " int v8;"}));
+    QCOMPARE(first.edits, QList<int>{0});
+    QCOMPARE(preview.hunks[1].oldStart, 12);
+    QCOMPARE(preview.hunks[1].edits, QList<int>{1});
+
+    QVERIFY(preview.unifiedDiff().startsWith(QString("--- %1\n+++ %1\n@@ -2,7 +2,7 @@\n int v2;\n").arg(path)));
+    QVERIFY(preview.unifiedDiff().contains("@@ -12,7 +12,7 @@\n"));
+}
+
+void SaverTest::previewMergesNearbyChanges()
+{
+    const QString path = writeFile("file.cpp", numberedLines(20));
+    CommentSaver saver;
+    FilePreview preview;
+    QVERIFY(saver.preview(path, {CommentEdit::replace(5, "five"), CommentEdit::remove(10)}, preview));
+
+    // Four unchanged lines between the changes are fewer than two contexts' worth
+    QCOMPARE(preview.hunks.size(), 1);
+    const DiffHunk &hunk = preview.hunks[0];
+    QCOMPARE(hunk.oldStart, 2);
+    QCOMPARE(hunk.oldCount, 12);
+    QCOMPARE(hunk.newCount, 11);
+    QVERIFY(hunk.lines.contains("-// note 10"));
+    QCOMPARE(hunk.edits, (QList<int>{0, 1}));
+}
+
+void SaverTest::previewOfInsertion()
+{
+    const QString path = writeFile("file.cpp", numberedLines(20));
+    CommentSaver saver;
+    FilePreview preview;
+    QVERIFY(saver.preview(path, {CommentEdit::insertAfter(5, 0, "added")}, preview));
+
+    QCOMPARE(preview.hunks.size(), 1);
+    QCOMPARE(preview.hunks[0].oldStart, 3);
+    QCOMPARE(preview.hunks[0].oldCount, 6);
+    QCOMPARE(preview.hunks[0].newCount, 7);
+    QCOMPARE(preview.hunks[0].lines[3], QString("+// added"));
+    QVERIFY(preview.unifiedDiff().contains("@@ -3,6 +3,7 @@\n"));
+}
+
+void SaverTest::rejectedHunksAreNotSaved()
+{
+    const QByteArray original = numberedLines(20);
+    const QString path = writeFile("file.cpp", original);
+    const QList<CommentEdit> edits{CommentEdit::insertAfter(5, 0, "added"), CommentEdit::replace(15, "fifteen")};
+    CommentSaver saver;
+    FilePreview preview;
+    QVERIFY(saver.preview(path, edits, preview));
+    QCOMPARE(preview.hunks.size(), 2);
+
+    // The second hunk's numbers on the new side shift by the first hunk only if it is accepted
+    QVERIFY(preview.unifiedDiff().contains("@@ -12,7 +13,7 @@\n"));
+    preview.hunks[0].accepted = false;
+    QVERIFY(preview.unifiedDiff().contains("@@ -12,7 +12,7 @@\n"));
+
+    const QList<CommentEdit> accepted = preview.acceptedEdits(edits);
+    QCOMPARE(accepted.size(), 1);
+    QCOMPARE(accepted[0].line, 15);
+    QVERIFY(saver.applyEdits(path, accepted));
+    QByteArray expected = original;
+    expected.replace("// note 15\n", "// fifteen\n");
+    QCOMPARE(readFile(path), expected);
+}
+
+QTEST_GUILESS_MAIN(SaverTest)
+#include "SaverTest.moc"